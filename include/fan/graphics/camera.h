@@ -16,6 +16,7 @@ namespace fan {
       m_velocity = 0;
       m_position = 0;
       m_front = 0;
+      m_zoom = 1;
       this->update_view();
     }
 
@@ -25,8 +26,16 @@ namespace fan {
       return fan::math::look_at_left<fan::mat4>(this->m_position, m_position + m_front, this->m_up);
     }
 
+    // 2D, zoom scales around m's origin, position is in zoomed units
     fan::mat4 get_view_matrix(const fan::mat4& m) const {
-      return m * fan::math::look_at_left<fan::mat4>(this->m_position, this->m_position + m_front, this->world_up);
+      return (m_zoom == 1 ? m : m.scale(fan::vec3(m_zoom, m_zoom, 1))) * fan::math::look_at_left<fan::mat4>(this->m_position, this->m_position + m_front, this->world_up);
+    }
+
+    f32_t get_zoom() const {
+      return m_zoom;
+    }
+    void set_zoom(f32_t zoom) {
+      m_zoom = zoom;
     }
 
     fan::vec3 get_position() const {
@@ -123,6 +132,7 @@ namespace fan {
     fan::vec3 m_velocity;
     fan::vec3 m_position;
     fan::vec3 m_front;
+    f32_t m_zoom;
 
 
   };
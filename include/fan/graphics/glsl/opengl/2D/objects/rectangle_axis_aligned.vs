@@ -0,0 +1,33 @@
+R"(
+#version 140
+
+in vec4 input0;
+in vec4 input1;
+
+out vec4 instance_color;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+vec2 rectangle_vertices[] = vec2[](
+	vec2(-1.0, -1.0),
+	vec2(1.0, -1.0),
+	vec2(1.0, 1.0),
+
+	vec2(1.0, 1.0),
+	vec2(-1.0, 1.0),
+	vec2(-1.0, -1.0)
+);
+
+// same layout as rectangle.vs, angle and rotation inputs are ignored
+void main() {
+
+	vec4 layout_color = input0;
+	vec2 layout_position = input1.xy;
+	vec2 layout_size = input1.zw;
+
+	gl_Position = projection * view * vec4(layout_position + rectangle_vertices[gl_VertexID % 6] * layout_size, 0, 1);
+
+	instance_color = layout_color;
+}
+)"
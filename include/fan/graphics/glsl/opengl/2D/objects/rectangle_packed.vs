@@ -0,0 +1,41 @@
+R"(
+#version 140
+
+in vec4 input0;
+in vec4 input1;
+in float input2;
+
+out vec4 instance_color;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+vec2 rectangle_vertices[] = vec2[](
+	vec2(-1.0, -1.0),
+	vec2(1.0, -1.0),
+	vec2(1.0, 1.0),
+
+	vec2(1.0, 1.0),
+	vec2(-1.0, 1.0),
+	vec2(-1.0, -1.0)
+);
+
+void main() {
+
+	vec4 layout_color = input0;
+	vec2 layout_position = input1.xy;
+	vec2 layout_size = input1.zw;
+	float layout_angle = input2;
+
+	vec2 v = rectangle_vertices[gl_VertexID % 6] * layout_size;
+
+	float c = cos(layout_angle);
+	float s = sin(layout_angle);
+
+	v = vec2(v.x * c - v.y * s, v.x * s + v.y * c);
+
+	gl_Position = projection * view * vec4(layout_position + v, 0, 1);
+
+	instance_color = layout_color;
+}
+)"
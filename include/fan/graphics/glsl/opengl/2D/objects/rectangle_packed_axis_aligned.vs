@@ -0,0 +1,36 @@
+R"(
+#version 140
+
+in vec4 input0;
+in ivec2 input1;
+in ivec2 input2;
+
+out vec4 instance_color;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+// must match rectangle_packed_axis_aligned_t::subpixel
+const float subpixel = 4.0;
+
+vec2 rectangle_vertices[] = vec2[](
+	vec2(-1.0, -1.0),
+	vec2(1.0, -1.0),
+	vec2(1.0, 1.0),
+
+	vec2(1.0, 1.0),
+	vec2(-1.0, 1.0),
+	vec2(-1.0, -1.0)
+);
+
+void main() {
+
+	vec4 layout_color = input0;
+	vec2 layout_position = vec2(input1) / subpixel;
+	vec2 layout_size = vec2(input2) / subpixel;
+
+	gl_Position = projection * view * vec4(layout_position + rectangle_vertices[gl_VertexID % 6] * layout_size, 0, 1);
+
+	instance_color = layout_color;
+}
+)"
@@ -26,6 +26,8 @@ namespace fan_2d {
 		#if fan_renderer == fan_renderer_opengl
 			using fan_2d::opengl::line_t;
 			using fan_2d::opengl::rectangle_t;
+			using fan_2d::opengl::rectangle_packed_t;
+			using fan_2d::opengl::rectangle_packed_axis_aligned_t;
 			using fan_2d::opengl::circle_t;
 			using fan_2d::opengl::sprite_t;
 
@@ -28,7 +28,7 @@ namespace fan_2d {
           #include <fan/graphics/glsl/opengl/2D/effects/particles.fs>
         );
 
-        context->opengl.glEnable(fan::opengl::GL_VERTEX_PROGRAM_POINT_SIZE);
+        context->opengl.enable(fan::opengl::GL_VERTEX_PROGRAM_POINT_SIZE);
 
         m_shader.compile(context);
 
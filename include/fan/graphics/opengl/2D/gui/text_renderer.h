@@ -650,8 +650,8 @@ namespace fan_2d {
 				void draw(fan::opengl::context_t* context, uint32_t begin = 0, uint32_t end = fan::uninitialized) {
 					m_shader.use(context);
 					m_shader.set_int(context, "texture_sampler", 0);
-					context->opengl.glActiveTexture(fan::opengl::GL_TEXTURE0);
-					context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_2D, font_image->texture);
+					context->opengl.active_texture(fan::opengl::GL_TEXTURE0);
+					context->opengl.bind_texture(fan::opengl::GL_TEXTURE_2D, font_image->texture);
 					const fan::vec2 viewport_size = context->viewport_size;
 
 					fan::mat4 projection(1);
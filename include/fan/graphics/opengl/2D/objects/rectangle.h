@@ -12,6 +12,17 @@ namespace fan_2d {
 
 			rectangle_t() = default;
 
+			struct open_properties_t {
+
+				open_properties_t() : buffer_mode(fan::opengl::core::glsl_buffer_t::mode::shadowed), rotation(true) {}
+
+				// fan::opengl::core::glsl_buffer_t::mode
+				uint8_t buffer_mode;
+				// if false, angle, rotation_point and rotation_vector are ignored
+				// and cheaper shader with only offset and scale is used
+				bool rotation;
+			};
+
 			struct properties_t {
 				fan::color color;
 				fan::vec2 position = 0;
@@ -31,13 +42,21 @@ namespace fan_2d {
 			static constexpr uint32_t offset_rotation_vector = offsetof(properties_t, rotation_vector);
 			static constexpr uint32_t element_byte_size = offset_rotation_vector + sizeof(properties_t::rotation_vector);
 
-			void open(fan::opengl::context_t* context) {
+			void open(fan::opengl::context_t* context, open_properties_t p = open_properties_t()) {
 				m_shader.open(context);
 
-				m_shader.set_vertex(
-					context, 
-					#include <fan/graphics/glsl/opengl/2D/objects/rectangle.vs>
-				);
+				if (p.rotation) {
+					m_shader.set_vertex(
+						context, 
+						#include <fan/graphics/glsl/opengl/2D/objects/rectangle.vs>
+					);
+				}
+				else {
+					m_shader.set_vertex(
+						context, 
+						#include <fan/graphics/glsl/opengl/2D/objects/rectangle_axis_aligned.vs>
+					);
+				}
 
 				m_shader.set_fragment(
 					context, 
@@ -46,7 +65,7 @@ namespace fan_2d {
 
 				m_shader.compile(context);
 
-				m_glsl_buffer.open(context);
+				m_glsl_buffer.open(context, p.buffer_mode);
 				m_glsl_buffer.init(context, m_shader.id, element_byte_size);
 				m_queue_helper.open();
 				m_draw_node_reference = fan::uninitialized;
@@ -96,7 +115,7 @@ namespace fan_2d {
 				m_queue_helper.edit(
 					context,
 					i * vertex_count * element_byte_size,
-					m_glsl_buffer.m_buffer.size(),
+					m_glsl_buffer.size(),
 					&m_glsl_buffer
 				);
 			}
@@ -105,7 +124,7 @@ namespace fan_2d {
 
 				m_glsl_buffer.erase_instance(context, begin * vertex_count, end - begin, element_byte_size, vertex_count);
 
-				uint32_t to = m_glsl_buffer.m_buffer.size();
+				uint32_t to = m_glsl_buffer.size();
 
 				m_queue_helper.edit(
 					context,
@@ -280,7 +299,7 @@ namespace fan_2d {
 			}
 
 			uint32_t size(fan::opengl::context_t* context) const {
-				return m_glsl_buffer.m_buffer.size() / element_byte_size / vertex_count;
+				return m_glsl_buffer.size() / element_byte_size / vertex_count;
 			}
 
 
@@ -0,0 +1,402 @@
+#pragma once
+
+#include <fan/graphics/opengl/gl_core.h>
+#include <fan/graphics/opengl/gl_shader.h>
+#include <fan/graphics/shared_graphics.h>
+#include <fan/types/half.h>
+#include <fan/parallel.h>
+
+#include <algorithm>
+
+namespace fan_2d {
+	namespace opengl {
+
+		namespace packed {
+
+			struct rgba8_t {
+				uint8_t r, g, b, a;
+			};
+
+			inline rgba8_t pack_color(const fan::color& color) {
+				auto to_byte = [](f32_t v) -> uint8_t {
+					return (uint8_t)(std::clamp(v, 0.f, 1.f) * 255.f + 0.5f);
+				};
+				return { to_byte(color.r), to_byte(color.g), to_byte(color.b), to_byte(color.a) };
+			}
+
+			inline fan::color unpack_color(const rgba8_t& color) {
+				return fan::color::rgb(color.r, color.g, color.b, color.a);
+			}
+
+			inline fan::mat4 get_projection(fan::opengl::context_t* context) {
+				const fan::vec2 viewport_size = context->viewport_size;
+
+				return fan::math::ortho<fan::mat4>(
+					(f32_t)viewport_size.x * 0.5,
+					((f32_t)viewport_size.x + (f32_t)viewport_size.x * 0.5),
+					((f32_t)viewport_size.y + (f32_t)viewport_size.y * 0.5),
+					((f32_t)viewport_size.y * 0.5),
+					0.01,
+					1000.0
+				);
+			}
+
+			inline fan::mat4 get_view(fan::opengl::context_t* context) {
+				const fan::vec2 viewport_size = context->viewport_size;
+
+				fan::mat4 view(1);
+				return context->camera.get_view_matrix(view.translate(fan::vec3((f_t)viewport_size.x * 0.5, (f_t)viewport_size.y * 0.5, -700.0f)));
+			}
+
+			// rectangle_packed_t
+			struct vertex_t {
+				rgba8_t color;
+				fan::half_t position[2];
+				fan::half_t size[2];
+				fan::half_t angle;
+				uint16_t pad;
+			};
+
+			// rectangle_packed_axis_aligned_t
+			struct axis_aligned_vertex_t {
+				rgba8_t color;
+				int16_t position[2];
+				int16_t size[2];
+			};
+
+			// what both packed layouts share: rgba8 color first, 6 equal vertices per rectangle, same fragment shader
+			template <typename vertex_t>
+			struct rectangle_base_t {
+
+				struct open_properties_t {
+
+					open_properties_t() : buffer_mode(fan::opengl::core::glsl_buffer_t::mode::shadowed) {}
+
+					// fan::opengl::core::glsl_buffer_t::mode
+					uint8_t buffer_mode;
+				};
+
+				static constexpr uint32_t vertex_count = 6;
+
+				static constexpr uint32_t offset_color = offsetof(vertex_t, color);
+				static constexpr uint32_t element_byte_size = sizeof(vertex_t);
+
+				void close(fan::opengl::context_t* context) {
+
+					m_glsl_buffer.close(context);
+					m_queue_helper.close(context);
+					m_shader.close(context);
+
+					if (m_draw_node_reference == (uint32_t)fan::uninitialized) {
+						return;
+					}
+
+					context->disable_draw(m_draw_node_reference);
+					m_draw_node_reference = fan::uninitialized;
+				}
+
+				void erase(fan::opengl::context_t* context, uint32_t begin, uint32_t end) {
+
+					m_glsl_buffer.erase_instance(context, begin * vertex_count, end - begin, element_byte_size, vertex_count);
+
+					uint32_t to = m_glsl_buffer.size();
+
+					m_queue_helper.edit(
+						context,
+						begin * vertex_count * element_byte_size,
+						to,
+						&m_glsl_buffer
+					);
+				}
+
+				// erases everything
+				void clear(fan::opengl::context_t* context) {
+					m_glsl_buffer.clear_ram(context);
+					m_queue_helper.edit(
+						context,
+						0,
+						(this->size(context)) * vertex_count * element_byte_size,
+						&m_glsl_buffer
+					);
+				}
+
+				fan::color get_color(fan::opengl::context_t* context, uint32_t i) const {
+					return unpack_color(*(rgba8_t*)m_glsl_buffer.get_instance(context, i * vertex_count, element_byte_size, offset_color));
+				}
+				void set_color(fan::opengl::context_t* context, uint32_t i, const fan::color& color) {
+					rgba8_t c = pack_color(color);
+					this->edit(context, i, &c, offset_color, sizeof(c));
+				}
+
+				uint32_t size(fan::opengl::context_t*) const {
+					return m_glsl_buffer.size() / element_byte_size / vertex_count;
+				}
+
+				void enable_draw(fan::opengl::context_t* context) {
+					m_draw_node_reference = context->enable_draw(this, [](fan::opengl::context_t* c, void* d) { ((decltype(this))d)->draw(c); });
+				}
+				void disable_draw(fan::opengl::context_t* context) {
+				#if fan_debug >= fan_debug_low
+					if (m_draw_node_reference == (uint32_t)fan::uninitialized) {
+						fan::throw_error("trying to disable unenabled draw call");
+					}
+				#endif
+					context->disable_draw(m_draw_node_reference);
+				}
+
+				// pushed to window draw queue
+				void draw(fan::opengl::context_t* context, uint32_t begin = 0, uint32_t end = fan::uninitialized) {
+					context->set_depth_test(false);
+
+					m_shader.use(context);
+					m_shader.set_projection(context, get_projection(context));
+					m_shader.set_view(context, get_view(context));
+
+					m_glsl_buffer.draw(
+						context,
+						begin * vertex_count,
+						end == (uint32_t)fan::uninitialized ? this->size(context) * vertex_count : end * vertex_count
+					);
+				}
+
+				uint32_t m_draw_node_reference;
+
+				fan::shader_t m_shader;
+				fan::opengl::core::glsl_buffer_t m_glsl_buffer;
+				fan::opengl::core::queue_helper_t m_queue_helper;
+
+			protected:
+
+				// vertex_shader is the source of the layout's vertex shader
+				template <uint32_t attribute_count>
+				void open(fan::opengl::context_t* context, const open_properties_t& p, const std::string& vertex_shader, const fan::opengl::core::glsl_buffer_t::attribute_t (&attributes)[attribute_count]) {
+					m_shader.open(context);
+
+					m_shader.set_vertex(context, vertex_shader);
+
+					m_shader.set_fragment(
+						context,
+						#include <fan/graphics/glsl/opengl/2D/objects/rectangle.fs>
+					);
+
+					m_shader.compile(context);
+
+					m_glsl_buffer.open(context, p.buffer_mode);
+					m_glsl_buffer.init(context, m_shader.id, element_byte_size, attributes, attribute_count);
+					m_queue_helper.open();
+					m_draw_node_reference = fan::uninitialized;
+				}
+
+				void push_back(fan::opengl::context_t* context, const vertex_t& vertex) {
+					for (uint32_t i = 0; i < vertex_count; i++) {
+						m_glsl_buffer.push_ram_instance(context, &vertex, sizeof(vertex));
+					}
+					m_queue_helper.edit(
+						context,
+						(this->size(context) - 1) * vertex_count * element_byte_size,
+						(this->size(context)) * vertex_count * element_byte_size,
+						&m_glsl_buffer
+					);
+				}
+
+				void edit(fan::opengl::context_t* context, uint32_t i, const void* data, uint32_t byte_offset, uint32_t sizeof_data) {
+					for (uint32_t j = 0; j < vertex_count; j++) {
+						m_glsl_buffer.edit_ram_instance(
+							context,
+							i * vertex_count + j,
+							data,
+							element_byte_size,
+							byte_offset,
+							sizeof_data
+						);
+					}
+					m_queue_helper.edit(
+						context,
+						i * vertex_count * element_byte_size + byte_offset,
+						(i + 1) * vertex_count * element_byte_size,
+						&m_glsl_buffer
+					);
+				}
+			};
+		}
+
+		// 16 bytes per vertex (rectangle_t is 60), rgba8 color and half float position, size and angle
+		// half float has 11 bits of precision, positions above 2048 snap to 2 pixels
+		struct rectangle_packed_t : public packed::rectangle_base_t<packed::vertex_t> {
+
+			using vertex_t = packed::vertex_t;
+
+			rectangle_packed_t() = default;
+
+			struct properties_t {
+				fan::color color;
+				fan::vec2 position = 0;
+				fan::vec2 size = 0;
+				f32_t angle = 0;
+			};
+
+			static constexpr uint32_t offset_position = offsetof(vertex_t, position);
+			static constexpr uint32_t offset_size = offsetof(vertex_t, size);
+			static constexpr uint32_t offset_angle = offsetof(vertex_t, angle);
+
+			static_assert(element_byte_size == 16);
+
+			void open(fan::opengl::context_t* context, open_properties_t p = open_properties_t()) {
+				// position and size are read as one vec4
+				static constexpr fan::opengl::core::glsl_buffer_t::attribute_t attributes[] = {
+					{ 4, fan::opengl::GL_UNSIGNED_BYTE, true, false, offset_color },
+					{ 4, fan::opengl::GL_HALF_FLOAT, false, false, offset_position },
+					{ 1, fan::opengl::GL_HALF_FLOAT, false, false, offset_angle }
+				};
+				rectangle_base_t::open(
+					context,
+					p,
+					#include <fan/graphics/glsl/opengl/2D/objects/rectangle_packed.vs>
+					,
+					attributes
+				);
+			}
+
+			void push_back(fan::opengl::context_t* context, const properties_t& properties) {
+				vertex_t vertex;
+				vertex.color = packed::pack_color(properties.color);
+				vertex.position[0] = properties.position.x;
+				vertex.position[1] = properties.position.y;
+				vertex.size[0] = properties.size.x;
+				vertex.size[1] = properties.size.y;
+				vertex.angle = properties.angle;
+				vertex.pad = 0;
+				rectangle_base_t::push_back(context, vertex);
+			}
+
+			fan::vec2 get_position(fan::opengl::context_t* context, uint32_t i) const {
+				auto p = (fan::half_t*)m_glsl_buffer.get_instance(context, i * vertex_count, element_byte_size, offset_position);
+				return fan::vec2(p[0], p[1]);
+			}
+			void set_position(fan::opengl::context_t* context, uint32_t i, const fan::vec2& position) {
+				fan::half_t p[2] = { position.x, position.y };
+				this->edit(context, i, p, offset_position, sizeof(p));
+			}
+
+			fan::vec2 get_size(fan::opengl::context_t* context, uint32_t i) const {
+				auto p = (fan::half_t*)m_glsl_buffer.get_instance(context, i * vertex_count, element_byte_size, offset_size);
+				return fan::vec2(p[0], p[1]);
+			}
+			void set_size(fan::opengl::context_t* context, uint32_t i, const fan::vec2& size) {
+				fan::half_t p[2] = { size.x, size.y };
+				this->edit(context, i, p, offset_size, sizeof(p));
+			}
+
+			f32_t get_angle(fan::opengl::context_t* context, uint32_t i) const {
+				return *(fan::half_t*)m_glsl_buffer.get_instance(context, i * vertex_count, element_byte_size, offset_angle);
+			}
+			void set_angle(fan::opengl::context_t* context, uint32_t i, f32_t angle) {
+				fan::half_t a = (f32_t)fmod(angle, fan::math::pi * 2);
+				this->edit(context, i, &a, offset_angle, sizeof(a));
+			}
+		};
+
+		// 12 bytes per vertex, rgba8 color and int16 position and size in 1/subpixel pixels
+		// no rotation, range is +-32767 / subpixel pixels
+		struct rectangle_packed_axis_aligned_t : public packed::rectangle_base_t<packed::axis_aligned_vertex_t> {
+
+			using vertex_t = packed::axis_aligned_vertex_t;
+
+			rectangle_packed_axis_aligned_t() = default;
+
+			// must match rectangle_packed_axis_aligned.vs
+			static constexpr f32_t subpixel = 4;
+
+			struct properties_t {
+				fan::color color;
+				fan::vec2 position = 0;
+				fan::vec2 size = 0;
+			};
+
+			static constexpr uint32_t offset_position = offsetof(vertex_t, position);
+			static constexpr uint32_t offset_size = offsetof(vertex_t, size);
+
+			static_assert(element_byte_size == 12);
+
+			static int16_t to_fixed(f32_t v) {
+				return (int16_t)std::clamp(std::round(v * subpixel), -32768.f, 32767.f);
+			}
+
+			static vertex_t to_vertex(const properties_t& properties) {
+				vertex_t vertex;
+				vertex.color = packed::pack_color(properties.color);
+				vertex.position[0] = to_fixed(properties.position.x);
+				vertex.position[1] = to_fixed(properties.position.y);
+				vertex.size[0] = to_fixed(properties.size.x);
+				vertex.size[1] = to_fixed(properties.size.y);
+				return vertex;
+			}
+
+			void open(fan::opengl::context_t* context, open_properties_t p = open_properties_t()) {
+				static constexpr fan::opengl::core::glsl_buffer_t::attribute_t attributes[] = {
+					{ 4, fan::opengl::GL_UNSIGNED_BYTE, true, false, offset_color },
+					{ 2, fan::opengl::GL_SHORT, false, true, offset_position },
+					{ 2, fan::opengl::GL_SHORT, false, true, offset_size }
+				};
+				rectangle_base_t::open(
+					context,
+					p,
+					#include <fan/graphics/glsl/opengl/2D/objects/rectangle_packed_axis_aligned.vs>
+					,
+					attributes
+				);
+			}
+
+			void push_back(fan::opengl::context_t* context, const properties_t& properties) {
+				rectangle_base_t::push_back(context, to_vertex(properties));
+			}
+
+			// pushes count rectangles at once, fill(i, properties) is called for every i from several threads
+			// storage is sized once and uploaded with a single edit instead of one per rectangle
+			template <typename fill_t>
+			void push_back(fan::opengl::context_t* context, uint32_t count, fill_t fill) {
+				uint32_t first = this->size(context);
+
+				vertex_t* vertices = (vertex_t*)m_glsl_buffer.push_ram_instances(context, (uint64_t)count * vertex_count * element_byte_size);
+
+				fan::parallel_for(count, [&](uint64_t begin, uint64_t end) {
+					for (uint64_t i = begin; i < end; i++) {
+						properties_t properties;
+						fill((uint32_t)i, properties);
+
+						vertex_t vertex = to_vertex(properties);
+						for (uint32_t j = 0; j < vertex_count; j++) {
+							vertices[i * vertex_count + j] = vertex;
+						}
+					}
+				});
+
+				m_queue_helper.edit(
+					context,
+					first * vertex_count * element_byte_size,
+					(first + count) * vertex_count * element_byte_size,
+					&m_glsl_buffer
+				);
+			}
+
+			fan::vec2 get_position(fan::opengl::context_t* context, uint32_t i) const {
+				auto p = (int16_t*)m_glsl_buffer.get_instance(context, i * vertex_count, element_byte_size, offset_position);
+				return fan::vec2(p[0], p[1]) / subpixel;
+			}
+			void set_position(fan::opengl::context_t* context, uint32_t i, const fan::vec2& position) {
+				int16_t p[2] = { to_fixed(position.x), to_fixed(position.y) };
+				this->edit(context, i, p, offset_position, sizeof(p));
+			}
+
+			fan::vec2 get_size(fan::opengl::context_t* context, uint32_t i) const {
+				auto p = (int16_t*)m_glsl_buffer.get_instance(context, i * vertex_count, element_byte_size, offset_size);
+				return fan::vec2(p[0], p[1]) / subpixel;
+			}
+			void set_size(fan::opengl::context_t* context, uint32_t i, const fan::vec2& size) {
+				int16_t p[2] = { to_fixed(size.x), to_fixed(size.y) };
+				this->edit(context, i, p, offset_size, sizeof(p));
+			}
+		};
+
+	}
+}
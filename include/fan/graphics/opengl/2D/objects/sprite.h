@@ -472,8 +472,8 @@ namespace fan_2d {
             to = 0;
             texture_id = m_store_sprite[i].m_texture;
             m_shader.set_int(context, "texture_sampler", 0);
-            context->opengl.glActiveTexture(fan::opengl::GL_TEXTURE0);
-            context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_2D, texture_id);
+            context->opengl.active_texture(fan::opengl::GL_TEXTURE0);
+            context->opengl.bind_texture(fan::opengl::GL_TEXTURE_2D, texture_id);
           }
           to++;
         }
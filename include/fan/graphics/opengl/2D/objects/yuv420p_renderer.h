@@ -39,6 +39,17 @@ namespace fan_2d {
 				m_draw_node_reference = fan::uninitialized;
 			}
 
+			void close(fan::opengl::context_t* context) {
+				// zeros are skipped by glDeleteBuffers
+				if (!m_unpack_buffers.empty()) {
+					context->opengl.delete_buffers(m_unpack_buffers.size(), m_unpack_buffers.data());
+					m_unpack_buffers.clear();
+				}
+				image_size.clear();
+
+				fan_2d::opengl::sprite_t::close(context);
+			}
+
 			void push_back(fan::opengl::context_t* context, const yuv420p_renderer_t::properties_t& properties) {
 
 				m_store_sprite.resize(m_store_sprite.size() + 3);
@@ -47,7 +58,7 @@ namespace fan_2d {
 				context->opengl.glGenTextures(1, &m_store_sprite[m_store_sprite.size() - 2].m_texture);
 				context->opengl.glGenTextures(1, &m_store_sprite[m_store_sprite.size() - 1].m_texture);
 
-				context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_2D, m_store_sprite[m_store_sprite.size() - 3].m_texture);
+				context->opengl.bind_texture(fan::opengl::GL_TEXTURE_2D, m_store_sprite[m_store_sprite.size() - 3].m_texture);
 
 				context->opengl.glTexImage2D(fan::opengl::GL_TEXTURE_2D, 0, fan::opengl::GL_LUMINANCE, properties.pixel_data.size.x, properties.pixel_data.size.y, 0, fan::opengl::GL_LUMINANCE, fan::opengl::GL_UNSIGNED_BYTE, properties.pixel_data.pixels[0]);
 				//glGenerateMipmap(GL_TEXTURE_2D);
@@ -57,7 +68,7 @@ namespace fan_2d {
 				context->opengl.glTexParameteri(fan::opengl::GL_TEXTURE_2D, fan::opengl::GL_TEXTURE_MIN_FILTER, properties.filter);
 				context->opengl.glTexParameteri(fan::opengl::GL_TEXTURE_2D, fan::opengl::GL_TEXTURE_MAG_FILTER, properties.filter);
 
-				context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_2D, m_store_sprite[m_store_sprite.size() - 2].m_texture);
+				context->opengl.bind_texture(fan::opengl::GL_TEXTURE_2D, m_store_sprite[m_store_sprite.size() - 2].m_texture);
 
 				context->opengl.glTexImage2D(fan::opengl::GL_TEXTURE_2D, 0, fan::opengl::GL_LUMINANCE, properties.pixel_data.size.x / 2, properties.pixel_data.size.y / 2, 0, fan::opengl::GL_LUMINANCE, fan::opengl::GL_UNSIGNED_BYTE, properties.pixel_data.pixels[1]);
 				//	glGenerateMipmap(GL_TEXTURE_2D);
@@ -67,7 +78,7 @@ namespace fan_2d {
 				context->opengl.glTexParameteri(fan::opengl::GL_TEXTURE_2D, fan::opengl::GL_TEXTURE_MIN_FILTER, properties.filter);
 				context->opengl.glTexParameteri(fan::opengl::GL_TEXTURE_2D, fan::opengl::GL_TEXTURE_MAG_FILTER, properties.filter);
 
-				context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_2D, m_store_sprite[m_store_sprite.size() - 1].m_texture);
+				context->opengl.bind_texture(fan::opengl::GL_TEXTURE_2D, m_store_sprite[m_store_sprite.size() - 1].m_texture);
 
 				context->opengl.glTexImage2D(fan::opengl::GL_TEXTURE_2D, 0, fan::opengl::GL_LUMINANCE, properties.pixel_data.size.x / 2, properties.pixel_data.size.y / 2, 0, fan::opengl::GL_LUMINANCE, fan::opengl::GL_UNSIGNED_BYTE, properties.pixel_data.pixels[2]);
 
@@ -78,7 +89,7 @@ namespace fan_2d {
 				context->opengl.glTexParameteri(fan::opengl::GL_TEXTURE_2D, fan::opengl::GL_TEXTURE_MIN_FILTER, properties.filter);
 				context->opengl.glTexParameteri(fan::opengl::GL_TEXTURE_2D, fan::opengl::GL_TEXTURE_MAG_FILTER, properties.filter);
 
-				context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_2D, 0);
+				context->opengl.bind_texture(fan::opengl::GL_TEXTURE_2D, 0);
 
 				sprite_t::properties_t property;
 				property.position = properties.position;
@@ -94,15 +105,68 @@ namespace fan_2d {
 				image_size.emplace_back(properties.pixel_data.size);
 			}
 
+			// same size as before only updates texture contents, persistent textures are never recreated
+			// goes through a pixel unpack buffer when buffers can be mapped, so the copy to gpu doesn't stall the caller
 			void reload_pixels(fan::opengl::context_t* context, uint32_t i, const fan_2d::opengl::pixel_data_t& pixel_data) {
-				context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_2D, m_store_sprite[i * 3].m_texture);
-				context->opengl.glTexImage2D(fan::opengl::GL_TEXTURE_2D, 0, fan::opengl::GL_LUMINANCE, pixel_data.size.x, pixel_data.size.y, 0, fan::opengl::GL_LUMINANCE, fan::opengl::GL_UNSIGNED_BYTE, pixel_data.pixels[0]);
-				context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_2D, m_store_sprite[i * 3 + 1].m_texture);
-				context->opengl.glTexImage2D(fan::opengl::GL_TEXTURE_2D, 0, fan::opengl::GL_LUMINANCE, pixel_data.size.x / 2, pixel_data.size.y / 2, 0, fan::opengl::GL_LUMINANCE, fan::opengl::GL_UNSIGNED_BYTE, pixel_data.pixels[1]);
-				context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_2D, m_store_sprite[i * 3 + 2].m_texture);
-				context->opengl.glTexImage2D(fan::opengl::GL_TEXTURE_2D, 0, fan::opengl::GL_LUMINANCE, pixel_data.size.x / 2, pixel_data.size.y / 2, 0, fan::opengl::GL_LUMINANCE, fan::opengl::GL_UNSIGNED_BYTE, pixel_data.pixels[2]);
-
-				image_size[i] = pixel_data.size;
+				const fan::vec2ui size(pixel_data.size.x, pixel_data.size.y);
+				const fan::vec2ui plane_sizes[3] = { size, size / 2, size / 2 };
+				const bool reallocate = image_size[i] != size;
+
+				uint64_t offsets[3];
+				uint64_t total = 0;
+				for (int p = 0; p < 3; p++) {
+					offsets[p] = total;
+					total += (uint64_t)plane_sizes[p].x * plane_sizes[p].y;
+				}
+
+				auto upload = [&](int p, const void* data) {
+					context->opengl.bind_texture(fan::opengl::GL_TEXTURE_2D, m_store_sprite[i * 3 + p].m_texture);
+					if (reallocate) {
+						context->opengl.glTexImage2D(fan::opengl::GL_TEXTURE_2D, 0, fan::opengl::GL_LUMINANCE, plane_sizes[p].x, plane_sizes[p].y, 0, fan::opengl::GL_LUMINANCE, fan::opengl::GL_UNSIGNED_BYTE, data);
+					}
+					else {
+						context->opengl.glTexSubImage2D(fan::opengl::GL_TEXTURE_2D, 0, 0, 0, plane_sizes[p].x, plane_sizes[p].y, fan::opengl::GL_LUMINANCE, fan::opengl::GL_UNSIGNED_BYTE, data);
+					}
+				};
+
+				uint8_t* mapped = nullptr;
+				if (context->opengl.glMapBufferRange != nullptr && context->opengl.glUnmapBuffer != nullptr) {
+					if (m_unpack_buffers.size() <= i) {
+						m_unpack_buffers.resize(i + 1, 0);
+					}
+					if (m_unpack_buffers[i] == 0) {
+						context->opengl.glGenBuffers(1, &m_unpack_buffers[i]);
+					}
+					context->opengl.bind_buffer(fan::opengl::GL_PIXEL_UNPACK_BUFFER, m_unpack_buffers[i]);
+					// orphan, previous upload may still be reading the old storage
+					context->opengl.glBufferData(fan::opengl::GL_PIXEL_UNPACK_BUFFER, total, nullptr, fan::opengl::GL_STREAM_DRAW);
+					mapped = (uint8_t*)context->opengl.glMapBufferRange(fan::opengl::GL_PIXEL_UNPACK_BUFFER, 0, total, fan::opengl::GL_MAP_WRITE_BIT | fan::opengl::GL_MAP_INVALIDATE_BUFFER_BIT);
+					if (mapped == nullptr) {
+						context->opengl.bind_buffer(fan::opengl::GL_PIXEL_UNPACK_BUFFER, 0);
+					}
+				}
+
+				if (mapped != nullptr) {
+					for (int p = 0; p < 3; p++) {
+						const uint32_t linesize = pixel_data.linesize[p] ? pixel_data.linesize[p] : plane_sizes[p].x;
+						for (uint32_t y = 0; y < plane_sizes[p].y; y++) {
+							std::memcpy(mapped + offsets[p] + (uint64_t)y * plane_sizes[p].x, pixel_data.pixels[p] + (uint64_t)y * linesize, plane_sizes[p].x);
+						}
+					}
+					context->opengl.glUnmapBuffer(fan::opengl::GL_PIXEL_UNPACK_BUFFER);
+					for (int p = 0; p < 3; p++) {
+						upload(p, (const void*)offsets[p]);
+					}
+					// other texture uploads pass client memory
+					context->opengl.bind_buffer(fan::opengl::GL_PIXEL_UNPACK_BUFFER, 0);
+				}
+				else {
+					for (int p = 0; p < 3; p++) {
+						upload(p, pixel_data.pixels[p]);
+					}
+				}
+
+				image_size[i] = size;
 			}
 
 			fan::vec2ui get_image_size(fan::opengl::context_t* context, uint32_t i) const
@@ -126,14 +190,14 @@ namespace fan_2d {
 				m_shader.set_int(context, "sampler_v", 2);
 
 				for (int i = 0; i < sprite_t::size(context); i++) {
-					context->opengl.glActiveTexture(fan::opengl::GL_TEXTURE0 + 0);
-					context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_2D, m_store_sprite[i * 3].m_texture);
+					context->opengl.active_texture(fan::opengl::GL_TEXTURE0 + 0);
+					context->opengl.bind_texture(fan::opengl::GL_TEXTURE_2D, m_store_sprite[i * 3].m_texture);
 
-					context->opengl.glActiveTexture(fan::opengl::GL_TEXTURE0 + 1);
-					context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_2D, m_store_sprite[i * 3 + 1].m_texture);
+					context->opengl.active_texture(fan::opengl::GL_TEXTURE0 + 1);
+					context->opengl.bind_texture(fan::opengl::GL_TEXTURE_2D, m_store_sprite[i * 3 + 1].m_texture);
 
-					context->opengl.glActiveTexture(fan::opengl::GL_TEXTURE0 + 2);
-					context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_2D, m_store_sprite[i * 3 + 2].m_texture);
+					context->opengl.active_texture(fan::opengl::GL_TEXTURE0 + 2);
+					context->opengl.bind_texture(fan::opengl::GL_TEXTURE_2D, m_store_sprite[i * 3 + 2].m_texture);
 
 					const fan::vec2 viewport_size = context->viewport_size;
 
@@ -163,6 +227,8 @@ namespace fan_2d {
 			}
 
 			std::vector<fan::vec2ui> image_size;
+			// per sprite, created on first reload_pixels
+			std::vector<uint32_t> m_unpack_buffers;
 
 			static constexpr auto layout_y = "layout_y";
 			static constexpr auto layout_u = "layout_u";
@@ -120,7 +120,7 @@ namespace fan_3d {
 
         context->disable_draw(m_draw_node_reference);
         m_draw_node_reference = fan::uninitialized;
-        context->opengl.glDeleteBuffers(1, &m_model_instance.m_ebo);
+        context->opengl.delete_buffers(1, &m_model_instance.m_ebo);
         m_model_instance.m_indices.close();
       }
 
@@ -148,7 +148,7 @@ namespace fan_3d {
         }
 
         context->opengl.glGenBuffers(1, &m_model_instance.m_ebo);
-        context->opengl.glBindBuffer(fan::opengl::GL_ELEMENT_ARRAY_BUFFER, m_model_instance.m_ebo);
+        context->opengl.bind_buffer(fan::opengl::GL_ELEMENT_ARRAY_BUFFER, m_model_instance.m_ebo);
         context->opengl.glBufferData(fan::opengl::GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * m_model_instance.m_indices.size(), m_model_instance.m_indices.data(), fan::opengl::GL_STATIC_DRAW);
 
         m_model_instance.m_glsl_buffer.write_vram_all(context);
@@ -333,16 +333,16 @@ namespace fan_3d {
         #endif
 
         m_shader.set_int(context, "texture_diffuse", 0);
-        context->opengl.glActiveTexture(fan::opengl::GL_TEXTURE0);
-        context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_2D, m_textures.diffuse);
+        context->opengl.active_texture(fan::opengl::GL_TEXTURE0);
+        context->opengl.bind_texture(fan::opengl::GL_TEXTURE_2D, m_textures.diffuse);
 
         m_shader.set_int(context, "texture_depth", 1);
-        context->opengl.glActiveTexture(fan::opengl::GL_TEXTURE0 + 1);
-        context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_2D, m_textures.depth);
+        context->opengl.active_texture(fan::opengl::GL_TEXTURE0 + 1);
+        context->opengl.bind_texture(fan::opengl::GL_TEXTURE_2D, m_textures.depth);
 
         m_shader.set_int(context, "skybox", 2);
-        context->opengl.glActiveTexture(fan::opengl::GL_TEXTURE0 + 2);
-        context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_2D, m_model_instance.skybox.texture);
+        context->opengl.active_texture(fan::opengl::GL_TEXTURE0 + 2);
+        context->opengl.bind_texture(fan::opengl::GL_TEXTURE_2D, m_model_instance.skybox.texture);
 
         m_shader.set_mat4(context, "model_input", &m[0][0][0], std::size(m));
         m_shader.set_float(context, "s", s);
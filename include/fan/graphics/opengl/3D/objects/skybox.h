@@ -25,7 +25,7 @@ namespace fan_3d {
         loaded_skybox_t loaded_skybox;
 
         context->opengl.glGenTextures(1, &loaded_skybox.texture);
-        context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_CUBE_MAP, loaded_skybox.texture);
+        context->opengl.bind_texture(fan::opengl::GL_TEXTURE_CUBE_MAP, loaded_skybox.texture);
 
         auto load_side = [] (fan::opengl::context_t* context, std::string_view path, uint8_t i) {
           fan::webp::image_info_t info = fan::webp::load_image(path);
@@ -80,7 +80,7 @@ namespace fan_3d {
         }
         #endif
 
-        context->opengl.glDeleteTextures(1, &m_texture);
+        context->opengl.delete_textures(1, &m_texture);
       }
 
       void set(fan::opengl::context_t* context, const properties_t& properties) {
@@ -116,8 +116,8 @@ namespace fan_3d {
         m_shader.set_projection(context, projection);
         m_shader.set_view(context, view);
 
-        context->opengl.glActiveTexture(fan::opengl::GL_TEXTURE0);
-        context->opengl.glBindTexture(fan::opengl::GL_TEXTURE_CUBE_MAP, m_texture);
+        context->opengl.active_texture(fan::opengl::GL_TEXTURE0);
+        context->opengl.bind_texture(fan::opengl::GL_TEXTURE_CUBE_MAP, m_texture);
         context->opengl.glDrawArrays(fan::opengl::GL_TRIANGLES, 0, 36);
         context->opengl.glDepthFunc(fan::opengl::GL_LESS);
       }
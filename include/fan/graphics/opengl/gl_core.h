@@ -8,8 +8,10 @@
 #include <fan/graphics/camera.h>
 #include <fan/window/window.h>
 #include <fan/types/memory.h>
+#include <fan/time/trace.h>
 
 #include <fan/graphics/opengl/gl_init.h>
+#include <fan/graphics/opengl/gl_program_registry.h>
 #include <fan/graphics/light.h>
 
 #ifdef fan_platform_windows
@@ -108,6 +110,49 @@ namespace fan {
     struct render_flags {
       static constexpr uint16_t depth_test = 1;
     };
+
+    // read back of the back buffer, rows bottom to top (GL order), RGBA
+    // pixels are only valid inside the callback
+    struct capture_frame_t {
+      const uint8_t* pixels;
+      fan::vec2i size;
+      uint32_t stride;
+      uint64_t frame; // render() count when it was read
+    };
+
+    struct capture_stats_t {
+      uint64_t read = 0;       // glReadPixels issued
+      uint64_t delivered = 0;  // handed to the callback
+      uint64_t skipped = 0;    // all slots still in flight, frame not captured
+      uint64_t waited = 0;     // stop_capture or missing fences had to block
+    };
+
+    // glReadPixels into a pixel pack buffer doesn't wait for the GPU, the buffer is mapped
+    // one or two frames later once its fence has signaled, so capturing never stalls the pipeline
+    struct capture_ring_t {
+      static constexpr uint32_t slot_count = 3;
+
+      struct slot_t {
+        uint32_t buffer = 0;
+        uint64_t buffer_size = 0;
+        fan::opengl::GLsync fence = nullptr;
+        bool busy = false;
+        fan::vec2i size;
+        uint64_t frame = 0;
+      };
+
+      slot_t slots[slot_count];
+      uint32_t read_index = 0;   // next slot to read into
+      uint32_t busy_count = 0;   // slots from read_index - busy_count in flight
+
+      void(*callback)(context_t*, const capture_frame_t&, void*) = nullptr;
+      void* userptr = nullptr;
+      uint32_t every = 1;
+      uint64_t remaining = 0;    // frames left to capture, -1 continuous
+      uint64_t frame = 0;
+
+      capture_stats_t stats;
+    };
   }
 
   namespace opengl {
@@ -140,6 +185,17 @@ namespace fan {
       bll_t<draw_queue_t> m_draw_queue;
       bll_t<fan::opengl::core::buffer_queue_t> m_write_queue;
 
+      // scratch memory for the current frame, reset after swap in render()
+      fan::arena_t m_frame_arena;
+
+      // shader programs, deduplicated by source & cached on disk (see program_registry_t::set_directory)
+      fan::opengl::core::program_registry_t m_programs;
+
+      // frames read back in render(), see start_capture
+      fan::opengl::capture_ring_t m_capture;
+
+      typedef void(*capture_cb_t)(context_t*, const capture_frame_t&, void* userptr);
+
       void init();
 
       void bind_to_window(fan::window_t* window, const properties_t& p = properties_t());
@@ -157,6 +213,17 @@ namespace fan {
 
       void set_vsync(fan::window_t* window, bool flag);
 
+      // every n-th rendered frame goes to cb, one or two frames after it was drawn
+      // frames are skipped instead of waiting when the GPU is behind, see get_capture_stats
+      void start_capture(capture_cb_t cb, void* userptr, uint32_t every = 1);
+      // next rendered frame only, buffers are freed once it was delivered
+      void capture_once(capture_cb_t cb, void* userptr);
+      // delivers frames still in flight, then frees the buffers
+      void stop_capture();
+      // frames requested or in flight, keep rendering until false to get them
+      bool is_capturing() const;
+      const fan::opengl::capture_stats_t& get_capture_stats() const;
+
       static void message_callback(GLenum source,
       GLenum type,
       GLuint id,
@@ -172,7 +239,7 @@ namespace fan {
       }
 
       void set_error_callback() {
-        opengl.glEnable(GL_DEBUG_OUTPUT);
+        opengl.enable(GL_DEBUG_OUTPUT);
         opengl.glDebugMessageCallback((GLDEBUGPROC)message_callback, 0);
       }
 
@@ -191,7 +258,7 @@ namespace fan {
       static int get_buffer_size(fan::opengl::context_t* context, uint32_t target_buffer, uint32_t buffer_object) {
         int size = 0;
 
-        context->opengl.glBindBuffer(target_buffer, buffer_object);
+        context->opengl.bind_buffer(target_buffer, buffer_object);
         context->opengl.glGetBufferParameteriv(target_buffer, fan::opengl::GL_BUFFER_SIZE, &size);
 
         return size;
@@ -199,7 +266,7 @@ namespace fan {
 
       static void write_glbuffer(fan::opengl::context_t* context, unsigned int buffer, const void* data, uintptr_t size, uint32_t usage = GL_STATIC_DRAW, uintptr_t target = GL_ARRAY_BUFFER)
       {
-        context->opengl.glBindBuffer(target, buffer);
+        context->opengl.bind_buffer(target, buffer);
 
         context->opengl.glBufferData(target, size, data, usage);
         /*if (target == GL_SHADER_STORAGE_BUFFER) {
@@ -209,7 +276,7 @@ namespace fan {
 
       static void edit_glbuffer(fan::opengl::context_t* context, unsigned int buffer, const void* data, uintptr_t offset, uintptr_t size, uintptr_t target = GL_ARRAY_BUFFER)
       {
-        context->opengl.glBindBuffer(target, buffer);
+        context->opengl.bind_buffer(target, buffer);
 
     #if fan_debug
 
@@ -222,7 +289,6 @@ namespace fan {
     #endif
 
         context->opengl.glBufferSubData(target, offset, size, data);
-        context->opengl.glBindBuffer(target, 0);
        /* if (target == GL_SHADER_STORAGE_BUFFER) {
           glBindBufferBase(target, location, buffer);
         }*/
@@ -244,14 +310,14 @@ namespace fan {
         }
 
         void close(fan::opengl::context_t* context) {
-          context->opengl.glDeleteVertexArrays(1, &m_vao);
+          context->opengl.delete_vertex_arrays(1, &m_vao);
         }
 
         void bind(fan::opengl::context_t* context) const {
-          context->opengl.glBindVertexArray(m_vao);
+          context->opengl.bind_vertex_array(m_vao);
         }
         void unbind(fan::opengl::context_t* context) const {
-          context->opengl.glBindVertexArray(0);
+          context->opengl.bind_vertex_array(0);
         }
 
         uint32_t m_vao;
@@ -264,15 +330,53 @@ namespace fan {
 
         static constexpr uint32_t default_buffer_size = 0xfff;
 
-        void open(fan::opengl::context_t* context) {
+        struct mode {
+          // ram copy, uploaded with glBufferSubData
+          static constexpr uint8_t shadowed = 0;
+          // ram copy, streamed to persistently mapped ring of ring_count regions
+          // falls back to shadowed if glBufferStorage is not supported
+          static constexpr uint8_t persistent_ring = 1;
+          // no ram copy, writes are kept only until every region of a persistently mapped ring of ring_count regions has them
+          // the region about to be drawn is brought up to date by replaying the writes it missed, mapped memory is never read
+          // get_* and insert/erase in the middle are not available
+          // falls back to shadowed if glBufferStorage is not supported
+          static constexpr uint8_t write_only = 2;
+        };
+
+        static constexpr uint32_t ring_count = 3;
+
+        void open(fan::opengl::context_t* context, uint8_t buffer_mode = mode::shadowed) {
           m_buffer_size = 0;
 
+          m_mode = buffer_mode;
+          if (m_mode != mode::shadowed && !context->opengl.has_buffer_storage) {
+            m_mode = mode::shadowed;
+          }
+
           m_vao.open(context);
 
           context->opengl.glGenBuffers(1, &m_vbo);
-          this->allocate_buffer(context, default_buffer_size);
+
+          if (m_mode == mode::shadowed) {
+            this->allocate_buffer(context, default_buffer_size);
+          }
+          else {
+            // ring is allocated in init() when vertex stride is known
+            m_ring_map = nullptr;
+            m_ring_index = 0;
+            for (uint32_t i = 0; i < ring_count; i++) {
+              m_ring_fence[i] = nullptr;
+            }
+          }
+
+          m_write_size = 0;
+          m_attributes.clear();
+          m_pending.clear();
+
           m_buffer.open();
-          m_buffer.reserve(default_buffer_size);
+          if (m_mode != mode::write_only) {
+            m_buffer.reserve(default_buffer_size);
+          }
         }
 
         void close(fan::opengl::context_t* context) {
@@ -281,23 +385,109 @@ namespace fan {
             fan::throw_error("tried to remove non existent vbo");
           }
         #endif
-          context->opengl.glDeleteBuffers(1, &m_vbo);
+          if (m_mode != mode::shadowed) {
+            this->free_ring(context);
+          }
+
+          context->opengl.delete_buffers(1, &m_vbo);
 
           m_vao.close(context);
           m_buffer.close();
         }
 
+        // describes one shader input, location is looked up as "input<index in array>"
+        struct attribute_t {
+          // components, 1-4
+          uint8_t count;
+          // GL_FLOAT, GL_HALF_FLOAT, GL_UNSIGNED_BYTE, GL_SHORT...
+          uint32_t type;
+          // integer types are mapped to 0-1 (-1-1 if signed)
+          bool normalized;
+          // integer types are passed as int/uint to shader
+          bool integer;
+          // byte offset in element
+          uint32_t offset;
+        };
+
+        // custom layout, for packed formats
+        void init(fan::opengl::context_t* context, uint32_t program, uint32_t element_byte_size, const attribute_t* attributes, uint32_t attribute_count) {
+          m_attributes.assign(attributes, attributes + attribute_count);
+          this->init(context, program, element_byte_size);
+        }
+
+        // every input is float vec4 except last which takes the remainder
         void init(fan::opengl::context_t* context, uint32_t program, uint32_t element_byte_size) {
 
+          m_program = program;
+          m_element_byte_size = element_byte_size;
+
+          if (m_mode == mode::persistent_ring) {
+            this->allocate_ring(context, default_buffer_size);
+          }
+          else if (m_mode == mode::write_only) {
+            this->allocate_ring(context, default_buffer_size);
+          }
+
+          this->init_attributes(context);
+        }
+
+        void init_attributes(fan::opengl::context_t* context) {
+
+          uint32_t program = m_program;
+          uint32_t element_byte_size = m_element_byte_size;
+
           m_vao.bind(context);
 
           this->bind(context);
 
+          if (!m_attributes.empty()) {
+            for (uint32_t i = 0; i < m_attributes.size(); i++) {
+              int location = context->opengl.glGetAttribLocation(program, (std::string("input") + std::to_string(i)).c_str());
+              // optimized out by compiler
+              if (location == -1) {
+                continue;
+              }
+              context->opengl.glEnableVertexAttribArray(location);
+
+              const attribute_t& attribute = m_attributes[i];
+
+              if (attribute.integer) {
+              #if fan_debug >= fan_debug_low
+                if (context->opengl.glVertexAttribIPointer == nullptr) {
+                  fan::throw_error("integer vertex attributes are not supported");
+                }
+              #endif
+                context->opengl.glVertexAttribIPointer(
+                  location,
+                  attribute.count,
+                  attribute.type,
+                  element_byte_size,
+                  (void*)(uintptr_t)attribute.offset
+                );
+              }
+              else {
+                context->opengl.glVertexAttribPointer(
+                  location,
+                  attribute.count,
+                  attribute.type,
+                  attribute.normalized,
+                  element_byte_size,
+                  (void*)(uintptr_t)attribute.offset
+                );
+              }
+            }
+            return;
+          }
+
           uint32_t element_count = element_byte_size / sizeof(f32_t) / 4;
 
           for (int i = 0; i < element_count; i++) {
 
             int location = context->opengl.glGetAttribLocation(program, (std::string("input") + std::to_string(i)).c_str());
+            // not used by shader
+            if (location == -1) {
+              continue;
+            }
             context->opengl.glEnableVertexAttribArray(location);
 
             context->opengl.glVertexAttribPointer(
@@ -315,6 +505,9 @@ namespace fan {
           }
 
           int location = context->opengl.glGetAttribLocation(program, (std::string("input") + std::to_string(element_count)).c_str());
+          if (location == -1) {
+            return;
+          }
           context->opengl.glEnableVertexAttribArray(location);
 
           context->opengl.glVertexAttribPointer(
@@ -328,7 +521,7 @@ namespace fan {
         }
 
         void bind(fan::opengl::context_t* context) const {
-          context->opengl.glBindBuffer(fan::opengl::GL_ARRAY_BUFFER, m_vbo);
+          context->opengl.bind_buffer(fan::opengl::GL_ARRAY_BUFFER, m_vbo);
         }
         void unbind() const {
           //glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -338,8 +531,205 @@ namespace fan {
           fan::opengl::core::write_glbuffer(context, m_vbo, nullptr, size);
           m_buffer_size = size;
         }
+
+        // m_buffer_size is size of one region, rounded to full rectangles so gl_VertexID % 6 stays valid
+        void allocate_ring(fan::opengl::context_t* context, uint64_t size) {
+          uint64_t granularity = (uint64_t)m_element_byte_size * 6;
+          m_buffer_size = (size + granularity - 1) / granularity * granularity;
+
+          const uint32_t flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+          this->bind(context);
+          context->opengl.glBufferStorage(GL_ARRAY_BUFFER, m_buffer_size * ring_count, nullptr, flags);
+          m_ring_map = (uint8_t*)context->opengl.glMapBufferRange(GL_ARRAY_BUFFER, 0, m_buffer_size * ring_count, flags);
+
+          if (m_ring_map == nullptr) {
+            fan::throw_error("failed to map persistent buffer");
+          }
+
+          m_ring_index = 0;
+          for (uint32_t i = 0; i < ring_count; i++) {
+            m_ring_fence[i] = nullptr;
+            m_ring_dirty[i].m_min = 0;
+            m_ring_dirty[i].m_max = m_buffer.size();
+          }
+        }
+
+        void free_ring(fan::opengl::context_t* context) {
+          for (uint32_t i = 0; i < ring_count; i++) {
+            if (m_ring_fence[i] != nullptr) {
+              context->opengl.glDeleteSync(m_ring_fence[i]);
+              m_ring_fence[i] = nullptr;
+            }
+          }
+          if (m_ring_map != nullptr) {
+            this->bind(context);
+            context->opengl.glUnmapBuffer(GL_ARRAY_BUFFER);
+            m_ring_map = nullptr;
+          }
+        }
+
+        // storage is immutable, so growing means a new buffer object and new attribute pointers
+        void reallocate_ring(fan::opengl::context_t* context, uint64_t size) {
+          this->free_ring(context);
+          context->opengl.delete_buffers(1, &m_vbo);
+          context->opengl.glGenBuffers(1, &m_vbo);
+          this->allocate_ring(context, size);
+          this->init_attributes(context);
+        }
+
+        // grows geometrically, old contents are copied to every region on gpu side since mapping is not kept in ram
+        void reserve_mapped(fan::opengl::context_t* context, uint64_t size) {
+          if (size <= m_buffer_size) {
+            return;
+          }
+
+          uint64_t new_size = std::max(size, m_buffer_size * 2);
+
+          uint32_t old_vbo = m_vbo;
+          uint32_t old_index = m_ring_index;
+          uint64_t old_region = m_ring_index * m_buffer_size;
+          this->free_ring(context);
+
+          context->opengl.glGenBuffers(1, &m_vbo);
+          this->allocate_ring(context, new_size);
+
+          context->opengl.bind_buffer(GL_COPY_READ_BUFFER, old_vbo);
+          context->opengl.bind_buffer(GL_COPY_WRITE_BUFFER, m_vbo);
+          for (uint32_t i = 0; i < ring_count; i++) {
+            context->opengl.glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, old_region, i * m_buffer_size, m_write_size);
+          }
+          context->opengl.delete_buffers(1, &old_vbo);
+
+          // following cpu writes must not race with the copy, growing is rare enough to wait here
+          m_ring_fence[0] = context->opengl.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+          this->wait_ring(context, 0);
+
+          // every region is now a copy of the old current one, so each write is either in all of them or in none
+          for (auto& write : m_pending) {
+            write.missing = (write.missing & (1 << old_index)) ? all_regions : 0;
+          }
+
+          this->init_attributes(context);
+        }
+
+        // waits until gpu is done reading region i
+        void wait_ring(fan::opengl::context_t* context, uint32_t i) {
+          if (m_ring_fence[i] == nullptr) {
+            return;
+          }
+          uint32_t result;
+          do {
+            result = context->opengl.glClientWaitSync(m_ring_fence[i], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+          } while (result == GL_TIMEOUT_EXPIRED);
+
+        #if fan_debug >= fan_debug_low
+          if (result == GL_WAIT_FAILED) {
+            fan::throw_error("glClientWaitSync failed");
+          }
+        #endif
+
+          context->opengl.glDeleteSync(m_ring_fence[i]);
+          m_ring_fence[i] = nullptr;
+        }
+
+        // write_only: where to write size bytes at offset. The bytes are staged in m_buffer & reach the regions in replay_mapped
+        uint8_t* write_mapped(fan::opengl::context_t* context, uint64_t offset, uint64_t size) {
+          uint64_t data = m_buffer.size();
+          m_buffer.resize(data + size);
+          m_pending.push_back({ offset, size, data, all_regions });
+          return m_buffer.begin() + data;
+        }
+
+        // write_only, before drawing: once the current region has been drawn, staged writes go to the next region, which
+        // waits only if gpu is still reading it. Writes that reached every region are dropped
+        void replay_mapped(fan::opengl::context_t* context) {
+          if (m_pending.empty()) {
+            return;
+          }
+          // keeps moving while anything is staged, so the staging is gone ring_count draws after the last write
+          if (m_ring_fence[m_ring_index] != nullptr) {
+            m_ring_index = (m_ring_index + 1) % ring_count;
+            this->wait_ring(context, m_ring_index);
+          }
+
+          uint8_t* region = m_ring_map + m_ring_index * m_buffer_size;
+          for (auto& write : m_pending) {
+            if (write.missing & (1 << m_ring_index)) {
+              std::memcpy(region + write.offset, m_buffer.begin() + write.data, write.size);
+              write.missing &= ~(1 << m_ring_index);
+            }
+          }
+
+          uint64_t done = 0;
+          while (done < m_pending.size() && m_pending[done].missing == 0) {
+            done++;
+          }
+
+          if (done == m_pending.size()) {
+            m_pending.clear();
+            m_buffer.clear();
+            // a bulk build was staged, don't keep what amounts to a ram copy around
+            if (m_buffer.capacity() > m_write_size / 2) {
+              m_buffer.shrink_to_fit();
+            }
+          }
+          else if (done) {
+            uint64_t bytes = m_pending[done].data;
+            m_buffer.erase(0, bytes);
+            m_pending.erase(m_pending.begin(), m_pending.begin() + done);
+            for (auto& write : m_pending) {
+              write.data -= bytes;
+            }
+          }
+        }
+
+        // bytes in use
+        uint64_t size() const {
+          if (m_mode == mode::write_only) {
+            return m_write_size;
+          }
+          return m_buffer.size();
+        }
+
+        // ram that a shadowed buffer would be holding for the same data, less the writes still waiting for a region
+        uint64_t get_shadow_bytes_saved() const {
+          if (m_mode == mode::write_only) {
+            return m_write_size - std::min(m_write_size, (uint64_t)m_buffer.size());
+          }
+          return 0;
+        }
+
+        void mark_ring_dirty(uint64_t begin, uint64_t end) {
+          for (uint32_t i = 0; i < ring_count; i++) {
+            m_ring_dirty[i].m_min = std::min(m_ring_dirty[i].m_min, begin);
+            m_ring_dirty[i].m_max = std::max(m_ring_dirty[i].m_max, end);
+          }
+        }
+
+        // moves to next region and brings it up to date with the ram copy, waits only if gpu is still reading that region
+        void write_ring(fan::opengl::context_t* context) {
+          uint32_t next = (m_ring_index + 1) % ring_count;
+
+          this->wait_ring(context, next);
+
+          uint64_t begin = m_ring_dirty[next].m_min;
+          uint64_t end = std::min(m_ring_dirty[next].m_max, (uint64_t)m_buffer.size());
+
+          if (begin < end) {
+            std::memcpy(m_ring_map + next * m_buffer_size + begin, m_buffer.begin() + begin, end - begin);
+          }
+
+          m_ring_dirty[next].m_min = fan::uninitialized;
+          m_ring_dirty[next].m_max = 0;
+
+          m_ring_index = next;
+        }
         void* get_buffer_data(GLintptr offset) const {
         #if fan_debug >= fan_debug_low
+          if (m_mode == mode::write_only) {
+            fan::throw_error("write_only buffer has no ram copy to read from");
+          }
           if (offset > m_buffer.size()) {
             fan::throw_error("invalid access");
           }
@@ -348,14 +738,56 @@ namespace fan {
         }
 
         void push_ram_instance(fan::opengl::context_t* context, const void* data, uint32_t element_byte_size) {
+          if (m_mode == mode::write_only) {
+            this->reserve_mapped(context, m_write_size + element_byte_size);
+            std::memcpy(this->write_mapped(context, m_write_size, element_byte_size), data, element_byte_size);
+            m_write_size += element_byte_size;
+            return;
+          }
           m_buffer.insert(m_buffer.size(), (uint8_t*)data, (uint8_t*)data + element_byte_size);
         }
 
+        // appends size bytes in one go and returns where to write them, storage grows at most once
+        // caller fills the range (from any thread) and then queues one edit covering it
+        uint8_t* push_ram_instances(fan::opengl::context_t* context, uint64_t size) {
+          if (m_mode == mode::write_only) {
+            this->reserve_mapped(context, m_write_size + size);
+            uint8_t* ptr = this->write_mapped(context, m_write_size, size);
+            m_write_size += size;
+            return ptr;
+          }
+          uint64_t offset = m_buffer.size();
+          m_buffer.reserve(offset + size);
+          m_buffer.resize(offset + size);
+          return m_buffer.begin() + offset;
+        }
+
         void insert_ram_instance(fan::opengl::context_t* context, uint32_t i, const void* data, uint32_t element_byte_size) {
+          if (m_mode == mode::write_only) {
+          #if fan_debug >= fan_debug_low
+            if (i * element_byte_size != m_write_size) {
+              fan::throw_error("write_only buffer can only insert at the end");
+            }
+          #endif
+            this->push_ram_instance(context, data, element_byte_size);
+            return;
+          }
           m_buffer.insert(i * element_byte_size, (uint8_t*)data, (uint8_t*)data + element_byte_size);
         }
 
         void write_vram_all(fan::opengl::context_t* context) {
+
+          if (m_mode == mode::write_only) {
+            return;
+          }
+
+          if (m_mode == mode::persistent_ring) {
+            if (m_buffer.capacity() > m_buffer_size) {
+              this->reallocate_ring(context, m_buffer.capacity());
+            }
+            this->mark_ring_dirty(0, m_buffer.size());
+            return;
+          }
           
           m_vao.bind(context);
 
@@ -370,6 +802,15 @@ namespace fan {
           return get_buffer_data(i * element_byte_size + byte_offset);
         }
         void edit_ram_instance(fan::opengl::context_t* context, uint32_t i, const void* data, uint32_t element_byte_size, uint32_t byte_offset, uint32_t sizeof_data) {
+          if (m_mode == mode::write_only) {
+          #if fan_debug >= fan_debug_low
+            if (i * element_byte_size + byte_offset + sizeof_data > m_write_size) {
+              fan::throw_error("invalid access");
+            }
+          #endif
+            std::memcpy(this->write_mapped(context, i * element_byte_size + byte_offset, sizeof_data), data, sizeof_data);
+            return;
+          }
           #if fan_debug >= fan_debug_low
             if (i * element_byte_size + byte_offset + sizeof_data > m_buffer.size()) {
               fan::throw_error("invalid access");
@@ -378,12 +819,27 @@ namespace fan {
           std::memmove(m_buffer.begin() + i * element_byte_size + byte_offset, data, sizeof_data);
         }
         void edit_vram_instance(fan::opengl::context_t* context, uint32_t i, const void* data, uint32_t element_byte_size, uint32_t byte_offset, uint32_t sizeof_data) {
+          if (m_mode != mode::shadowed) {
+            // ring storage is not writable with glBufferSubData
+            this->edit_ram_instance(context, i, data, element_byte_size, byte_offset, sizeof_data);
+            if (m_mode == mode::persistent_ring) {
+              this->mark_ring_dirty(i * element_byte_size + byte_offset, i * element_byte_size + byte_offset + sizeof_data);
+            }
+            return;
+          }
           fan::opengl::core::edit_glbuffer(context, m_vbo, data, i * element_byte_size + byte_offset, sizeof_data);
         }
         void edit_vram_buffer(fan::opengl::context_t* context, uint32_t begin, uint32_t end) {
           if (begin == end) {
             return;
           }
+          if (m_mode == mode::write_only) {
+            return;
+          }
+          if (m_mode == mode::persistent_ring) {
+            this->mark_ring_dirty(begin, end);
+            return;
+          }
           if (end > m_buffer_size) {
             this->write_vram_all(context);
           }
@@ -405,6 +861,15 @@ namespace fan {
         }
 
         void erase_instance(fan::opengl::context_t* context, uint32_t i, uint32_t count, uint32_t element_byte_size, uint32_t vertex_count) {
+          if (m_mode == mode::write_only) {
+          #if fan_debug >= fan_debug_low
+            if (i * element_byte_size + element_byte_size * count * vertex_count != m_write_size) {
+              fan::throw_error("write_only buffer can only erase from the end");
+            }
+          #endif
+            m_write_size = i * element_byte_size;
+            return;
+          }
           #if fan_debug >= fan_debug_low
             if (i * element_byte_size > m_buffer.size()) {
               fan::throw_error("invalid access");
@@ -418,6 +883,15 @@ namespace fan {
           //m_buffer_size = m_buffer.capacity();
         }
         void erase(fan::opengl::context_t* context, uint32_t begin, uint32_t end) {
+          if (m_mode == mode::write_only) {
+          #if fan_debug >= fan_debug_low
+            if (end != m_write_size) {
+              fan::throw_error("write_only buffer can only erase from the end");
+            }
+          #endif
+            m_write_size = begin;
+            return;
+          }
         #if fan_debug >= fan_debug_low
           if (begin > m_buffer.size()) {
             fan::throw_error("invalid access");
@@ -432,7 +906,9 @@ namespace fan {
         }
 
         void clear_ram(fan::opengl::context_t* context) {
+          m_write_size = 0;
           m_buffer.clear();
+          m_pending.clear();
         }
 
         template <typename T>
@@ -468,13 +944,59 @@ namespace fan {
         void draw(fan::opengl::context_t* context, uint32_t begin, uint32_t end) {
 
           m_vao.bind(context);
+
+          if (m_mode == mode::write_only) {
+            this->replay_mapped(context);
+          }
+
+          if (m_mode != mode::shadowed) {
+            uint32_t first = m_ring_index * (m_buffer_size / m_element_byte_size);
+            context->opengl.glDrawArrays(GL_TRIANGLES, first + begin, end - begin);
+
+            if (m_ring_fence[m_ring_index] != nullptr) {
+              context->opengl.glDeleteSync(m_ring_fence[m_ring_index]);
+            }
+            m_ring_fence[m_ring_index] = context->opengl.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            return;
+          }
           
           // possibly disable depth test here
           context->opengl.glDrawArrays(GL_TRIANGLES, begin, end - begin);
         }
 
         uint32_t m_vbo;
+        // in persistent_ring & write_only modes size of single region
         uint64_t m_buffer_size;
+        // used bytes in write_only mode
+        uint64_t m_write_size;
+
+        uint8_t m_mode;
+
+        uint32_t m_program;
+        uint32_t m_element_byte_size;
+
+        // empty for default float layout
+        std::vector<attribute_t> m_attributes;
+
+        uint8_t* m_ring_map;
+        uint32_t m_ring_index;
+        fan::opengl::GLsync m_ring_fence[ring_count];
+
+        struct {
+          uint64_t m_min;
+          uint64_t m_max;
+        }m_ring_dirty[ring_count];
+
+        static constexpr uint8_t all_regions = (1 << ring_count) - 1;
+
+        // write_only: staged write of size bytes at m_buffer[data], bit i of missing is set until region i has it
+        struct pending_write_t {
+          uint64_t offset;
+          uint64_t size;
+          uint64_t data;
+          uint8_t missing;
+        };
+        std::vector<pending_write_t> m_pending;
 
         fan::opengl::core::vao_t m_vao;
         
@@ -517,7 +1039,7 @@ inline void fan::opengl::core::queue_helper_t::edit(fan::opengl::context_t* cont
   }
 
 #if fan_debug >= fan_debug_low
-  if (buffer->m_buffer.size() < begin || buffer->m_buffer.size() < end) {
+  if (buffer->size() < begin || buffer->size() < end) {
     fan::throw_error("invalid edit");
   }
 #endif
@@ -550,6 +1072,9 @@ inline void fan::opengl::context_t::init() {
   #endif
 
   m_flags = 0;
+
+  m_frame_arena.open();
+  m_programs.open();
 }
 
 inline void fan::opengl::context_t::bind_to_window(fan::window_t* window, const properties_t& p) {
@@ -632,8 +1157,13 @@ inline void fan::opengl::context_t::bind_to_window(fan::window_t* window, const
 
   #endif
 
-  opengl.glEnable(GL_BLEND);
-  opengl.glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  // may be a different context than before
+  opengl.invalidate_state();
+
+  opengl.enable(GL_BLEND);
+  opengl.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  opengl.query_features();
 }
 
 inline void fan::opengl::context_t::set_viewport(const fan::vec2& viewport_position, const fan::vec2& viewport_size_) {
@@ -651,6 +1181,8 @@ inline void fan::opengl::context_t::process() {
 
   while (it != m_write_queue.end()) {
 
+    fan_trace_scope("gl", "upload");
+
     m_write_queue.start_safe_next(it);
     
     if (m_write_queue[it].glsl_buffer->m_buffer.capacity() > m_write_queue[it].glsl_buffer->m_buffer_size) {
@@ -659,6 +1191,9 @@ inline void fan::opengl::context_t::process() {
     else {
       m_write_queue[it].glsl_buffer->edit_vram_buffer(this, m_write_queue[it].queue_helper->m_min_edit, m_write_queue[it].queue_helper->m_max_edit);
     }
+    if (m_write_queue[it].glsl_buffer->m_mode == fan::opengl::core::glsl_buffer_t::mode::persistent_ring) {
+      m_write_queue[it].glsl_buffer->write_ring(this);
+    }
     m_write_queue[it].queue_helper->on_edit(this);
 
     it = m_write_queue.end_safe_next();
@@ -670,18 +1205,182 @@ inline void fan::opengl::context_t::process() {
   it = m_draw_queue.begin();
 
   while (it != m_draw_queue.end()) {
+    fan_trace_scope("gl", "draw");
     m_draw_queue.start_safe_next(it);
     m_draw_queue[it].draw_cb(this, m_draw_queue[it].data);
     it = m_draw_queue.end_safe_next();
   }
 }
 
+namespace fan {
+  namespace opengl {
+    namespace core {
+
+      // hands finished slots to the callback in read order, stops at the first one the GPU hasn't finished unless wait
+      static void collect_captures(fan::opengl::context_t* context, bool wait) {
+        auto& capture = context->m_capture;
+        auto& opengl = context->opengl;
+
+        while (capture.busy_count) {
+          auto& slot = capture.slots[(capture.read_index + capture_ring_t::slot_count - capture.busy_count) % capture_ring_t::slot_count];
+
+          if (opengl.has_sync) {
+            GLenum result = opengl.glClientWaitSync(slot.fence, wait ? fan::opengl::GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+            if (result == fan::opengl::GL_TIMEOUT_EXPIRED && !wait) {
+              return;
+            }
+            if (result == fan::opengl::GL_CONDITION_SATISFIED || result == fan::opengl::GL_TIMEOUT_EXPIRED) {
+              capture.stats.waited++;
+            }
+            opengl.glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+          }
+          // no fences, assume the copy is done after all slots went around once
+          else if (capture.frame - slot.frame < capture_ring_t::slot_count - 1) {
+            if (!wait) {
+              return;
+            }
+            capture.stats.waited++;
+          }
+
+          uint64_t bytes = (uint64_t)slot.size.x * slot.size.y * 4;
+          opengl.bind_buffer(fan::opengl::GL_PIXEL_PACK_BUFFER, slot.buffer);
+
+          const uint8_t* pixels = nullptr;
+          std::vector<uint8_t> copy;
+          if (opengl.has_sync) {
+            // GL 3.2 context, glMapBufferRange is core
+            pixels = (const uint8_t*)opengl.glMapBufferRange(fan::opengl::GL_PIXEL_PACK_BUFFER, 0, bytes, fan::opengl::GL_MAP_READ_BIT);
+          }
+          else {
+            copy.resize(bytes);
+            opengl.glGetBufferSubData(fan::opengl::GL_PIXEL_PACK_BUFFER, 0, bytes, copy.data());
+            pixels = copy.data();
+          }
+
+          if (pixels != nullptr && capture.callback != nullptr) {
+            capture.callback(context, capture_frame_t{ pixels, slot.size, (uint32_t)slot.size.x * 4, slot.frame }, capture.userptr);
+            capture.stats.delivered++;
+          }
+          if (opengl.has_sync && pixels != nullptr) {
+            opengl.glUnmapBuffer(fan::opengl::GL_PIXEL_PACK_BUFFER);
+          }
+          opengl.bind_buffer(fan::opengl::GL_PIXEL_PACK_BUFFER, 0);
+
+          slot.busy = false;
+          capture.busy_count--;
+        }
+      }
+
+      // queues a copy of the back buffer into the next free slot, skipped when all are in flight
+      static void read_capture(fan::opengl::context_t* context) {
+        auto& capture = context->m_capture;
+        auto& opengl = context->opengl;
+
+        if (capture.busy_count == capture_ring_t::slot_count) {
+          capture.stats.skipped++;
+          return;
+        }
+
+        auto& slot = capture.slots[capture.read_index];
+        slot.size = fan::cast<int>(context->viewport_size);
+        uint64_t bytes = (uint64_t)slot.size.x * slot.size.y * 4;
+        if (bytes == 0) {
+          return;
+        }
+
+        if (slot.buffer == 0) {
+          opengl.glGenBuffers(1, &slot.buffer);
+        }
+        opengl.bind_buffer(fan::opengl::GL_PIXEL_PACK_BUFFER, slot.buffer);
+        if (slot.buffer_size != bytes) {
+          opengl.glBufferData(fan::opengl::GL_PIXEL_PACK_BUFFER, bytes, nullptr, fan::opengl::GL_STREAM_READ);
+          slot.buffer_size = bytes;
+        }
+        // returns once queued, the copy happens on the GPU
+        opengl.glReadPixels(0, 0, slot.size.x, slot.size.y, fan::opengl::GL_RGBA, fan::opengl::GL_UNSIGNED_BYTE, nullptr);
+        opengl.bind_buffer(fan::opengl::GL_PIXEL_PACK_BUFFER, 0);
+
+        if (opengl.has_sync) {
+          slot.fence = opengl.glFenceSync(fan::opengl::GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        slot.frame = capture.frame;
+        slot.busy = true;
+
+        capture.read_index = (capture.read_index + 1) % capture_ring_t::slot_count;
+        capture.busy_count++;
+        capture.stats.read++;
+        if (capture.remaining != (uint64_t)-1) {
+          capture.remaining--;
+        }
+      }
+
+    }
+  }
+}
+
 inline void fan::opengl::context_t::render(fan::window_t* window) {
+  m_capture.frame++;
+  if (m_capture.callback) {
+    // back buffer is undefined after the swap
+    fan_trace_scope("gl", "capture");
+    fan::opengl::core::collect_captures(this, false);
+    if (m_capture.remaining && m_capture.frame % m_capture.every == 0) {
+      fan::opengl::core::read_capture(this);
+    }
+    // capture_once delivered, its pack buffers aren't kept for the next one
+    else if (!m_capture.remaining && !m_capture.busy_count) {
+      this->stop_capture();
+    }
+  }
+
+  fan_trace_scope("gl", "swap");
   #ifdef fan_platform_windows
     SwapBuffers(window->m_hdc);
   #elif defined(fan_platform_unix)
     opengl.internal.glXSwapBuffers(fan::sys::m_display, window->m_window);
   #endif
+
+  m_frame_arena.reset();
+  opengl.end_state_frame();
+}
+
+inline void fan::opengl::context_t::start_capture(capture_cb_t cb, void* userptr, uint32_t every) {
+  if (m_capture.callback != cb || m_capture.userptr != userptr) {
+    // frames in flight belong to the previous callback
+    fan::opengl::core::collect_captures(this, true);
+  }
+  m_capture.callback = cb;
+  m_capture.userptr = userptr;
+  m_capture.every = std::max(every, 1u);
+  m_capture.remaining = -1;
+}
+
+inline void fan::opengl::context_t::capture_once(capture_cb_t cb, void* userptr) {
+  this->start_capture(cb, userptr);
+  m_capture.every = 1;
+  m_capture.remaining = 1;
+}
+
+inline void fan::opengl::context_t::stop_capture() {
+  fan::opengl::core::collect_captures(this, true);
+  for (auto& slot : m_capture.slots) {
+    if (slot.buffer) {
+      opengl.delete_buffers(1, &slot.buffer);
+    }
+    slot = fan::opengl::capture_ring_t::slot_t();
+  }
+  m_capture.read_index = 0;
+  m_capture.callback = nullptr;
+  m_capture.remaining = 0;
+}
+
+inline bool fan::opengl::context_t::is_capturing() const {
+  return m_capture.remaining || m_capture.busy_count;
+}
+
+inline const fan::opengl::capture_stats_t& fan::opengl::context_t::get_capture_stats() const {
+  return m_capture.stats;
 }
 
 inline uint32_t fan::opengl::context_t::enable_draw(void * data, draw_cb_t cb)
@@ -699,14 +1398,14 @@ inline void fan::opengl::context_t::set_depth_test(bool flag)
   switch (flag) {
   case false: {
     if (m_flags & fan::opengl::render_flags::depth_test) {
-      opengl.glDisable(fan::opengl::GL_DEPTH_TEST);
+      opengl.disable(fan::opengl::GL_DEPTH_TEST);
       m_flags &= ~fan::opengl::render_flags::depth_test;
     }
     break;
   }
   default: {
     if (!(m_flags & fan::opengl::render_flags::depth_test)) {
-      opengl.glEnable(fan::opengl::GL_DEPTH_TEST);
+      opengl.enable(fan::opengl::GL_DEPTH_TEST);
       m_flags |= fan::opengl::render_flags::depth_test;
     }
   }
@@ -16,6 +16,7 @@
 
 #include <fan/graphics/opengl/2D/objects/line.h>
 #include <fan/graphics/opengl/2D/objects/rectangle.h>
+#include <fan/graphics/opengl/2D/objects/rectangle_packed.h>
 #include <fan/graphics/opengl/2D/objects/circle.h>
 #include <fan/graphics/opengl/2D/objects/sprite.h>
 #include <fan/graphics/opengl/2D/objects/sprite0.h>
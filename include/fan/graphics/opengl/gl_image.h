@@ -43,7 +43,7 @@ namespace fan {
 			image_t* info = new image_t;
 
 			context->opengl.glGenTextures(1, &info->texture);
-			context->opengl.glBindTexture(GL_TEXTURE_2D, info->texture);
+			context->opengl.bind_texture(GL_TEXTURE_2D, info->texture);
 			context->opengl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, p.visual_output);
 			context->opengl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, p.visual_output);
 			context->opengl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, p.filter);
@@ -54,7 +54,7 @@ namespace fan {
 			context->opengl.glTexImage2D(GL_TEXTURE_2D, 0, p.internal_format, info->size.x, info->size.y, 0, p.format, p.type, image_info.data);
 
 			context->opengl.glGenerateMipmap(GL_TEXTURE_2D);
-			context->opengl.glBindTexture(GL_TEXTURE_2D, 0);
+			context->opengl.bind_texture(GL_TEXTURE_2D, 0);
 
 			return info;
 		}
@@ -82,7 +82,7 @@ namespace fan {
 				fan::throw_error("texture does not exist");
 			}
 		#endif
-			context->opengl.glDeleteTextures(1, &image->texture);
+			context->opengl.delete_textures(1, &image->texture);
 
 		#if fan_debug >= fan_debug_low
 			image->texture = 0;
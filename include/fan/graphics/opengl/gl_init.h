@@ -4,6 +4,9 @@
 
 #include <fan/math/random.h>
 
+#include <algorithm>
+#include <cstring>
+
 #if defined(fan_platform_windows)
   #include <Windows.h>
   #pragma comment(lib, "User32.lib")
@@ -76,7 +79,7 @@ namespace fan {
         #endif
       };
 
-      void open(properties_t* p) {
+      void open([[maybe_unused]] properties_t* p) {
         #if defined(fan_platform_windows)
           // create dummy window to initialize functions thank u microsoft
           // generate random class name to dont collide with other window classes xd
@@ -169,7 +172,7 @@ namespace fan {
 
         #endif
       }
-      void close(const properties_t* p) {
+      void close([[maybe_unused]] const properties_t* p) {
         #if defined(fan_platform_windows)
           wglMakeCurrent(p->hdc, 0);
           wglDeleteContext(p->context);
@@ -236,6 +239,23 @@ namespace fan {
         #endif
       }
 
+      // same as get_proc_address, but missing functions are not an error
+      static void* get_optional_proc_address(const char* name, internal_t* internal)
+      {
+        #if defined(fan_platform_windows)
+          void *p = (void *)wglGetProcAddress(name);
+        if(p == (void*)0x1 || p == (void*)0x2 || p == (void*)0x3 || p == (void*)-1) {
+          p = 0;
+        }
+        return p;
+
+        #elif defined(fan_platform_unix)
+
+        return (void*)internal->glXGetProcAddress((const GLubyte*)name);
+
+        #endif
+      }
+
     public:
 
       void open() {
@@ -274,6 +294,8 @@ namespace fan {
         glDeleteTextures = (decltype(glDeleteTextures))get_proc_address("glDeleteTextures", &internal);
         glBindTexture = (decltype(glBindTexture))get_proc_address("glBindTexture", &internal);
         glTexImage2D = (decltype(glTexImage2D))get_proc_address("glTexImage2D", &internal);
+        glTexSubImage2D = (decltype(glTexSubImage2D))get_proc_address("glTexSubImage2D", &internal);
+        glPixelStorei = (decltype(glPixelStorei))get_proc_address("glPixelStorei", &internal);
         glTexParameteri = (decltype(glTexParameteri))get_proc_address("glTexParameteri", &internal);
         glActiveTexture = (decltype(glActiveTexture))get_proc_address("glActiveTexture", &internal);
         glAttachShader = (decltype(glAttachShader))get_proc_address("glAttachShader", &internal);
@@ -311,12 +333,222 @@ namespace fan {
         glPolygonMode = (decltype(glPolygonMode))get_proc_address("glPolygonMode", &internal);
         glUniform1uiv = (decltype(glUniform1uiv))get_proc_address("glUniform1uiv", &internal);
         glUniform1fv = (decltype(glUniform1fv))get_proc_address("glUniform1fv", &internal);
+        glReadPixels = (decltype(glReadPixels))get_proc_address("glReadPixels", &internal);
+        glGetBufferSubData = (decltype(glGetBufferSubData))get_proc_address("glGetBufferSubData", &internal);
+
+        // GL 3.2+/4.4+, checked against the context version in query_features()
+        glBufferStorage = (decltype(glBufferStorage))get_optional_proc_address("glBufferStorage", &internal);
+        glMapBufferRange = (decltype(glMapBufferRange))get_optional_proc_address("glMapBufferRange", &internal);
+        glUnmapBuffer = (decltype(glUnmapBuffer))get_optional_proc_address("glUnmapBuffer", &internal);
+        glFenceSync = (decltype(glFenceSync))get_optional_proc_address("glFenceSync", &internal);
+        glClientWaitSync = (decltype(glClientWaitSync))get_optional_proc_address("glClientWaitSync", &internal);
+        glDeleteSync = (decltype(glDeleteSync))get_optional_proc_address("glDeleteSync", &internal);
+        glGetStringi = (decltype(glGetStringi))get_optional_proc_address("glGetStringi", &internal);
+        glCopyBufferSubData = (decltype(glCopyBufferSubData))get_optional_proc_address("glCopyBufferSubData", &internal);
+        glVertexAttribIPointer = (decltype(glVertexAttribIPointer))get_optional_proc_address("glVertexAttribIPointer", &internal);
+        glGetProgramBinary = (decltype(glGetProgramBinary))get_optional_proc_address("glGetProgramBinary", &internal);
+        glProgramBinary = (decltype(glProgramBinary))get_optional_proc_address("glProgramBinary", &internal);
+        glProgramParameteri = (decltype(glProgramParameteri))get_optional_proc_address("glProgramParameteri", &internal);
 
         internal.close(&p);
 
         opengl_initialized = true;
       }
 
+      // needs current context
+      void query_features() {
+        int major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+        bool sync = major > 3 || (major == 3 && minor >= 2) || has_extension("GL_ARB_sync");
+        bool storage = major > 4 || (major == 4 && minor >= 4) || has_extension("GL_ARB_buffer_storage");
+
+        has_sync = sync && glFenceSync && glClientWaitSync && glDeleteSync;
+
+        has_buffer_storage =
+          sync && storage &&
+          glBufferStorage && glMapBufferRange && glUnmapBuffer &&
+          glFenceSync && glClientWaitSync && glDeleteSync &&
+          glCopyBufferSubData;
+
+        // GL 4.1+ or ARB_get_program_binary, drivers may still support zero formats
+        int binary_formats = 0;
+        if (glGetProgramBinary && glProgramBinary && glProgramParameteri) {
+          glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binary_formats);
+        }
+        has_program_binary = binary_formats > 0;
+      }
+
+      bool has_extension(const char* name) {
+        if (glGetStringi == nullptr) {
+          return false;
+        }
+        int count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (int i = 0; i < count; i++) {
+          const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+          if (extension && !strcmp(extension, name)) {
+            return true;
+          }
+        }
+        return false;
+      }
+
+      // state cache, binds and toggles through these are skipped when nothing would change
+      // anything calling the raw gl functions for tracked state must call invalidate_state() after
+
+      struct state_stats_t {
+        uint32_t issued = 0;
+        uint32_t elided = 0;
+      };
+
+      static constexpr uint32_t state_texture_units = 16;
+      static constexpr uint32_t state_unknown = -1;
+
+      // forgets everything, next call of each kind always goes to the driver
+      void invalidate_state() {
+        m_state.program = state_unknown;
+        m_state.vertex_array = state_unknown;
+        m_state.array_buffer = state_unknown;
+        m_state.active_texture = state_unknown;
+        std::fill(m_state.textures, m_state.textures + state_texture_units, state_unknown);
+        m_state.blend = -1;
+        m_state.depth_test = -1;
+        m_state.blend_src = state_unknown;
+        m_state.blend_dst = state_unknown;
+      }
+
+      void use_program(uint32_t program) {
+        if (state_changed(m_state.program, program)) {
+          glUseProgram(program);
+        }
+      }
+
+      void bind_vertex_array(uint32_t vertex_array) {
+        if (state_changed(m_state.vertex_array, vertex_array)) {
+          glBindVertexArray(vertex_array);
+        }
+      }
+
+      // only GL_ARRAY_BUFFER is tracked, element array binding belongs to the vao
+      void bind_buffer(uint32_t target, uint32_t buffer) {
+        if (target != GL_ARRAY_BUFFER) {
+          m_state_stats.issued++;
+          glBindBuffer(target, buffer);
+          return;
+        }
+        if (state_changed(m_state.array_buffer, buffer)) {
+          glBindBuffer(target, buffer);
+        }
+      }
+
+      // GL_TEXTURE0 + unit
+      void active_texture(uint32_t texture) {
+        if (state_changed(m_state.active_texture, texture)) {
+          glActiveTexture(texture);
+        }
+      }
+
+      // GL_TEXTURE_2D tracked per unit, other targets always issued
+      void bind_texture(uint32_t target, uint32_t texture) {
+        uint32_t unit = m_state.active_texture - GL_TEXTURE0;
+        if (target == GL_TEXTURE_2D && unit < state_texture_units) {
+          if (state_changed(m_state.textures[unit], texture)) {
+            glBindTexture(target, texture);
+          }
+          return;
+        }
+        if (target == GL_TEXTURE_2D) {
+          // unit unknown, other units may now be stale
+          std::fill(m_state.textures, m_state.textures + state_texture_units, state_unknown);
+        }
+        m_state_stats.issued++;
+        glBindTexture(target, texture);
+      }
+
+      // GL_BLEND and GL_DEPTH_TEST tracked, others always issued
+      void enable(uint32_t capability) {
+        set_capability(capability, true);
+      }
+
+      void disable(uint32_t capability) {
+        set_capability(capability, false);
+      }
+
+      void blend_func(uint32_t src, uint32_t dst) {
+        if (m_state.blend_src == src && m_state.blend_dst == dst) {
+          m_state_stats.elided++;
+          return;
+        }
+        m_state.blend_src = src;
+        m_state.blend_dst = dst;
+        m_state_stats.issued++;
+        glBlendFunc(src, dst);
+      }
+
+      // deleted names get reused by the driver, cache must not think they are still bound
+
+      void delete_program(uint32_t program) {
+        if (m_state.program == program) {
+          m_state.program = 0;
+        }
+        glDeleteProgram(program);
+      }
+
+      void delete_vertex_arrays(int count, const uint32_t* vertex_arrays) {
+        for (int i = 0; i < count; i++) {
+          if (m_state.vertex_array == vertex_arrays[i]) {
+            m_state.vertex_array = 0;
+          }
+        }
+        glDeleteVertexArrays(count, vertex_arrays);
+      }
+
+      void delete_buffers(int count, const uint32_t* buffers) {
+        for (int i = 0; i < count; i++) {
+          if (m_state.array_buffer == buffers[i]) {
+            m_state.array_buffer = 0;
+          }
+        }
+        glDeleteBuffers(count, buffers);
+      }
+
+      void delete_textures(int count, const uint32_t* textures) {
+        for (int i = 0; i < count; i++) {
+          for (uint32_t unit = 0; unit < state_texture_units; unit++) {
+            if (m_state.textures[unit] == textures[i]) {
+              m_state.textures[unit] = 0;
+            }
+          }
+        }
+        glDeleteTextures(count, textures);
+      }
+
+      // counts since last end_state_frame()
+      const state_stats_t& get_state_stats() const {
+        return m_state_stats;
+      }
+
+      // counts of the last finished frame
+      const state_stats_t& get_frame_state_stats() const {
+        return m_frame_state_stats;
+      }
+
+      void end_state_frame() {
+        m_frame_state_stats = m_state_stats;
+        m_state_stats = state_stats_t();
+      }
+
+      // persistent mapped buffers with fence syncs
+      bool has_buffer_storage = false;
+
+      // glFenceSync & co, GL 3.2+ or ARB_sync
+      bool has_sync = false;
+
+      // glGetProgramBinary/glProgramBinary usable
+      bool has_program_binary = false;
+
       internal_t internal;
 
       PFNGLVIEWPORTPROC glViewport;
@@ -345,6 +577,8 @@ namespace fan {
       PFNGLDELETETEXTURESPROC glDeleteTextures;
       PFNGLBINDTEXTUREPROC glBindTexture;
       PFNGLTEXIMAGE2DPROC glTexImage2D;
+      PFNGLTEXSUBIMAGE2DPROC glTexSubImage2D;
+      PFNGLPIXELSTOREIPROC glPixelStorei;
       PFNGLTEXPARAMETERIPROC glTexParameteri;
       PFNGLACTIVETEXTUREPROC glActiveTexture;
       PFNGLATTACHSHADERPROC glAttachShader;
@@ -382,6 +616,75 @@ namespace fan {
       PFNGLPOLYGONMODEPROC glPolygonMode;
       PFNGLUNIFORM1UIVPROC glUniform1uiv;
       PFNGLUNIFORM4FVPROC glUniform1fv;
+      PFNGLREADPIXELSPROC glReadPixels;
+      PFNGLGETBUFFERSUBDATAPROC glGetBufferSubData;
+
+      PFNGLBUFFERSTORAGEPROC glBufferStorage;
+      PFNGLMAPBUFFERRANGEPROC glMapBufferRange;
+      PFNGLUNMAPBUFFERPROC glUnmapBuffer;
+      PFNGLFENCESYNCPROC glFenceSync;
+      PFNGLCLIENTWAITSYNCPROC glClientWaitSync;
+      PFNGLDELETESYNCPROC glDeleteSync;
+      PFNGLGETSTRINGIPROC glGetStringi;
+      PFNGLCOPYBUFFERSUBDATAPROC glCopyBufferSubData;
+      PFNGLVERTEXATTRIBIPOINTERPROC glVertexAttribIPointer;
+      PFNGLGETPROGRAMBINARYPROC glGetProgramBinary;
+      PFNGLPROGRAMBINARYPROC glProgramBinary;
+      PFNGLPROGRAMPARAMETERIPROC glProgramParameteri;
+
+    protected:
+
+      bool state_changed(uint32_t& current, uint32_t value) {
+        if (current == value) {
+          m_state_stats.elided++;
+          return false;
+        }
+        current = value;
+        m_state_stats.issued++;
+        return true;
+      }
+
+      void set_capability(uint32_t capability, bool flag) {
+        int8_t* current = nullptr;
+        switch (capability) {
+          case GL_BLEND: { current = &m_state.blend; break; }
+          case GL_DEPTH_TEST: { current = &m_state.depth_test; break; }
+        }
+        if (current != nullptr) {
+          if (*current == flag) {
+            m_state_stats.elided++;
+            return;
+          }
+          *current = flag;
+        }
+        m_state_stats.issued++;
+        if (flag) {
+          glEnable(capability);
+        }
+        else {
+          glDisable(capability);
+        }
+      }
+
+      // state_unknown / -1 = unknown
+      struct state_t {
+        uint32_t program = state_unknown;
+        uint32_t vertex_array = state_unknown;
+        uint32_t array_buffer = state_unknown;
+        uint32_t active_texture = state_unknown;
+        uint32_t textures[state_texture_units] = {
+          state_unknown, state_unknown, state_unknown, state_unknown, state_unknown, state_unknown, state_unknown, state_unknown,
+          state_unknown, state_unknown, state_unknown, state_unknown, state_unknown, state_unknown, state_unknown, state_unknown
+        };
+        int8_t blend = -1;
+        int8_t depth_test = -1;
+        uint32_t blend_src = state_unknown;
+        uint32_t blend_dst = state_unknown;
+      };
+
+      state_t m_state;
+      state_stats_t m_state_stats;
+      state_stats_t m_frame_state_stats;
 
     };
 
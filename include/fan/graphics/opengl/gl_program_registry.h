@@ -0,0 +1,291 @@
+#pragma once
+
+#include <fan/types/types.h>
+#include <fan/time/time.h>
+#include <fan/io/log.h>
+
+#include <fan/graphics/opengl/gl_init.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+namespace fan {
+  namespace opengl {
+    namespace core {
+
+      // programs shared by every object that uses identical sources, reference counted
+      // linked programs are also stored to disk with glGetProgramBinary so next start skips compiling
+      // disk cache key is hash of sources + vendor/renderer/version, a driver update gives new files
+      struct program_registry_t {
+
+        struct stats_t {
+          uint32_t compiled = 0;
+          uint32_t loaded = 0;    // from disk cache
+          uint32_t shared = 0;    // reused an already open program
+          uint64_t time = 0;      // nanoseconds spent in acquire
+        };
+
+        void open() {
+          m_directory.clear();
+          m_stats = stats_t();
+        }
+
+        // empty disables disk cache, needs current context
+        void set_directory(fan::opengl::opengl_t& opengl, const std::string& directory) {
+          m_directory = directory;
+          m_driver.clear();
+          if (directory.empty()) {
+            return;
+          }
+          std::error_code ec;
+          std::filesystem::create_directories(directory, ec);
+          for (uint32_t name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+            const char* str = (const char*)opengl.glGetString(name);
+            m_driver += str ? str : "";
+            m_driver += '\n';
+          }
+        }
+
+        // returns linked program, throws if sources don't compile
+        uint32_t acquire(fan::opengl::opengl_t& opengl, const std::string& vertex, const std::string& fragment, const std::string& geometry) {
+          uint64_t start = fan::time::clock::now();
+
+          uint64_t key = hash(vertex, fragment, geometry);
+
+          auto found = m_programs.find(key);
+          if (found != m_programs.end() && found->second.vertex == vertex && found->second.fragment == fragment && found->second.geometry == geometry) {
+            found->second.references++;
+            m_stats.shared++;
+            m_stats.time += fan::time::clock::now() - start;
+            return found->second.id;
+          }
+
+          uint32_t id = this->load_binary(opengl, key);
+          if (id == (uint32_t)fan::uninitialized) {
+            id = this->compile(opengl, vertex, fragment, geometry);
+            this->save_binary(opengl, key, id);
+            m_stats.compiled++;
+          }
+          else {
+            m_stats.loaded++;
+          }
+
+          // on hash collision the older entry just stops being shared
+          m_ids[id] = key;
+          m_programs[key] = program_t{ id, 1, vertex, fragment, geometry };
+
+          m_stats.time += fan::time::clock::now() - start;
+          return id;
+        }
+
+        void release(fan::opengl::opengl_t& opengl, uint32_t id) {
+          auto found = m_ids.find(id);
+          if (found == m_ids.end()) {
+            opengl.delete_program(id);
+            return;
+          }
+          auto program = m_programs.find(found->second);
+          if (program != m_programs.end() && program->second.id == id) {
+            if (--program->second.references) {
+              return;
+            }
+            m_programs.erase(program);
+          }
+          m_ids.erase(found);
+          opengl.delete_program(id);
+        }
+
+        const stats_t& get_stats() const {
+          return m_stats;
+        }
+
+      protected:
+
+        struct program_t {
+          uint32_t id;
+          uint32_t references;
+          std::string vertex;
+          std::string fragment;
+          std::string geometry;
+        };
+
+        // fnv-1a
+        static uint64_t hash(const std::string& vertex, const std::string& fragment, const std::string& geometry, const std::string& salt = std::string()) {
+          uint64_t h = 0xcbf29ce484222325ull;
+          for (const std::string* str : { &vertex, &fragment, &geometry, &salt }) {
+            for (uint8_t c : *str) {
+              h = (h ^ c) * 0x100000001b3ull;
+            }
+            // separator so moving text between stages changes the hash
+            h = (h ^ 0xff) * 0x100000001b3ull;
+          }
+          return h;
+        }
+
+        std::string get_path(uint64_t key) const {
+          char name[32];
+          std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash(std::to_string(key), m_driver, std::string()));
+          return m_directory + "/" + name;
+        }
+
+        static constexpr uint32_t binary_magic = 0x6e626670; // "pfbn"
+
+        uint32_t load_binary(fan::opengl::opengl_t& opengl, uint64_t key) {
+          if (m_directory.empty() || !opengl.has_program_binary) {
+            return fan::uninitialized;
+          }
+
+          std::FILE* file = std::fopen(get_path(key).c_str(), "rb");
+          if (file == nullptr) {
+            return fan::uninitialized;
+          }
+
+          uint32_t header[3];
+          std::string blob;
+          bool ok = std::fread(header, sizeof(header), 1, file) == 1 && header[0] == binary_magic;
+          if (ok) {
+            blob.resize(header[2]);
+            ok = std::fread(blob.data(), 1, blob.size(), file) == blob.size();
+          }
+          std::fclose(file);
+
+          if (!ok) {
+            return fan::uninitialized;
+          }
+
+          uint32_t id = opengl.glCreateProgram();
+          opengl.glProgramBinary(id, header[1], blob.data(), blob.size());
+
+          // driver may reject binaries of other versions, compile from source then
+          int status = 0;
+          opengl.glGetProgramiv(id, GL_LINK_STATUS, &status);
+          if (!status) {
+            opengl.delete_program(id);
+            return fan::uninitialized;
+          }
+          return id;
+        }
+
+        void save_binary(fan::opengl::opengl_t& opengl, uint64_t key, uint32_t id) {
+          if (m_directory.empty() || !opengl.has_program_binary) {
+            return;
+          }
+
+          int length = 0;
+          opengl.glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &length);
+          if (length <= 0) {
+            return;
+          }
+
+          std::string blob;
+          blob.resize(length);
+          uint32_t format = 0;
+          opengl.glGetProgramBinary(id, length, &length, &format, blob.data());
+
+          std::FILE* file = std::fopen(get_path(key).c_str(), "wb");
+          if (file == nullptr) {
+            return;
+          }
+          uint32_t header[3] = { binary_magic, format, (uint32_t)length };
+          std::fwrite(header, sizeof(header), 1, file);
+          std::fwrite(blob.data(), 1, length, file);
+          std::fclose(file);
+        }
+
+        uint32_t compile(fan::opengl::opengl_t& opengl, const std::string& vertex, const std::string& fragment, const std::string& geometry) {
+          uint32_t id = opengl.glCreateProgram();
+
+          uint32_t shaders[3];
+          uint32_t shader_count = 0;
+
+          const std::pair<const std::string*, uint32_t> stages[] = {
+            { &vertex, GL_VERTEX_SHADER },
+            { &fragment, GL_FRAGMENT_SHADER },
+            { &geometry, GL_GEOMETRY_SHADER }
+          };
+          for (auto& stage : stages) {
+            if (stage.first->empty()) {
+              continue;
+            }
+            uint32_t shader = opengl.glCreateShader(stage.second);
+            const char* ptr = stage.first->c_str();
+            opengl.glShaderSource(shader, 1, &ptr, NULL);
+            opengl.glCompileShader(shader);
+            shaders[shader_count++] = shader;
+            if (!check_errors(opengl, shader, false)) {
+              delete_objects(opengl, id, shaders, shader_count);
+              throw std::runtime_error("failed to compile shaders");
+            }
+            opengl.glAttachShader(id, shader);
+          }
+
+          if (!m_directory.empty() && opengl.has_program_binary) {
+            opengl.glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+          }
+
+          opengl.glLinkProgram(id);
+          if (!check_errors(opengl, id, true)) {
+            delete_objects(opengl, id, shaders, shader_count);
+            throw std::runtime_error("failed to compile shaders");
+          }
+
+          for (uint32_t i = 0; i < shader_count; i++) {
+            opengl.glDeleteShader(shaders[i]);
+          }
+
+          return id;
+        }
+
+        // compiling or linking failed, deletes the shaders created so far & the program
+        static void delete_objects(fan::opengl::opengl_t& opengl, uint32_t program, const uint32_t* shaders, uint32_t shader_count) {
+          for (uint32_t i = 0; i < shader_count; i++) {
+            opengl.glDeleteShader(shaders[i]);
+          }
+          opengl.delete_program(program);
+        }
+
+        // logs the info log, false if compiling or linking failed
+        static bool check_errors(fan::opengl::opengl_t& opengl, uint32_t object, bool program) {
+          int success = 0;
+          int buffer_size = 0;
+          if (program) {
+            opengl.glGetProgramiv(object, GL_LINK_STATUS, &success);
+            opengl.glGetProgramiv(object, GL_INFO_LOG_LENGTH, &buffer_size);
+          }
+          else {
+            opengl.glGetShaderiv(object, GL_COMPILE_STATUS, &success);
+            opengl.glGetShaderiv(object, GL_INFO_LOG_LENGTH, &buffer_size);
+          }
+
+          if (success) {
+            return true;
+          }
+
+          std::string buffer;
+          buffer.resize(std::max(buffer_size, 1));
+          if (program) {
+            opengl.glGetProgramInfoLog(object, buffer.size(), nullptr, buffer.data());
+          }
+          else {
+            opengl.glGetShaderInfoLog(object, buffer.size(), nullptr, buffer.data());
+          }
+
+          fan_log_error(program ? "failed to link program" : "failed to compile shader", buffer);
+          return false;
+        }
+
+        std::unordered_map<uint64_t, program_t> m_programs;
+        // program id -> key in m_programs
+        std::unordered_map<uint32_t, uint64_t> m_ids;
+
+        std::string m_directory;
+        std::string m_driver;
+
+        stats_t m_stats;
+      };
+
+    }
+  }
+}
@@ -25,9 +25,9 @@ namespace fan {
     void open(fan::opengl::context_t* context) {
       id = fan::uninitialized;
 
-      vertex = fan::uninitialized;
-      fragment = fan::uninitialized;
-      geometry = fan::uninitialized;
+      vertex.clear();
+      fragment.clear();
+      geometry.clear();
     }
 
     void close(fan::opengl::context_t* context) {
@@ -36,99 +36,41 @@ namespace fan {
 
     void use(fan::opengl::context_t* context) const
     {
-      context->opengl.glUseProgram(id);
+      context->opengl.use_program(id);
     }
 
     void remove(fan::opengl::context_t* context) {
       fan_validate_buffer(id, {
-        context->opengl.glValidateProgram(id);
-      int status = 0;
-      context->opengl.glGetProgramiv(id, fan::opengl::GL_VALIDATE_STATUS, &status);
-      if (status) {
-        context->opengl.glDeleteProgram(id);
-      }
-      id = fan::uninitialized;
-        });
+        context->m_programs.release(context->opengl, id);
+        id = fan::uninitialized;
+      });
     }
 
-    void set_vertex(fan::opengl::context_t* context, const std::string& vertex_code) {
-
-      if (vertex != fan::uninitialized) {
-        context->opengl.glDeleteShader(vertex);
-      }
-
-      vertex = context->opengl.glCreateShader(fan::opengl::GL_VERTEX_SHADER);
-
-      char* ptr = (char*)vertex_code.c_str();
+    // sources are only stored, compile() builds the program
 
-      context->opengl.glShaderSource(vertex, 1, &ptr, NULL);
-
-      context->opengl.glCompileShader(vertex);
-
-      checkCompileErrors(context, vertex, "VERTEX");
+    void set_vertex(fan::opengl::context_t* context, const std::string& vertex_code) {
+      vertex = vertex_code;
     }
 
     void set_fragment(fan::opengl::context_t* context, const std::string& fragment_code) {
-
-      if (fragment != -1) {
-        context->opengl.glDeleteShader(fragment);
-      }
-
-      fragment = context->opengl.glCreateShader(fan::opengl::GL_FRAGMENT_SHADER);
-
-      char* ptr = (char*)fragment_code.c_str();
-
-      context->opengl.glShaderSource(fragment, 1, &ptr, NULL);
-
-      context->opengl.glCompileShader(fragment);
-      checkCompileErrors(context, fragment, "FRAGMENT");
+      fragment = fragment_code;
     }
 
     void set_geometry(fan::opengl::context_t* context, const std::string& geometry_code) {
-      if (geometry != -1) {
-        context->opengl.glDeleteShader(geometry);
-      }
-
-      geometry = context->opengl.glCreateShader(fan::opengl::GL_GEOMETRY_SHADER);
-
-      char* ptr = (char*)geometry_code.c_str();
-      context->opengl.glShaderSource(geometry, 1, &ptr, NULL);
-
-      context->opengl.glCompileShader(geometry);
-      checkCompileErrors(context, geometry, "GEOMETRY");
+      geometry = geometry_code;
     }
 
+    // program is shared with other shaders of same sources, or loaded from disk cache (see program_registry_t)
     void compile(fan::opengl::context_t* context) {
-      if (id != -1) {
-        context->opengl.glDeleteProgram(id);
+      if (id != fan::uninitialized) {
+        context->m_programs.release(context->opengl, id);
       }
 
-      id = context->opengl.glCreateProgram();
-      if (vertex != -1) {
-        context->opengl.glAttachShader(id, vertex);
-      }
-      if (fragment != -1) {
-        context->opengl.glAttachShader(id, fragment);
-      }
-      if (geometry != -1) {
-        context->opengl.glAttachShader(id, geometry);
-      }
+      id = context->m_programs.acquire(context->opengl, vertex, fragment, geometry);
 
-      context->opengl.glLinkProgram(id);
-      checkCompileErrors(context, id, "PROGRAM");
-
-      if (vertex != -1) {
-        context->opengl.glDeleteShader(vertex);
-        vertex = -1;
-      }
-      if (fragment != -1) {
-        context->opengl.glDeleteShader(fragment);
-        fragment = -1;
-      }
-      if (geometry != -1) {
-        context->opengl.glDeleteShader(geometry);
-        geometry = -1;
-      }
+      vertex.clear();
+      fragment.clear();
+      geometry.clear();
 
       projection_view[0] = context->opengl.glGetUniformLocation(id, "projection");
       projection_view[1] = context->opengl.glGetUniformLocation(id, "view");
@@ -358,56 +300,10 @@ namespace fan {
 
     uint32_t id;
 
-    uint32_t vertex, fragment, geometry;
-
-  private:
-
-    void checkCompileErrors(fan::opengl::context_t* context, fan::opengl::GLuint shader, std::string type)
-    {
-      fan::opengl::GLint success;
-
-      bool program = type == "PROGRAM";
-
-      if (program == false) {
-        context->opengl.glGetShaderiv(shader, fan::opengl::GL_COMPILE_STATUS, &success);
-      }
-      else {
-        context->opengl.glGetProgramiv(shader, fan::opengl::GL_LINK_STATUS, &success);
-      }
-
-      if (success) {
-        return;
-      }
-
-      int buffer_size = 0;
-      context->opengl.glGetShaderiv(shader, fan::opengl::GL_INFO_LOG_LENGTH, &buffer_size);
-
-
-      if (buffer_size <= 0) {
-        return;
-      }
-
-      std::string buffer;
-      buffer.resize(buffer_size);
-
-      if (!success)
-      {
-
-      #define get_info_log(is_program, program, str_buffer, size) \
-                if (is_program) \
-                context->opengl.glGetProgramInfoLog(program, size, nullptr, buffer.data()); \
-                else \
-                context->opengl.glGetShaderInfoLog(program, size, nullptr, buffer.data());
-
-        get_info_log(program, shader, buffer, buffer_size);
-
-        fan::print("failed to compile type: " + type, buffer);
-
-        throw std::runtime_error("failed to compile shaders");
-      }
-    }
+    // pending sources until compile()
+    std::string vertex, fragment, geometry;
 };
 }
 
 
-#endif
\ No newline at end of file
+#endif
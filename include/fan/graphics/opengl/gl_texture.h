@@ -24,7 +24,7 @@ namespace fan {
 
       context->opengl.glGenTextures(1, &image->texture);
 
-			context->opengl.glBindTexture(GL_TEXTURE_2D, image->texture);
+			context->opengl.bind_texture(GL_TEXTURE_2D, image->texture);
 			context->opengl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, p.visual_output);
 			context->opengl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, p.visual_output);
 			context->opengl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, p.filter);
@@ -37,7 +37,7 @@ namespace fan {
       free(pixels);
 
 			context->opengl.glGenerateMipmap(GL_TEXTURE_2D);
-			context->opengl.glBindTexture(GL_TEXTURE_2D, 0);
+			context->opengl.bind_texture(GL_TEXTURE_2D, 0);
 
       return image;
     }
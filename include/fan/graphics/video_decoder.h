@@ -5,10 +5,17 @@
 #include <fan/types/types.h>
 
 #include <fan/graphics/graphics.h>
+#include <fan/time/trace.h>
 
 #include <vpx/vpx_decoder.h>
 #include <vpx/vp8dx.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #pragma comment(lib, "Onecore.lib")
 #pragma comment(lib, "lib/libvpx/vpxmd.lib")
 #pragma comment(lib, "lib/libvpx/vpxrcmd.lib")
@@ -199,23 +206,31 @@ fan::vec2ui vpx_get_plane_size(const vpx_image_t* img, int plane) {
 namespace fan_2d {
   namespace opengl {
 
+    // decodes ahead on own thread into a fixed pool of frames, render thread only takes finished ones
+    // libvpx itself decodes with properties_t::threads threads
     struct video_t {
 
       struct properties_t {
+        uint32_t threads = std::max(1u, std::thread::hardware_concurrency() / 2);
+        uint32_t prefetch = 4; // decoded frames kept ready, also the pool size
+      };
 
+      // planes packed one after another, chroma rows are half of luma width
+      struct frame_t {
+        fan_2d::opengl::pixel_data_t pixel_data;
+        std::vector<uint8_t> data;
       };
 
       struct out_t {
         out_t() : pixel_data() {}
         ~out_t() {
           for (int i = 0; i < 4; i++) {
-            if (pixel_data.pixels[i] != nullptr) {
-              delete pixel_data.pixels[i];
-            }
+            delete[] pixel_data.pixels[i];
           }
         }
 
         fan_2d::opengl::pixel_data_t pixel_data;
+        uint64_t capacity = 0; // bytes of pixels[0]
       };
 
       uint64_t m_current_delta;
@@ -227,8 +242,6 @@ namespace fan_2d {
       //const VpxInterface *decoder = NULL;
 
       void open(const std::string& file_path, properties_t& properties) {
-        codec = new vpx_codec_ctx_t;
-
         reader = vpx_video_reader_open(file_path.c_str());
 
         if (reader == nullptr) {
@@ -246,17 +259,43 @@ namespace fan_2d {
           face = vpx_codec_vp9_dx();
           break;
         }
+        default: {
+          vpx_video_reader_close(reader);
+          reader = nullptr;
+          fan::throw_error("unsupported codec in " + file_path);
+        }
         }
 
-        if (vpx_codec_dec_init(codec, face, nullptr, 0)) {
+        codec = new vpx_codec_ctx_t;
+
+        vpx_codec_dec_cfg_t cfg = { std::max(1u, properties.threads), reader->info.size.x, reader->info.size.y };
+        if (vpx_codec_dec_init(codec, face, &cfg, 0)) {
           fan::throw_error("failed to initialize decoder");
         }
+        if (reader->info.codec_fourcc == VP9_FOURCC) {
+          vpx_codec_control(codec, VP9D_SET_ROW_MT, 1);
+        }
+
+        m_frames.resize(std::max(1u, properties.prefetch));
+        m_ready.assign(m_frames.size(), nullptr);
 
         m_current_delta = 0;
         m_next_delta = 0;
+
+        this->start();
       }
       void close() {
-        delete codec;
+        this->stop();
+        if (codec != nullptr) {
+          vpx_codec_destroy(codec);
+          delete codec;
+          codec = nullptr;
+        }
+        if (reader != nullptr) {
+          vpx_video_reader_close(reader);
+          reader = nullptr;
+        }
+        m_frames.clear();
       }
 
       void feed_delta(f64_t delta) {
@@ -267,70 +306,204 @@ namespace fan_2d {
         return m_current_delta >= m_next_delta;
       }
 
+      // decoded frames are dropped, decoding continues from offset
+      // frames taken with acquire_frame must be released before
       void seek_raw(uint64_t offset) {
+        this->stop();
         fseek(reader->file, offset, SEEK_SET);
+        this->start();
+      }
+
+      // next frame in order, nullptr if not decoded yet or video ended
+      // give it back with release_frame once uploaded
+      frame_t* acquire_frame() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return this->pop_ready();
+      }
+
+      void release_frame(frame_t* frame) {
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_free.push_back(frame);
+        }
+        m_returned.notify_one();
       }
 
+      // all frames decoded and taken
+      bool is_finished() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_end && !m_ready_count;
+      }
+
+      // blocking version of acquire_frame, copies the frame to out, false when video ended
       bool decode_frame(out_t* out) {
-        if (!vpx_video_reader_read_frame(reader)) {
-          vpx_video_reader_close(reader);
+        frame_t* frame;
+        {
+          std::unique_lock<std::mutex> lock(m_mutex);
+          m_decoded.wait(lock, [this] { return m_ready_count || m_end; });
+          frame = this->pop_ready();
+        }
+        if (frame == nullptr) {
           return false;
         }
-        vpx_codec_iter_t iter;
-        vpx_image_t* img;
-        size_t frame_size;
-
-        uint64_t offset[3]{};
 
-        const unsigned char* frame =
-          vpx_video_reader_get_frame(reader, &frame_size);
-        if (vpx_codec_decode(codec, frame, (unsigned int)frame_size, NULL, 0)) {
-          fan::throw_error("failed to decode frame");
+        if (out->capacity < frame->data.size()) {
+          for (int i = 0; i < 3; i++) {
+            delete[] out->pixel_data.pixels[i];
+          }
+          out->pixel_data.pixels[0] = new uint8_t[frame->data.size()];
+          out->pixel_data.pixels[1] = new uint8_t[frame->data.size() / 2];
+          out->pixel_data.pixels[2] = new uint8_t[frame->data.size() / 2];
+          out->capacity = frame->data.size();
         }
+        for (int i = 0; i < 3; i++) {
+          uint64_t rows = i ? (frame->pixel_data.size.y + 1) / 2 : frame->pixel_data.size.y;
+          std::memcpy(out->pixel_data.pixels[i], frame->pixel_data.pixels[i], frame->pixel_data.linesize[i] * rows);
+          out->pixel_data.linesize[i] = frame->pixel_data.linesize[i];
+        }
+        out->pixel_data.size = frame->pixel_data.size;
 
-        auto decode_f = [&offset, this](out_t* out, vpx_image_t* img) {
-          int plane;
+        this->release_frame(frame);
+        return true;
+      }
 
-          for (plane = 0; plane < 3; ++plane) {
-            const unsigned char* buf = img->planes[plane];
-            const int stride = img->stride[plane];
-            fan::vec2ui size = vpx_get_plane_size(img, plane);
+    protected:
 
-            size.x *= ((img->fmt & VPX_IMG_FMT_HIGHBITDEPTH) ? 2 : 1);
+      // m_mutex must be locked
+      frame_t* pop_ready() {
+        if (!m_ready_count) {
+          return nullptr;
+        }
+        frame_t* frame = m_ready[m_ready_begin];
+        m_ready_begin = (m_ready_begin + 1) % m_ready.size();
+        m_ready_count--;
+        m_next_delta += 1.0 / reader->info.frame_rate * 1e+9;
+        return frame;
+      }
 
-            if (plane == 0) {
-              out->pixel_data.size = fan::vec2(stride, size.y);
-            }
+      void start() {
+        m_free.clear();
+        for (auto& frame : m_frames) {
+          m_free.push_back(&frame);
+        }
+        m_ready_begin = 0;
+        m_ready_count = 0;
+        m_end = false;
+        m_stop = false;
+        m_thread = std::thread([this] {
+          fan::time::get_trace().set_thread_name("video decoder");
+          this->decode_loop();
+        });
+      }
+
+      void stop() {
+        if (!m_thread.joinable()) {
+          return;
+        }
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_stop = true;
+        }
+        m_returned.notify_all();
+        m_thread.join();
+      }
 
-            out->pixel_data.linesize[plane] = stride;
+      void decode_loop() {
+        while (true) {
+          frame_t* frame;
+          {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_returned.wait(lock, [this] { return !m_free.empty() || m_stop; });
+            if (m_stop) {
+              return;
+            }
+            frame = m_free.back();
+            m_free.pop_back();
+          }
 
-            std::memcpy(&out->pixel_data.pixels[plane][offset[plane]], buf, stride * size.y);
-            offset[plane] += stride * size.y;
+          bool decoded;
+          {
+            fan_trace_scope("video", "decode");
+            decoded = this->decode(frame);
+          }
 
+          {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (decoded) {
+              m_ready[(m_ready_begin + m_ready_count) % m_ready.size()] = frame;
+              m_ready_count++;
+            }
+            else {
+              m_free.push_back(frame);
+              m_end = true;
+            }
           }
-          m_next_delta += 1.0 / reader->info.frame_rate * 1e+9;
-        };
+          m_decoded.notify_all();
+          if (!decoded) {
+            return;
+          }
+        }
+      }
 
-        if ((img = vpx_codec_get_frame(codec, &iter)) == nullptr) {
-          return true;
+      // reads packets until one produces a picture, false at end of file
+      bool decode(frame_t* frame) {
+        vpx_image_t* img = nullptr;
+        while (img == nullptr) {
+          if (!vpx_video_reader_read_frame(reader)) {
+            return false;
+          }
+          size_t frame_size;
+          const unsigned char* data = vpx_video_reader_get_frame(reader, &frame_size);
+          if (vpx_codec_decode(codec, data, (unsigned int)frame_size, NULL, 0)) {
+            fan::print_warning("failed to decode frame");
+            return false;
+          }
+          vpx_codec_iter_t iter = nullptr;
+          // superframes may give more than one, last is the shown one
+          while (vpx_image_t* next = vpx_codec_get_frame(codec, &iter)) {
+            img = next;
+          }
         }
 
-        if (out->pixel_data.pixels[0] == nullptr) {
-          const int stride = img->stride[0];
-          const int h = vpx_get_plane_size(img, 0).y;
+        // renderer expects chroma width of half the luma stride
+        const uint32_t width = img->stride[0];
+        const uint32_t height = vpx_get_plane_size(img, 0).y;
+        const uint32_t widths[3] = { width, width / 2, width / 2 };
+        const uint32_t heights[3] = { height, (height + 1) / 2, (height + 1) / 2 };
 
-          out->pixel_data.pixels[0] = new uint8_t[stride * h];
-          out->pixel_data.pixels[1] = new uint8_t[(stride * h) / 2];
-          out->pixel_data.pixels[2] = new uint8_t[(stride * h) / 2];
+        uint64_t total = (uint64_t)widths[0] * heights[0] + (uint64_t)widths[1] * heights[1] * 2;
+        if (frame->data.size() < total) {
+          // only when resolution grows
+          frame->data.resize(total);
         }
 
-        decode_f(out, img);
-
-        while ((img = vpx_codec_get_frame(codec, &iter)) != nullptr) {
-          decode_f(out, img);
+        uint8_t* dst = frame->data.data();
+        for (int plane = 0; plane < 3; ++plane) {
+          uint32_t row_bytes = std::min<uint32_t>(widths[plane], img->stride[plane]);
+          for (uint32_t y = 0; y < heights[plane]; y++) {
+            std::memcpy(dst + (uint64_t)y * widths[plane], img->planes[plane] + (uint64_t)y * img->stride[plane], row_bytes);
+          }
+          frame->pixel_data.pixels[plane] = dst;
+          frame->pixel_data.linesize[plane] = widths[plane];
+          dst += (uint64_t)widths[plane] * heights[plane];
         }
+        frame->pixel_data.size = fan::vec2i(width, height);
         return true;
       }
+
+      std::vector<frame_t> m_frames;
+      std::vector<frame_t*> m_free;
+      // decoded frames in order, ring with capacity of the pool
+      std::vector<frame_t*> m_ready;
+      uint32_t m_ready_begin = 0;
+      uint32_t m_ready_count = 0;
+      bool m_end = false;
+      bool m_stop = false;
+
+      std::mutex m_mutex;
+      std::condition_variable m_returned;
+      std::condition_variable m_decoded;
+      std::thread m_thread;
     };
   }
 }
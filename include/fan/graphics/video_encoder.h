@@ -0,0 +1,339 @@
+#pragma once
+
+// compile with MD
+
+#include <fan/types/types.h>
+#include <fan/types/vector.h>
+#include <fan/io/log.h>
+#include <fan/time/trace.h>
+
+#include <vpx/vpx_encoder.h>
+#include <vpx/vp8cx.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#pragma comment(lib, "Onecore.lib")
+#pragma comment(lib, "lib/libvpx/vpxmd.lib")
+#pragma comment(lib, "lib/libvpx/vpxrcmd.lib")
+
+namespace fan {
+  namespace video {
+
+    namespace ivf {
+
+      static constexpr uint32_t file_header_size = 32;
+      static constexpr uint32_t frame_header_size = 12; // 4 byte size + 8 byte timestamp
+
+      static constexpr uint32_t vp8_fourcc = 0x30385056;
+      static constexpr uint32_t vp9_fourcc = 0x30395056;
+
+      static void put_le16(uint8_t* mem, uint32_t value) {
+        mem[0] = value;
+        mem[1] = value >> 8;
+      }
+
+      static void put_le32(uint8_t* mem, uint32_t value) {
+        put_le16(mem, value);
+        put_le16(mem + 2, value >> 16);
+      }
+
+      static void put_le64(uint8_t* mem, uint64_t value) {
+        put_le32(mem, value);
+        put_le32(mem + 4, value >> 32);
+      }
+
+      // written twice, placeholder on open and again on close when frame count is known
+      static void write_file_header(FILE* file, uint32_t fourcc, fan::vec2ui size, uint32_t rate, uint32_t scale, uint32_t frame_count) {
+        uint8_t header[file_header_size] = { 'D', 'K', 'I', 'F' };
+        put_le16(header + 4, 0);
+        put_le16(header + 6, file_header_size);
+        put_le32(header + 8, fourcc);
+        put_le16(header + 12, size.x);
+        put_le16(header + 14, size.y);
+        put_le32(header + 16, rate);
+        put_le32(header + 20, scale);
+        put_le32(header + 24, frame_count);
+        put_le32(header + 28, 0);
+        fwrite(header, 1, file_header_size, file);
+      }
+
+      static void write_frame(FILE* file, int64_t pts, const void* data, uint32_t size) {
+        uint8_t header[frame_header_size];
+        put_le32(header, size);
+        put_le64(header + 4, pts);
+        fwrite(header, 1, frame_header_size, file);
+        fwrite(data, 1, size, file);
+      }
+
+    }
+
+    // I420 frames in, IVF file out
+    // frames are encoded on own thread, producer only fills a pooled frame and queues it
+    // when all pool frames are queued acquire() drops the frame instead of waiting, unless block_when_full
+    struct encoder_t {
+
+      enum class codec_t {
+        vp8,
+        vp9
+      };
+
+      struct properties_t {
+        codec_t codec = codec_t::vp9;
+        fan::vec2ui size;           // made even, I420 chroma is half size
+        uint32_t fps = 30;
+        uint32_t bitrate = 2000;    // kbit/s
+        uint32_t threads = std::max(1u, std::thread::hardware_concurrency() / 2);
+        uint32_t queue_size = 8;    // frames in flight, also the pool size
+        bool block_when_full = false;
+        int cpu_used = 8;           // speed/quality tradeoff, higher is faster
+      };
+
+      struct frame_t {
+        // y then u then v, tightly packed
+        uint8_t* planes[3];
+        uint32_t stride[3];
+        fan::vec2ui size;
+        int64_t pts;
+        bool keyframe = false;
+
+        std::unique_ptr<uint8_t[]> data;
+      };
+
+      struct stats_t {
+        uint64_t queued = 0;
+        uint64_t encoded = 0;
+        uint64_t dropped = 0;
+        uint64_t bytes = 0;
+      };
+
+      void open(const std::string& path, const properties_t& properties) {
+        m_properties = properties;
+        m_properties.size.x = (properties.size.x + 1) & ~1u;
+        m_properties.size.y = (properties.size.y + 1) & ~1u;
+        m_properties.queue_size = std::max(1u, properties.queue_size);
+
+        vpx_codec_iface_t* iface = properties.codec == codec_t::vp8 ? vpx_codec_vp8_cx() : vpx_codec_vp9_cx();
+        m_fourcc = properties.codec == codec_t::vp8 ? ivf::vp8_fourcc : ivf::vp9_fourcc;
+
+        vpx_codec_enc_cfg_t cfg;
+        if (vpx_codec_enc_config_default(iface, &cfg, 0)) {
+          fan::throw_error("failed to get default encoder config");
+        }
+        cfg.g_w = m_properties.size.x;
+        cfg.g_h = m_properties.size.y;
+        cfg.g_timebase.num = 1;
+        cfg.g_timebase.den = m_properties.fps;
+        cfg.rc_target_bitrate = m_properties.bitrate;
+        cfg.g_threads = m_properties.threads;
+        // no lookahead, packets come out in the same encode call
+        cfg.g_lag_in_frames = 0;
+        cfg.kf_max_dist = m_properties.fps * 5;
+
+        if (vpx_codec_enc_init(&m_codec, iface, &cfg, 0)) {
+          fan::throw_error(std::string("failed to initialize encoder:") + vpx_codec_error(&m_codec));
+        }
+        vpx_codec_control(&m_codec, VP8E_SET_CPUUSED, m_properties.cpu_used);
+        if (properties.codec == codec_t::vp9) {
+          vpx_codec_control(&m_codec, VP9E_SET_ROW_MT, 1);
+          // log2, at least 256 pixels per tile column
+          int tile_columns = 0;
+          while ((m_properties.size.x >> (tile_columns + 1)) >= 256 && (1u << (tile_columns + 1)) <= m_properties.threads) {
+            tile_columns++;
+          }
+          vpx_codec_control(&m_codec, VP9E_SET_TILE_COLUMNS, tile_columns);
+        }
+
+        m_file = fopen(path.c_str(), "wb");
+        if (m_file == nullptr) {
+          vpx_codec_destroy(&m_codec);
+          fan::throw_error("failed to open " + path);
+        }
+        ivf::write_file_header(m_file, m_fourcc, m_properties.size, m_properties.fps, 1, 0);
+
+        // whole pool up front, nothing allocates per frame after this
+        m_frames.resize(m_properties.queue_size);
+        m_free.clear();
+        m_queue.assign(m_properties.queue_size, nullptr);
+        m_queue_begin = 0;
+        m_queue_count = 0;
+        uint32_t luma = m_properties.size.x * m_properties.size.y;
+        for (auto& frame : m_frames) {
+          frame.size = m_properties.size;
+          frame.data.reset(new uint8_t[luma + luma / 2]);
+          frame.planes[0] = frame.data.get();
+          frame.planes[1] = frame.planes[0] + luma;
+          frame.planes[2] = frame.planes[1] + luma / 4;
+          frame.stride[0] = m_properties.size.x;
+          frame.stride[1] = frame.stride[2] = m_properties.size.x / 2;
+          m_free.push_back(&frame);
+        }
+
+        m_stats = stats_t();
+        m_frame_count = 0;
+        m_running = true;
+        m_thread = std::thread([this] {
+          fan::time::get_trace().set_thread_name("video encoder");
+          this->encode_loop();
+        });
+      }
+
+      // encodes what is queued, then finishes the file
+      void close() {
+        if (m_file == nullptr) {
+          return;
+        }
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_running = false;
+        }
+        m_wake.notify_all();
+        m_thread.join();
+
+        // flush frames still inside the encoder
+        this->encode(nullptr);
+
+        vpx_codec_destroy(&m_codec);
+
+        fseek(m_file, 0, SEEK_SET);
+        ivf::write_file_header(m_file, m_fourcc, m_properties.size, m_properties.fps, 1, m_frame_count);
+        fclose(m_file);
+        m_file = nullptr;
+
+        m_frames.clear();
+        m_free.clear();
+      }
+
+      bool is_open() const {
+        return m_file != nullptr;
+      }
+
+      // even, may be bigger than requested
+      fan::vec2ui get_size() const {
+        return m_properties.size;
+      }
+
+      // free frame to fill, nullptr when queue is full (counted as dropped)
+      frame_t* acquire() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_free.empty()) {
+          if (!m_properties.block_when_full) {
+            m_stats.dropped++;
+            return nullptr;
+          }
+          m_returned.wait(lock, [this] { return !m_free.empty(); });
+        }
+        frame_t* frame = m_free.back();
+        m_free.pop_back();
+        return frame;
+      }
+
+      // pts in frames (1 / fps)
+      void submit(frame_t* frame, int64_t pts) {
+        frame->pts = pts;
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_queue[(m_queue_begin + m_queue_count) % m_queue.size()] = frame;
+          m_queue_count++;
+          m_stats.queued++;
+        }
+        m_wake.notify_one();
+      }
+
+      stats_t get_stats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+      }
+
+    protected:
+
+      void encode_loop() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+          m_wake.wait(lock, [this] { return m_queue_count || !m_running; });
+          if (!m_queue_count) {
+            break;
+          }
+          frame_t* frame = m_queue[m_queue_begin];
+          m_queue_begin = (m_queue_begin + 1) % m_queue.size();
+          m_queue_count--;
+
+          lock.unlock();
+          {
+            fan_trace_scope("video", "encode");
+            this->encode(frame);
+          }
+          lock.lock();
+
+          m_stats.encoded++;
+          frame->keyframe = false;
+          m_free.push_back(frame);
+          m_returned.notify_one();
+        }
+      }
+
+      // nullptr flushes
+      void encode(frame_t* frame) {
+        vpx_image_t image;
+        vpx_image_t* input = nullptr;
+        int64_t pts = -1;
+        vpx_enc_frame_flags_t flags = 0;
+        if (frame != nullptr) {
+          input = vpx_img_wrap(&image, VPX_IMG_FMT_I420, frame->size.x, frame->size.y, 1, frame->data.get());
+          pts = frame->pts;
+          flags = frame->keyframe ? VPX_EFLAG_FORCE_KF : 0;
+        }
+
+        bool got_packets;
+        do {
+          if (vpx_codec_encode(&m_codec, input, pts, 1, flags, VPX_DL_REALTIME)) {
+            fan_log_error("video encode failed:", vpx_codec_error(&m_codec));
+            return;
+          }
+          got_packets = false;
+          vpx_codec_iter_t iter = nullptr;
+          const vpx_codec_cx_pkt_t* packet;
+          while ((packet = vpx_codec_get_cx_data(&m_codec, &iter)) != nullptr) {
+            got_packets = true;
+            if (packet->kind != VPX_CODEC_CX_FRAME_PKT) {
+              continue;
+            }
+            ivf::write_frame(m_file, packet->data.frame.pts, packet->data.frame.buf, packet->data.frame.sz);
+            m_frame_count++;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.bytes += packet->data.frame.sz + ivf::frame_header_size;
+          }
+          // flushing repeats until the encoder has nothing left
+        } while (input == nullptr && got_packets);
+      }
+
+      properties_t m_properties;
+      vpx_codec_ctx_t m_codec;
+      uint32_t m_fourcc = 0;
+      FILE* m_file = nullptr;
+      uint32_t m_frame_count = 0;
+
+      std::vector<frame_t> m_frames;
+      std::vector<frame_t*> m_free;
+      // ring of submitted frames, capacity = pool size so never overflows
+      std::vector<frame_t*> m_queue;
+      uint32_t m_queue_begin = 0;
+      uint32_t m_queue_count = 0;
+
+      std::mutex m_mutex;
+      std::condition_variable m_wake;
+      std::condition_variable m_returned;
+      std::thread m_thread;
+      bool m_running = false;
+
+      stats_t m_stats;
+    };
+
+  }
+}
@@ -12,6 +12,10 @@
 
 #include <fan/io/file.h>
 
+#include <algorithm>
+#include <string>
+#include <string_view>
+
 namespace fan {
 	namespace webp {
 
@@ -46,6 +50,190 @@ namespace fan {
       WebPFree(ptr);
       ptr = nullptr;
     }
+
+    // one 8 bit plane of a decoded image, rows are stride bytes apart
+    // luma is BT.601 limited range (16 .. 235), images without alpha decode to opaque 255
+    struct plane_t {
+      const uint8_t* data = nullptr;
+      int stride = 0;
+      fan::vec2i size;
+
+      WebPDecBuffer buffer;
+    };
+
+    enum class channel_t {
+      luma,
+      alpha
+    };
+
+    // decodes to YUV(A) instead of RGBA, 1.5 - 2.5 bytes per pixel instead of 4, and returns one plane of it
+    // libwebp has no per row output callback, the full frame is decoded before anything can be read
+    static bool decode_plane(const uint8_t* webp_data, std::size_t size, channel_t channel, plane_t& plane) {
+      WebPDecoderConfig config;
+      if (!WebPInitDecoderConfig(&config) || WebPGetFeatures(webp_data, size, &config.input) != VP8_STATUS_OK) {
+        return false;
+      }
+      bool has_alpha = config.input.has_alpha;
+      config.output.colorspace = channel == channel_t::alpha && has_alpha ? MODE_YUVA : MODE_YUV;
+      config.options.use_threads = 1;
+      if (WebPDecode(webp_data, size, &config) != VP8_STATUS_OK) {
+        WebPFreeDecBuffer(&config.output);
+        return false;
+      }
+      plane.buffer = config.output;
+      plane.size = fan::vec2i(config.output.width, config.output.height);
+      const WebPYUVABuffer& yuva = config.output.u.YUVA;
+      if (channel == channel_t::luma) {
+        plane.data = yuva.y;
+        plane.stride = yuva.y_stride;
+      }
+      else if (has_alpha) {
+        plane.data = yuva.a;
+        plane.stride = yuva.a_stride;
+      }
+      else {
+        // opaque, one row of 255 repeated
+        plane.buffer.u.YUVA.a = (uint8_t*)WebPMalloc(plane.size.x);
+        std::fill(plane.buffer.u.YUVA.a, plane.buffer.u.YUVA.a + plane.size.x, 255);
+        plane.data = plane.buffer.u.YUVA.a;
+        plane.stride = 0;
+      }
+      return true;
+    }
+
+    static void free_plane(plane_t& plane) {
+      if (plane.data == nullptr) {
+        return;
+      }
+      if (plane.buffer.colorspace == MODE_YUV) {
+        WebPFree(plane.buffer.u.YUVA.a);
+      }
+      WebPFreeDecBuffer(&plane.buffer);
+      plane.data = nullptr;
+    }
+
+    // lossless, level 0 fast .. 9 small, two colour images end up palettized by the encoder
+    // thread_level lets libwebp run analysis and entropy coding on a second thread
+    static bool encode_lossless(const uint8_t* rgba, const fan::vec2i& size, std::string& out, int level = 6, bool thread_level = true) {
+      WebPConfig config;
+      if (!WebPConfigInit(&config) || !WebPConfigLosslessPreset(&config, level)) {
+        return false;
+      }
+      config.thread_level = thread_level;
+
+      WebPPicture picture;
+      if (!WebPPictureInit(&picture)) {
+        return false;
+      }
+      picture.use_argb = 1;
+      picture.width = size.x;
+      picture.height = size.y;
+      if (!WebPPictureImportRGBA(&picture, rgba, size.x * 4)) {
+        WebPPictureFree(&picture);
+        return false;
+      }
+
+      WebPMemoryWriter writer;
+      WebPMemoryWriterInit(&writer);
+      picture.writer = WebPMemoryWrite;
+      picture.custom_ptr = &writer;
+
+      bool ok = WebPEncode(&config, &picture);
+      WebPPictureFree(&picture);
+      if (ok) {
+        out.assign((const char*)writer.mem, writer.size);
+      }
+      WebPMemoryWriterClear(&writer);
+      return ok;
+    }
+
+    // largest width/height the format can store
+    static constexpr int max_size = 16383;
+
+    // animated webp, frames are encoded lossless when added, file is assembled in save()
+    // RIFF container is written here directly so only the encoder library is needed, not libwebpmux
+    struct animation_t {
+
+      void open(const fan::vec2i& size, uint16_t loop_count = 0) {
+        m_size = size;
+        m_loop_count = loop_count;
+        m_frames.clear();
+        m_frame_count = 0;
+      }
+
+      // whole canvas frames, duration in milliseconds
+      bool add_frame(const uint8_t* rgba, uint32_t duration, int level = 6, bool thread_level = true) {
+        std::string encoded;
+        if (!encode_lossless(rgba, m_size, encoded, level, thread_level)) {
+          return false;
+        }
+        // drop "RIFF" size "WEBP", rest is the VP8L chunk
+        std::string_view chunk(encoded.data() + 12, encoded.size() - 12);
+
+        std::string header;
+        put_chunk_header(header, "ANMF", 16 + chunk.size());
+        put_le24(header, 0); // x / 2
+        put_le24(header, 0); // y / 2
+        put_le24(header, m_size.x - 1);
+        put_le24(header, m_size.y - 1);
+        put_le24(header, duration);
+        header += (char)0x02; // no blending, frames cover the whole canvas
+
+        m_frames += header;
+        m_frames += chunk;
+        m_frame_count++;
+        return true;
+      }
+
+      uint32_t frame_count() const {
+        return m_frame_count;
+      }
+
+      void save(const std::string& path) const {
+        std::string vp8x;
+        put_chunk_header(vp8x, "VP8X", 10);
+        vp8x += (char)0x02; // animation
+        vp8x.append(3, 0);
+        put_le24(vp8x, m_size.x - 1);
+        put_le24(vp8x, m_size.y - 1);
+
+        std::string anim;
+        put_chunk_header(anim, "ANIM", 6);
+        put_le32(anim, 0xff000000); // background, opaque black
+        anim += (char)(m_loop_count & 0xff);
+        anim += (char)(m_loop_count >> 8);
+
+        std::string riff = "RIFF";
+        put_le32(riff, 4 + vp8x.size() + anim.size() + m_frames.size());
+        riff += "WEBP";
+
+        fan::io::file::write(path, riff + vp8x + anim + m_frames, std::ios_base::binary | std::ios_base::trunc);
+      }
+
+    protected:
+
+      static void put_le24(std::string& out, uint32_t value) {
+        out += (char)(value & 0xff);
+        out += (char)((value >> 8) & 0xff);
+        out += (char)((value >> 16) & 0xff);
+      }
+
+      static void put_le32(std::string& out, uint32_t value) {
+        put_le24(out, value);
+        out += (char)(value >> 24);
+      }
+
+      static void put_chunk_header(std::string& out, const char* fourcc, uint32_t size) {
+        out.append(fourcc, 4);
+        put_le32(out, size);
+      }
+
+      fan::vec2i m_size;
+      uint16_t m_loop_count = 0;
+      // ANMF chunks
+      std::string m_frames;
+      uint32_t m_frame_count = 0;
+    };
   
   }
 }
\ No newline at end of file
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <fan/types/types.h>
+#include <fan/time/time.h>
+#include <fan/time/profiler.h>
+#include <fan/time/trace.h>
+
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(fan_platform_unix)
+	#include <pthread.h>
+#endif
+
+// messages below fan_log_level are removed at compile time
+// 0 trace, 1 debug, 2 info, 3 warning, 4 error
+#ifndef fan_log_level
+	#ifdef NDEBUG
+		#define fan_log_level 2
+	#else
+		#define fan_log_level 1
+	#endif
+#endif
+
+namespace fan {
+
+	namespace io {
+
+		enum class log_level_t : uint8_t {
+			trace,
+			debug,
+			info,
+			warning,
+			error
+		};
+
+		// calling thread formats into a fixed size record and pushes it to its own ring
+		// background thread writes the rings out in batches, so logging costs no i/o on the caller
+		// each thread is rate limited, messages over the limit are counted and reported instead. Errors are always written
+		struct log_t {
+
+			static constexpr uint32_t ring_size = 256;
+			static constexpr uint32_t max_length = 240;
+			static constexpr uint64_t flush_interval = 20000000;
+
+			struct record_t {
+				uint64_t time;
+				log_level_t level;
+				uint8_t length;
+				char text[max_length];
+			};
+
+			log_t() {
+				m_origin = fan::time::clock::now();
+				// constructed first so it outlives the writer, which has a trace buffer once named
+				fan::time::get_trace();
+				m_writer = std::thread([this] {
+					fan::time::get_trace().set_thread_name("log");
+					this->writer();
+				});
+			#if defined(fan_platform_unix)
+				// a child forked while the writer holds m_mutex would block on its first new thread's message
+				// the writer isn't copied, so whatever a child logs is never written
+				get_instance() = this;
+				pthread_atfork(
+					[] { if (get_instance()) get_instance()->m_mutex.lock(); },
+					[] { if (get_instance()) get_instance()->m_mutex.unlock(); },
+					[] { if (get_instance()) get_instance()->m_mutex.unlock(); }
+				);
+			#endif
+			}
+
+			~log_t() {
+			#if defined(fan_platform_unix)
+				get_instance() = nullptr;
+			#endif
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_running = false;
+				}
+				m_wake.notify_one();
+				m_writer.join();
+				this->drain();
+			}
+
+			// stdout by default
+			void set_output(std::FILE* file) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				std::fflush(m_output);
+				m_output = file;
+			}
+
+			// per thread, burst messages at once then per_second on average
+			void set_rate_limit(uint32_t per_second, uint32_t burst) {
+				m_per_second.store(per_second, std::memory_order_relaxed);
+				m_burst.store(burst, std::memory_order_relaxed);
+			}
+
+			template <typename ...Args>
+			void write(log_level_t level, const Args&... args) {
+				thread_buffer_t* buffer = this->get_thread_buffer();
+
+				// errors are never rate limited or dropped
+				uint64_t now = fan::time::clock::now();
+				if (level != log_level_t::error && !this->take_token(buffer, now)) {
+					m_dropped.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+
+				record_t record;
+				record.time = now;
+				record.level = level;
+
+				// separated by spaces like fan::print
+				uint32_t length = 0;
+				bool first = true;
+				((append(record.text, length, args, first), first = false), ...);
+				record.length = length;
+
+				if (!buffer->ring.push(record)) {
+					if (level != log_level_t::error) {
+						m_dropped.fetch_add(1, std::memory_order_relaxed);
+						return;
+					}
+					// full ring, write it out here instead of waiting for the writer
+					std::lock_guard<std::mutex> lock(m_mutex);
+					this->drain();
+					buffer->ring.push(record);
+				}
+			}
+
+			// blocks until everything logged so far is written
+			void flush() {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				this->drain();
+			}
+
+		protected:
+
+			struct thread_buffer_t {
+				// token bucket, touched only by the owning thread
+				f64_t tokens = 0;
+				uint64_t refill_time = 0;
+				fan::time::spsc_ring_t<record_t, ring_size> ring;
+			};
+
+			thread_buffer_t* get_thread_buffer() {
+				// owned by log_t so lines of exited threads are still written
+				thread_local thread_buffer_t* buffer = nullptr;
+				if (buffer == nullptr) {
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_buffers.push_back(std::make_unique<thread_buffer_t>());
+					buffer = m_buffers.back().get();
+					buffer->tokens = m_burst.load(std::memory_order_relaxed);
+					buffer->refill_time = fan::time::clock::now();
+				}
+				return buffer;
+			}
+
+			bool take_token(thread_buffer_t* buffer, uint64_t now) {
+				f64_t burst = m_burst.load(std::memory_order_relaxed);
+				buffer->tokens = std::min(burst, buffer->tokens + (now - buffer->refill_time) / 1e9 * m_per_second.load(std::memory_order_relaxed));
+				buffer->refill_time = now;
+				if (buffer->tokens < 1) {
+					return false;
+				}
+				buffer->tokens -= 1;
+				return true;
+			}
+
+			static void append(char* text, uint32_t& length, std::string_view value, bool first) {
+				if (!first && length < max_length) {
+					text[length++] = ' ';
+				}
+				uint32_t n = std::min((uint32_t)value.size(), max_length - length);
+				std::memcpy(text + length, value.data(), n);
+				length += n;
+			}
+
+			template <typename T>
+			static void append(char* text, uint32_t& length, const T& value, bool first) {
+				if constexpr (std::is_same_v<T, bool>) {
+					append(text, length, std::string_view(value ? "true" : "false"), first);
+				}
+				else if constexpr (std::is_same_v<T, char>) {
+					append(text, length, std::string_view(&value, 1), first);
+				}
+				else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+					append(text, length, std::string_view(value), first);
+				}
+				else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+					char buffer[24];
+					auto result = std::to_chars(buffer, buffer + sizeof(buffer), (std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>)value);
+					append(text, length, std::string_view(buffer, result.ptr - buffer), first);
+				}
+				else if constexpr (std::is_floating_point_v<T>) {
+					char buffer[32];
+					int n = std::snprintf(buffer, sizeof(buffer), "%g", (f64_t)value);
+					append(text, length, std::string_view(buffer, n), first);
+				}
+				else {
+					// vectors, colors etc, allocates
+					std::ostringstream stream;
+					stream << value;
+					append(text, length, std::string_view(stream.str()), first);
+				}
+			}
+
+			void writer() {
+				std::unique_lock<std::mutex> lock(m_mutex);
+				while (m_running) {
+					m_wake.wait_for(lock, std::chrono::nanoseconds(flush_interval));
+					this->drain();
+				}
+			}
+
+			// m_mutex must be locked
+			void drain() {
+				static constexpr const char* level_names[] = { "trace", "debug", "info", "warn", "error" };
+
+				bool wrote = false;
+
+				record_t record;
+				for (auto& buffer : m_buffers) {
+					while (buffer->ring.pop(record)) {
+						std::fprintf(
+							m_output,
+							"%10.3f %-5s %.*s\n",
+							(int64_t)(record.time - m_origin) / 1e9,
+							level_names[(int)record.level],
+							(int)record.length,
+							record.text
+						);
+						wrote = true;
+					}
+				}
+
+				uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+				if (dropped) {
+					std::fprintf(m_output, "%10.3f %-5s %llu messages dropped\n", (int64_t)(fan::time::clock::now() - m_origin) / 1e9, "warn", (unsigned long long)dropped);
+					wrote = true;
+				}
+
+				if (wrote) {
+					std::fflush(m_output);
+				}
+			}
+
+			std::atomic<uint32_t> m_per_second{ 100 };
+			std::atomic<uint32_t> m_burst{ 200 };
+			std::atomic<uint64_t> m_dropped{ 0 };
+
+			std::mutex m_mutex;
+			std::condition_variable m_wake;
+			std::thread m_writer;
+			bool m_running = true;
+
+			std::FILE* m_output = stdout;
+			uint64_t m_origin;
+
+			std::vector<std::unique_ptr<thread_buffer_t>> m_buffers;
+
+		#if defined(fan_platform_unix)
+			static log_t*& get_instance() {
+				static log_t* instance = nullptr;
+				return instance;
+			}
+		#endif
+		};
+
+		inline log_t& get_log() {
+			static log_t log;
+			return log;
+		}
+
+	}
+}
+
+#define fan_log_impl(level_m, ...) fan::io::get_log().write(fan::io::log_level_t::level_m, __VA_ARGS__)
+
+#if fan_log_level <= 0
+	#define fan_log_trace(...) fan_log_impl(trace, __VA_ARGS__)
+#else
+	#define fan_log_trace(...)
+#endif
+
+#if fan_log_level <= 1
+	#define fan_log_debug(...) fan_log_impl(debug, __VA_ARGS__)
+#else
+	#define fan_log_debug(...)
+#endif
+
+#if fan_log_level <= 2
+	#define fan_log_info(...) fan_log_impl(info, __VA_ARGS__)
+#else
+	#define fan_log_info(...)
+#endif
+
+#if fan_log_level <= 3
+	#define fan_log_warning(...) fan_log_impl(warning, __VA_ARGS__)
+#else
+	#define fan_log_warning(...)
+#endif
+
+#define fan_log_error(...) fan_log_impl(error, __VA_ARGS__)
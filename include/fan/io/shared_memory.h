@@ -0,0 +1,182 @@
+#pragma once
+
+#include <fan/types/types.h>
+
+#include <string>
+#include <utility>
+
+#if defined(fan_platform_windows)
+	#include <Windows.h>
+#elif defined(fan_platform_unix)
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace fan {
+
+	namespace io {
+
+		// named memory shared between processes, POSIX shm_open / windows file mapping
+		struct shared_memory_t {
+
+			shared_memory_t() = default;
+			shared_memory_t(const shared_memory_t&) = delete;
+			shared_memory_t& operator=(const shared_memory_t&) = delete;
+
+			shared_memory_t(shared_memory_t&& other) noexcept {
+				*this = std::move(other);
+			}
+
+			// other is left closed, the name moves with the mapping
+			shared_memory_t& operator=(shared_memory_t&& other) noexcept {
+				if (this == &other) {
+					return *this;
+				}
+				this->close();
+			#if defined(fan_platform_unix)
+				m_unlink = std::move(other.m_unlink);
+				other.m_unlink.clear();
+			#elif defined(fan_platform_windows)
+				m_handle = std::exchange(other.m_handle, nullptr);
+			#endif
+				m_data = std::exchange(other.m_data, nullptr);
+				m_size = std::exchange(other.m_size, 0);
+				return *this;
+			}
+
+			~shared_memory_t() {
+				this->close();
+			}
+
+			// creates (or replaces) name with size zeroed bytes, removed again by close()
+			// windows can't replace a mapping someone still has open, pick a new name to resize
+			void create(const std::string& name, uint64_t size) {
+				this->close();
+
+			#if defined(fan_platform_windows)
+				m_handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, name.c_str());
+				if (m_handle == nullptr) {
+					fan::throw_error("failed to create shared memory " + name);
+				}
+				// the existing mapping is returned as is, whatever its size & contents
+				if (GetLastError() == ERROR_ALREADY_EXISTS) {
+					this->close();
+					fan::throw_error("shared memory " + name + " is still in use");
+				}
+				m_data = (uint8_t*)MapViewOfFile(m_handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+			#elif defined(fan_platform_unix)
+				std::string path = shm_path(name);
+				shm_unlink(path.c_str()); // left over from a crashed run, its readers keep their mapping
+				int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+				if (fd == -1) {
+					fan::throw_error("failed to create shared memory " + name);
+				}
+				if (ftruncate(fd, size) == -1) {
+					::close(fd);
+					shm_unlink(path.c_str());
+					fan::throw_error("failed to size shared memory " + name);
+				}
+				void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+				::close(fd);
+				m_data = data == MAP_FAILED ? nullptr : (uint8_t*)data;
+				m_unlink = path;
+			#endif
+
+				if (m_data == nullptr) {
+					this->close();
+					fan::throw_error("failed to map shared memory " + name);
+				}
+				m_size = size;
+			}
+
+			// maps existing name, false if it doesn't exist
+			bool open(const std::string& name, bool read_only = true) {
+				this->close();
+
+			#if defined(fan_platform_windows)
+				m_handle = OpenFileMappingA(read_only ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+				if (m_handle == nullptr) {
+					return false;
+				}
+				m_data = (uint8_t*)MapViewOfFile(m_handle, read_only ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS, 0, 0, 0);
+				MEMORY_BASIC_INFORMATION info;
+				if (m_data && VirtualQuery(m_data, &info, sizeof(info))) {
+					m_size = info.RegionSize;
+				}
+			#elif defined(fan_platform_unix)
+				int fd = shm_open(shm_path(name).c_str(), read_only ? O_RDONLY : O_RDWR, 0);
+				if (fd == -1) {
+					return false;
+				}
+				struct stat s;
+				if (fstat(fd, &s) == 0 && s.st_size > 0) {
+					void* data = mmap(nullptr, s.st_size, read_only ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+					m_data = data == MAP_FAILED ? nullptr : (uint8_t*)data;
+					m_size = s.st_size;
+				}
+				::close(fd);
+			#endif
+
+				if (m_data == nullptr) {
+					this->close();
+					return false;
+				}
+				return true;
+			}
+
+			void close() {
+			#if defined(fan_platform_windows)
+				if (m_data) {
+					UnmapViewOfFile(m_data);
+				}
+				if (m_handle) {
+					CloseHandle(m_handle);
+				}
+				m_handle = nullptr;
+			#elif defined(fan_platform_unix)
+				if (m_data) {
+					munmap(m_data, m_size);
+				}
+				if (!m_unlink.empty()) {
+					shm_unlink(m_unlink.c_str());
+				}
+				m_unlink.clear();
+			#endif
+				m_data = nullptr;
+				m_size = 0;
+			}
+
+			bool is_open() const {
+				return m_data != nullptr;
+			}
+
+			uint8_t* data() const {
+				return m_data;
+			}
+
+			uint64_t size() const {
+				return m_size;
+			}
+
+		protected:
+
+		#if defined(fan_platform_unix)
+			// portable shm names are a single component starting with /
+			static std::string shm_path(const std::string& name) {
+				return name.empty() || name[0] != '/' ? '/' + name : name;
+			}
+
+			std::string m_unlink;
+		#elif defined(fan_platform_windows)
+			HANDLE m_handle = nullptr;
+		#endif
+
+			uint8_t* m_data = nullptr;
+			uint64_t m_size = 0;
+		};
+
+	}
+
+}
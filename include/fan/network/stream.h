@@ -0,0 +1,622 @@
+#pragma once
+
+#include <fan/types/types.h>
+#include <fan/io/log.h>
+#include <fan/time/trace.h>
+
+#if defined(fan_compiler_visual_studio)
+	#pragma comment(lib, "lib/WITCH/uv/uv.lib")
+	// static libuv's own dependencies
+	#pragma comment(lib, "ws2_32.lib")
+	#pragma comment(lib, "iphlpapi.lib")
+	#pragma comment(lib, "userenv.lib")
+	#pragma comment(lib, "psapi.lib")
+	#pragma comment(lib, "dbghelp.lib")
+#endif
+
+#include <uv.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fan {
+
+	namespace network {
+
+		// shared by every connection it is sent to, kept alive until the last write completes
+		typedef std::shared_ptr<const std::string> buffer_t;
+
+		static buffer_t make_buffer(std::string data) {
+			return std::make_shared<const std::string>(std::move(data));
+		}
+
+		// messages on a stream are a 4 byte little endian length followed by that many bytes
+		struct framer_t {
+
+			static constexpr uint32_t header_size = 4;
+			static constexpr uint32_t max_message_size = 1u << 30;
+
+			// reserves the header, call end_message after appending the message
+			static size_t begin_message(std::string& out) {
+				out.append(header_size, 0);
+				return out.size();
+			}
+
+			static void end_message(std::string& out, size_t begin) {
+				uint32_t size = out.size() - begin;
+				for (uint32_t i = 0; i < header_size; i++) {
+					out[begin - header_size + i] = (char)(size >> (i * 8));
+				}
+			}
+
+			// calls on_message(const char*, size) for every complete message, false if a length is over the limit
+			template <typename function_t>
+			bool feed(const char* data, size_t size, function_t on_message) {
+				m_pending.append(data, size);
+
+				while (m_pending.size() - m_begin >= header_size) {
+					const uint8_t* header = (const uint8_t*)m_pending.data() + m_begin;
+					uint32_t length = header[0] | header[1] << 8 | header[2] << 16 | (uint32_t)header[3] << 24;
+					if (length > max_message_size) {
+						return false;
+					}
+					if (m_pending.size() - m_begin - header_size < length) {
+						break;
+					}
+					on_message(m_pending.data() + m_begin + header_size, (size_t)length);
+					m_begin += header_size + length;
+				}
+
+				// consumed prefix is dropped only once it's most of the buffer, keeps appends amortized
+				if (m_begin == m_pending.size()) {
+					m_pending.clear();
+					m_begin = 0;
+				}
+				else if (m_begin > m_pending.size() / 2) {
+					m_pending.erase(0, m_begin);
+					m_begin = 0;
+				}
+				return true;
+			}
+
+			std::string m_pending;
+			size_t m_begin = 0;
+		};
+
+		// libuv loop running on its own thread, other threads hand it work through post()
+		struct loop_thread_t {
+
+			void start() {
+				uv_loop_init(&m_loop);
+				m_async.data = this;
+				uv_async_init(&m_loop, &m_async, [](uv_async_t* async) {
+					((loop_thread_t*)async->data)->run_posted();
+				});
+				m_thread = std::thread([this] {
+					fan::time::get_trace().set_thread_name("network");
+					uv_run(&m_loop, UV_RUN_DEFAULT);
+				});
+			}
+
+			// f runs on the loop thread
+			void post(std::function<void()> f) {
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_posted.push_back(std::move(f));
+				}
+				uv_async_send(&m_async);
+			}
+
+			// close_handles runs on the loop thread and must uv_close everything it opened, loop exits when all are closed
+			void stop(std::function<void()> close_handles) {
+				post([this, close_handles] {
+					close_handles();
+					uv_close((uv_handle_t*)&m_async, nullptr);
+				});
+				m_thread.join();
+				uv_loop_close(&m_loop);
+			}
+
+			bool on_loop_thread() const {
+				return std::this_thread::get_id() == m_thread.get_id();
+			}
+
+			void run_posted() {
+				fan_trace_scope("network", "posted");
+				std::vector<std::function<void()>> posted;
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					posted.swap(m_posted);
+				}
+				for (auto& f : posted) {
+					f();
+				}
+			}
+
+			uv_loop_t m_loop;
+			uv_async_t m_async;
+			std::thread m_thread;
+			std::mutex m_mutex;
+			std::vector<std::function<void()>> m_posted;
+		};
+
+		namespace internal {
+
+			// tcp or pipe, whichever the listener / connector uses
+			struct connection_t {
+				union {
+					uv_tcp_t tcp;
+					uv_pipe_t pipe;
+				} handle;
+				uint32_t id;
+				void* owner;
+
+				uv_stream_t* stream() {
+					return (uv_stream_t*)&handle;
+				}
+			};
+
+			struct write_t {
+				uv_write_t request;
+				buffer_t buffer;
+				uint32_t id;
+				void* owner;
+			};
+
+			// one read buffer per loop, read callbacks consume it before returning
+			static void alloc_read_buffer(uv_handle_t*, size_t, uv_buf_t* buf) {
+				thread_local std::vector<char> buffer(1 << 16);
+				*buf = uv_buf_init(buffer.data(), buffer.size());
+			}
+
+		}
+
+		// serves tcp or unix socket (named pipe on windows) clients from a loop thread
+		// send, broadcast and disconnect are thread safe, callbacks run on the loop thread
+		struct server_t {
+
+			typedef uint32_t client_id_t;
+
+			struct callbacks_t {
+				void(*connect)(server_t*, client_id_t, void* userptr) = nullptr;
+				void(*receive)(server_t*, client_id_t, const char* data, size_t size, void* userptr) = nullptr;
+				void(*disconnect)(server_t*, client_id_t, void* userptr) = nullptr;
+				void* userptr = nullptr;
+			};
+
+			// port 0 picks a free one, see get_port
+			void open_tcp(const std::string& address, uint16_t port, const callbacks_t& callbacks) {
+				m_callbacks = callbacks;
+				m_pipe = false;
+				m_stopping = false;
+				m_loop.start();
+				this->listen([this, address, port] {
+					uv_tcp_init(&m_loop.m_loop, &m_listener.tcp);
+					sockaddr_in addr;
+					int result = uv_ip4_addr(address.c_str(), port, &addr);
+					if (result == 0) {
+						result = uv_tcp_bind(&m_listener.tcp, (const sockaddr*)&addr, 0);
+					}
+					if (result == 0) {
+						sockaddr_storage name;
+						int length = sizeof(name);
+						uv_tcp_getsockname(&m_listener.tcp, (sockaddr*)&name, &length);
+						m_port = ntohs(((sockaddr_in*)&name)->sin_port);
+					}
+					return result;
+				}, address + ":" + std::to_string(port));
+			}
+
+			// unix socket path, an old socket file at path is replaced
+			void open_pipe(const std::string& path, const callbacks_t& callbacks) {
+				m_callbacks = callbacks;
+				m_pipe = true;
+				m_stopping = false;
+				m_loop.start();
+				this->listen([this, path] {
+					uv_pipe_init(&m_loop.m_loop, &m_listener.pipe, 0);
+				#if defined(fan_platform_unix)
+					uv_fs_t request;
+					uv_fs_unlink(&m_loop.m_loop, &request, path.c_str(), nullptr);
+					uv_fs_req_cleanup(&request);
+				#endif
+					return uv_pipe_bind(&m_listener.pipe, path.c_str());
+				}, path);
+			}
+
+			void close() {
+				if (!m_open) {
+					return;
+				}
+				m_loop.stop([this] {
+					m_stopping = true;
+					uv_close((uv_handle_t*)&m_listener, nullptr);
+					for (auto& connection : m_connections) {
+						this->close_connection(connection.second);
+					}
+				});
+				m_connections.clear();
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_queued.clear();
+				m_open = false;
+			}
+
+			bool is_open() const {
+				return m_open;
+			}
+
+			uint16_t get_port() const {
+				return m_port;
+			}
+
+			void send(client_id_t id, buffer_t buffer) {
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					auto found = m_queued.find(id);
+					if (found == m_queued.end()) {
+						return;
+					}
+					found->second += buffer->size();
+				}
+				m_loop.post([this, id, buffer] {
+					auto found = m_connections.find(id);
+					if (found != m_connections.end() && !this->write(found->second, buffer)) {
+						this->close_connection(found->second);
+					}
+				});
+			}
+
+			void broadcast(buffer_t buffer) {
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					for (auto& queued : m_queued) {
+						queued.second += buffer->size();
+					}
+				}
+				m_loop.post([this, buffer] {
+					// closing erases from m_connections, not while iterating it
+					std::vector<internal::connection_t*> failed;
+					for (auto& connection : m_connections) {
+						if (!this->write(connection.second, buffer)) {
+							failed.push_back(connection.second);
+						}
+					}
+					for (auto connection : failed) {
+						this->close_connection(connection);
+					}
+				});
+			}
+
+			void disconnect(client_id_t id) {
+				m_loop.post([this, id] {
+					auto found = m_connections.find(id);
+					if (found != m_connections.end()) {
+						this->close_connection(found->second);
+					}
+				});
+			}
+
+			// bytes handed to send/broadcast that the socket hasn't taken yet, -1 if not connected
+			uint64_t queued_bytes(client_id_t id) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				auto found = m_queued.find(id);
+				return found == m_queued.end() ? (uint64_t)-1 : found->second;
+			}
+
+			uint32_t client_count() {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				return m_queued.size();
+			}
+
+		protected:
+
+			template <typename bind_t>
+			void listen(bind_t bind, const std::string& name) {
+				int result = 0;
+				std::mutex done_mutex;
+				std::condition_variable done;
+				bool finished = false;
+				m_loop.post([&] {
+					m_listener.tcp.data = this;
+					result = bind();
+					if (result == 0) {
+						result = uv_listen((uv_stream_t*)&m_listener, 128, [](uv_stream_t* listener, int status) {
+							if (status >= 0) {
+								((server_t*)listener->data)->accept();
+							}
+						});
+					}
+					std::lock_guard<std::mutex> lock(done_mutex);
+					finished = true;
+					done.notify_one();
+				});
+				{
+					std::unique_lock<std::mutex> lock(done_mutex);
+					done.wait(lock, [&] { return finished; });
+				}
+				m_open = true;
+				if (result != 0) {
+					this->close();
+					fan::throw_error("failed to listen on " + name + ": " + uv_strerror(result));
+				}
+			}
+
+			void accept() {
+				auto connection = new internal::connection_t;
+				if (m_pipe) {
+					uv_pipe_init(&m_loop.m_loop, &connection->handle.pipe, 0);
+				}
+				else {
+					uv_tcp_init(&m_loop.m_loop, &connection->handle.tcp);
+				}
+				connection->owner = this;
+				connection->stream()->data = connection;
+				if (uv_accept((uv_stream_t*)&m_listener, connection->stream()) != 0) {
+					uv_close((uv_handle_t*)connection->stream(), [](uv_handle_t* handle) { delete (internal::connection_t*)handle->data; });
+					return;
+				}
+				if (!m_pipe) {
+					// small per generation messages, don't wait to coalesce
+					uv_tcp_nodelay(&connection->handle.tcp, 1);
+				}
+				connection->id = m_next_id++;
+				m_connections[connection->id] = connection;
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_queued[connection->id] = 0;
+				}
+
+				uv_read_start(connection->stream(), internal::alloc_read_buffer, [](uv_stream_t* stream, ssize_t size, const uv_buf_t* buf) {
+					auto connection = (internal::connection_t*)stream->data;
+					auto server = (server_t*)connection->owner;
+					if (size < 0) {
+						server->close_connection(connection);
+						return;
+					}
+					if (size > 0 && server->m_callbacks.receive) {
+						server->m_callbacks.receive(server, connection->id, buf->base, size, server->m_callbacks.userptr);
+					}
+				});
+
+				if (m_callbacks.connect) {
+					m_callbacks.connect(this, connection->id, m_callbacks.userptr);
+				}
+			}
+
+			// false if the socket refused the buffer, the caller closes the connection then
+			bool write(internal::connection_t* connection, const buffer_t& buffer) {
+				auto w = new internal::write_t{ {}, buffer, connection->id, this };
+				uv_buf_t buf = uv_buf_init((char*)buffer->data(), buffer->size());
+				int result = uv_write(&w->request, connection->stream(), &buf, 1, [](uv_write_t* request, int) {
+					auto w = (internal::write_t*)request;
+					((server_t*)w->owner)->written(w->id, w->buffer->size());
+					delete w;
+				});
+				if (result != 0) {
+					this->written(connection->id, buffer->size());
+					delete w;
+					return false;
+				}
+				return true;
+			}
+
+			void written(client_id_t id, uint64_t size) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				auto found = m_queued.find(id);
+				if (found != m_queued.end()) {
+					found->second -= size;
+				}
+			}
+
+			void close_connection(internal::connection_t* connection) {
+				if (uv_is_closing((uv_handle_t*)connection->stream())) {
+					return;
+				}
+				// m_connections is iterated by close(), cleared there instead
+				if (!m_stopping) {
+					m_connections.erase(connection->id);
+				}
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_queued.erase(connection->id);
+				}
+				if (m_callbacks.disconnect) {
+					m_callbacks.disconnect(this, connection->id, m_callbacks.userptr);
+				}
+				uv_close((uv_handle_t*)connection->stream(), [](uv_handle_t* handle) { delete (internal::connection_t*)handle->data; });
+			}
+
+			loop_thread_t m_loop;
+			union {
+				uv_tcp_t tcp;
+				uv_pipe_t pipe;
+			} m_listener;
+			bool m_pipe = false;
+			bool m_open = false;
+			bool m_stopping = false;
+			uint16_t m_port = 0;
+			callbacks_t m_callbacks;
+
+			// loop thread only
+			std::unordered_map<client_id_t, internal::connection_t*> m_connections;
+			client_id_t m_next_id = 0;
+
+			// send side accounting, any thread
+			std::mutex m_mutex;
+			std::unordered_map<client_id_t, uint64_t> m_queued;
+		};
+
+		// one connection to a server_t, same threading as the server
+		struct client_t {
+
+			struct callbacks_t {
+				void(*connect)(client_t*, bool connected, void* userptr) = nullptr;
+				void(*receive)(client_t*, const char* data, size_t size, void* userptr) = nullptr;
+				void(*disconnect)(client_t*, void* userptr) = nullptr;
+				void* userptr = nullptr;
+				bool log_failures = true; // false when the caller reports the connect callback itself, e.g. from a process that can't log
+			};
+
+			// host name or address, connect callback reports the result
+			void connect_tcp(const std::string& host, uint16_t port, const callbacks_t& callbacks) {
+				this->start(callbacks, false);
+				m_loop.post([this, host, port] {
+					uv_tcp_init(&m_loop.m_loop, &m_connection.handle.tcp);
+					m_resolve.data = this;
+					addrinfo hints = {};
+					hints.ai_family = AF_INET;
+					hints.ai_socktype = SOCK_STREAM;
+					int result = uv_getaddrinfo(&m_loop.m_loop, &m_resolve, [](uv_getaddrinfo_t* resolve, int status, addrinfo* info) {
+						auto client = (client_t*)resolve->data;
+						if (status != 0 || client->m_closing) {
+							uv_freeaddrinfo(info);
+							client->connected(status != 0 ? status : UV_ECANCELED);
+							return;
+						}
+						int result = uv_tcp_connect(&client->m_connect, &client->m_connection.handle.tcp, info->ai_addr, [](uv_connect_t* request, int status) {
+							((client_t*)request->data)->connected(status);
+						});
+						uv_freeaddrinfo(info);
+						if (result != 0) {
+							client->connected(result);
+						}
+					}, host.c_str(), std::to_string(port).c_str(), &hints);
+					if (result != 0) {
+						this->connected(result);
+					}
+				});
+			}
+
+			void connect_pipe(const std::string& path, const callbacks_t& callbacks) {
+				this->start(callbacks, true);
+				m_loop.post([this, path] {
+					uv_pipe_init(&m_loop.m_loop, &m_connection.handle.pipe, 0);
+					uv_pipe_connect(&m_connect, &m_connection.handle.pipe, path.c_str(), [](uv_connect_t* request, int status) {
+						((client_t*)request->data)->connected(status);
+					});
+				});
+			}
+
+			void close() {
+				if (!m_started) {
+					return;
+				}
+				m_loop.stop([this] {
+					m_closing = true;
+					if (m_resolving) {
+						uv_cancel((uv_req_t*)&m_resolve);
+					}
+					if (!uv_is_closing((uv_handle_t*)m_connection.stream())) {
+						uv_close((uv_handle_t*)m_connection.stream(), nullptr);
+					}
+				});
+				m_started = false;
+				m_connected = false;
+			}
+
+			bool is_connected() const {
+				return m_connected;
+			}
+
+			// drops the connection, disconnect callback is called if it was connected. Thread safe
+			void disconnect() {
+				m_loop.post([this] {
+					if (uv_is_closing((uv_handle_t*)m_connection.stream())) {
+						return;
+					}
+					bool connected = m_connected.exchange(false);
+					uv_close((uv_handle_t*)m_connection.stream(), nullptr);
+					if (connected && m_callbacks.disconnect) {
+						m_callbacks.disconnect(this, m_callbacks.userptr);
+					}
+				});
+			}
+
+			void send(buffer_t buffer) {
+				m_loop.post([this, buffer] {
+					if (!m_connected) {
+						return;
+					}
+					auto w = new internal::write_t{ {}, buffer, 0, this };
+					uv_buf_t buf = uv_buf_init((char*)buffer->data(), buffer->size());
+					if (uv_write(&w->request, m_connection.stream(), &buf, 1, [](uv_write_t* request, int) { delete (internal::write_t*)request; }) != 0) {
+						delete w;
+					}
+				});
+			}
+
+		protected:
+
+			void start(const callbacks_t& callbacks, bool pipe) {
+				this->close();
+				m_callbacks = callbacks;
+				m_pipe = pipe;
+				m_closing = false;
+				m_resolving = !pipe;
+				m_connection.owner = this;
+				m_connection.handle.tcp.data = &m_connection;
+				m_connect.data = this;
+				m_loop.start();
+				m_started = true;
+			}
+
+			void connected(int status) {
+				m_resolving = false;
+				if (m_closing) {
+					return;
+				}
+				if (status != 0) {
+					if (m_callbacks.log_failures) {
+						fan_log_warning("connect failed:", uv_strerror(status));
+					}
+					if (m_callbacks.connect) {
+						m_callbacks.connect(this, false, m_callbacks.userptr);
+					}
+					return;
+				}
+				if (!m_pipe) {
+					uv_tcp_nodelay(&m_connection.handle.tcp, 1);
+				}
+				m_connected = true;
+				if (m_callbacks.connect) {
+					m_callbacks.connect(this, true, m_callbacks.userptr);
+				}
+				uv_read_start(m_connection.stream(), internal::alloc_read_buffer, [](uv_stream_t* stream, ssize_t size, const uv_buf_t* buf) {
+					auto client = (client_t*)((internal::connection_t*)stream->data)->owner;
+					if (size < 0) {
+						client->m_connected = false;
+						uv_read_stop(stream);
+						if (client->m_callbacks.disconnect) {
+							client->m_callbacks.disconnect(client, client->m_callbacks.userptr);
+						}
+						return;
+					}
+					if (size > 0 && client->m_callbacks.receive) {
+						client->m_callbacks.receive(client, buf->base, size, client->m_callbacks.userptr);
+					}
+				});
+			}
+
+			loop_thread_t m_loop;
+			internal::connection_t m_connection;
+			uv_connect_t m_connect;
+			uv_getaddrinfo_t m_resolve;
+			callbacks_t m_callbacks;
+			bool m_pipe = false;
+			bool m_started = false;
+			bool m_closing = false;
+			bool m_resolving = false;
+			std::atomic<bool> m_connected = false;
+		};
+
+	}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <fan/types/types.h>
+#include <fan/time/trace.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace fan {
+
+	// splits [0, count) into one contiguous range per hardware thread, calls f(begin, end) for each
+	// calling thread does the last range, returns when all are done
+	// ranges smaller than min_chunk aren't worth a thread, small counts run inline
+	template <typename function_t>
+	void parallel_for(uint64_t count, function_t f, uint64_t min_chunk = 4096) {
+		uint64_t threads = std::max(1u, std::thread::hardware_concurrency());
+		threads = std::min(threads, (count + min_chunk - 1) / min_chunk);
+
+		if (threads <= 1) {
+			if (count) {
+				f((uint64_t)0, count);
+			}
+			return;
+		}
+
+		std::vector<std::thread> workers;
+		workers.reserve(threads - 1);
+
+		uint64_t chunk = count / threads;
+		for (uint64_t i = 0; i < threads - 1; i++) {
+			workers.emplace_back([&f, i, chunk] {
+				fan::time::get_trace().set_thread_name("parallel_for");
+				fan_trace_scope("parallel", "range");
+				f(i * chunk, (i + 1) * chunk);
+			});
+		}
+		{
+			fan_trace_scope("parallel", "range");
+			f((threads - 1) * chunk, count);
+		}
+
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <fan/types/types.h>
+#include <fan/time/time.h>
+
+#include <algorithm>
+#include <thread>
+
+#ifdef fan_platform_unix
+	#include <cerrno>
+	#include <time.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#include <immintrin.h>
+#endif
+
+namespace fan {
+
+	namespace time {
+
+		// frame times in fixed width buckets, last bucket collects everything longer
+		struct frame_histogram_t {
+
+			static constexpr uint32_t bucket_count = 128;
+			// 0.25 ms, covers up to 32 ms
+			static constexpr uint64_t bucket_width = 250000;
+
+			void clear() {
+				std::fill(m_buckets, m_buckets + bucket_count, 0);
+				m_count = 0;
+				m_total = 0;
+				m_max = 0;
+			}
+
+			void add(uint64_t frame_time) {
+				m_buckets[std::min(frame_time / bucket_width, (uint64_t)bucket_count - 1)]++;
+				m_count++;
+				m_total += frame_time;
+				m_max = std::max(m_max, frame_time);
+			}
+
+			// upper edge of bucket holding given fraction of frames, 0.99 for p99
+			uint64_t percentile(f64_t fraction) const {
+				uint64_t goal = (uint64_t)std::ceil(m_count * fraction);
+				uint64_t seen = 0;
+				for (uint32_t i = 0; i < bucket_count; i++) {
+					seen += m_buckets[i];
+					if (seen >= goal && seen) {
+						return (i + 1) * bucket_width;
+					}
+				}
+				return m_max;
+			}
+
+			uint64_t average() const {
+				return m_count ? m_total / m_count : 0;
+			}
+
+			uint64_t max() const {
+				return m_max;
+			}
+
+			uint64_t count() const {
+				return m_count;
+			}
+
+			uint64_t bucket(uint32_t i) const {
+				return m_buckets[i];
+			}
+
+		protected:
+
+			uint64_t m_buckets[bucket_count] = {};
+			uint64_t m_count = 0;
+			uint64_t m_total = 0;
+			uint64_t m_max = 0;
+		};
+
+		// paces a loop to a fixed rate
+		// os sleep until spin_window before deadline, then busy waits the rest
+		// deadlines advance by whole periods so one late frame doesn't shift the ones after it
+		struct frame_pacer_t {
+
+			// sleep overshoot is ~1 ms on windows even with 1 ms timer resolution, tens of us on linux
+		#ifdef fan_platform_windows
+			static constexpr uint64_t default_spin_window = 2000000;
+		#else
+			static constexpr uint64_t default_spin_window = 500000;
+		#endif
+
+			void open(uint64_t fps = 0) {
+				m_spin_window = default_spin_window;
+				m_histogram.clear();
+				this->set_fps(fps);
+			}
+
+			// 0 = unlimited, wait() only records frame times
+			void set_fps(uint64_t fps) {
+				m_period = fps ? 1000000000 / fps : 0;
+				m_deadline = fan::time::clock::now() + m_period;
+				m_last_frame = 0;
+			}
+
+			// next wait() doesn't count time since previous one, for when the loop was idle on purpose
+			void restart() {
+				m_deadline = fan::time::clock::now();
+				m_last_frame = 0;
+			}
+
+			uint64_t get_fps() const {
+				return m_period ? 1000000000 / m_period : 0;
+			}
+
+			// nanoseconds spent spinning before each deadline, more = steadier & more cpu
+			void set_spin_window(uint64_t spin_window) {
+				m_spin_window = spin_window;
+			}
+
+			uint64_t get_spin_window() const {
+				return m_spin_window;
+			}
+
+			// blocks until start of next frame
+			void wait() {
+				if (m_period) {
+					uint64_t now = fan::time::clock::now();
+
+					// more than a frame behind, start over instead of rushing to catch up
+					if (now > m_deadline + m_period) {
+						m_deadline = now;
+					}
+
+					if (m_deadline > now + m_spin_window) {
+						sleep_until(m_deadline - m_spin_window);
+					}
+
+					while (fan::time::clock::now() < m_deadline) {
+						spin_pause();
+					}
+
+					m_deadline += m_period;
+				}
+
+				uint64_t now = fan::time::clock::now();
+				if (m_last_frame) {
+					m_histogram.add(now - m_last_frame);
+				}
+				m_last_frame = now;
+			}
+
+			const frame_histogram_t& get_histogram() const {
+				return m_histogram;
+			}
+
+			void reset_histogram() {
+				m_histogram.clear();
+			}
+
+		protected:
+
+			static void sleep_until(uint64_t time) {
+			#if defined(fan_platform_unix)
+				// absolute, not affected by how long it took to get here
+				struct timespec t;
+				t.tv_sec = time / 1000000000;
+				t.tv_nsec = time % 1000000000;
+				while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, 0) == EINTR) {}
+			#else
+				uint64_t now = fan::time::clock::now();
+				if (time > now) {
+					fan::delay(fan::time::nanoseconds(time - now));
+				}
+			#endif
+			}
+
+			static void spin_pause() {
+			#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+				_mm_pause();
+			#else
+				std::this_thread::yield();
+			#endif
+			}
+
+			uint64_t m_period = 0;
+			uint64_t m_deadline = 0;
+			uint64_t m_spin_window = default_spin_window;
+			uint64_t m_last_frame = 0;
+
+			frame_histogram_t m_histogram;
+		};
+
+	}
+}
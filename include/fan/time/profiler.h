@@ -0,0 +1,171 @@
+#pragma once
+
+#include <fan/types/types.h>
+#include <fan/time/time.h>
+
+#include <algorithm>
+#include <atomic>
+
+// fan_profiler 0 removes every fan_profile_scope, profiler_t itself stays usable
+#ifndef fan_profiler
+	#define fan_profiler 1
+#endif
+
+namespace fan {
+
+	namespace time {
+
+		// single producer single consumer, push fails when full instead of blocking
+		template <typename T, uint32_t size>
+		struct spsc_ring_t {
+
+			static_assert((size & (size - 1)) == 0, "size must be power of two");
+
+			bool push(const T& value) {
+				uint32_t head = m_head.load(std::memory_order_relaxed);
+				if (head - m_tail.load(std::memory_order_acquire) == size) {
+					return false;
+				}
+				m_data[head & (size - 1)] = value;
+				m_head.store(head + 1, std::memory_order_release);
+				return true;
+			}
+
+			bool pop(T& value) {
+				uint32_t tail = m_tail.load(std::memory_order_relaxed);
+				if (tail == m_head.load(std::memory_order_acquire)) {
+					return false;
+				}
+				value = m_data[tail & (size - 1)];
+				m_tail.store(tail + 1, std::memory_order_release);
+				return true;
+			}
+
+			alignas(64) std::atomic<uint32_t> m_head{ 0 };
+			alignas(64) std::atomic<uint32_t> m_tail{ 0 };
+			T m_data[size];
+		};
+
+		// per phase timings of last history_size samples
+		// record() is called by the timed thread, collect() and get_stats() by the reader
+		struct profiler_t {
+
+			static constexpr uint32_t max_phases = 16;
+			static constexpr uint32_t history_size = 256;
+
+			struct sample_t {
+				uint32_t phase;
+				uint64_t duration;
+			};
+
+			struct stats_t {
+				// nanoseconds
+				uint64_t last = 0;
+				uint64_t average = 0;
+				uint64_t p99 = 0;
+				uint64_t max = 0;
+			};
+
+			uint32_t add_phase(const char* name) {
+			#if fan_debug >= fan_debug_low
+				if (m_phase_count == max_phases) {
+					fan::throw_error("too many profiler phases");
+				}
+			#endif
+				m_phases[m_phase_count].name = name;
+				return m_phase_count++;
+			}
+
+			void record(uint32_t phase, uint64_t duration) {
+				if (!enabled) {
+					return;
+				}
+				// dropped if reader is behind, better than stalling the frame
+				m_ring.push({ phase, duration });
+			}
+
+			// moves recorded samples to history
+			void collect() {
+				sample_t sample;
+				while (m_ring.pop(sample)) {
+					phase_t& phase = m_phases[sample.phase];
+					phase.history[phase.count % history_size] = sample.duration;
+					phase.count++;
+				}
+			}
+
+			stats_t get_stats(uint32_t phase_id) const {
+				const phase_t& phase = m_phases[phase_id];
+
+				stats_t stats;
+
+				uint32_t n = std::min(phase.count, history_size);
+				if (n == 0) {
+					return stats;
+				}
+
+				stats.last = phase.history[(phase.count - 1) % history_size];
+
+				uint64_t sorted[history_size];
+				uint64_t total = 0;
+				for (uint32_t i = 0; i < n; i++) {
+					sorted[i] = phase.history[i];
+					total += sorted[i];
+				}
+				stats.average = total / n;
+
+				uint32_t p99 = (n * 99) / 100;
+				std::nth_element(sorted, sorted + p99, sorted + n);
+				stats.p99 = sorted[p99];
+				stats.max = *std::max_element(sorted, sorted + n);
+
+				return stats;
+			}
+
+			const char* get_name(uint32_t phase_id) const {
+				return m_phases[phase_id].name;
+			}
+
+			uint32_t phase_count() const {
+				return m_phase_count;
+			}
+
+			bool enabled = true;
+
+		protected:
+
+			struct phase_t {
+				const char* name = "";
+				uint32_t count = 0;
+				uint64_t history[history_size];
+			};
+
+			phase_t m_phases[max_phases];
+			uint32_t m_phase_count = 0;
+
+			spsc_ring_t<sample_t, 1024> m_ring;
+		};
+
+		struct profile_scope_t {
+
+			profile_scope_t(profiler_t* profiler, uint32_t phase) : m_profiler(profiler), m_phase(phase), m_start(fan::time::clock::now()) {}
+
+			~profile_scope_t() {
+				m_profiler->record(m_phase, fan::time::clock::now() - m_start);
+			}
+
+			profiler_t* m_profiler;
+			uint32_t m_phase;
+			uint64_t m_start;
+		};
+
+	}
+}
+
+#if fan_profiler
+	// times rest of the enclosing scope
+	#define fan_profile_scope(profiler_m, phase_m) \
+		fan::time::profile_scope_t CONCAT(fan_profile_scope_, __LINE__)(profiler_m, phase_m)
+#else
+	#define fan_profile_scope(profiler_m, phase_m)
+#endif
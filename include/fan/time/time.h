@@ -142,9 +142,12 @@ namespace fan {
 
 #if defined(fan_platform_windows)
 
-				LARGE_INTEGER freq;
-				QueryPerformanceFrequency(&freq);
-				double nanoseconds_per_count = 1.0e9 / static_cast<double>(freq.QuadPart);
+				// frequency is fixed at boot
+				static const double nanoseconds_per_count = [] {
+					LARGE_INTEGER freq;
+					QueryPerformanceFrequency(&freq);
+					return 1.0e9 / static_cast<double>(freq.QuadPart);
+				}();
 
 				LARGE_INTEGER time;
 				QueryPerformanceCounter(&time);
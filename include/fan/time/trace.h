@@ -0,0 +1,250 @@
+#pragma once
+
+#include <fan/types/types.h>
+#include <fan/time/time.h>
+#include <fan/time/profiler.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fan_trace 0 removes every fan_trace_scope
+#ifndef fan_trace
+	#define fan_trace 1
+#endif
+
+namespace fan {
+
+	namespace time {
+
+		// Chrome trace event format (json), opens in chrome://tracing and ui.perfetto.dev
+		// every thread records to its own ring, background thread drains the rings to file
+		// names and categories must be string literals (pointers are stored, not copied)
+		struct trace_t {
+
+			static constexpr uint32_t ring_size = 4096;
+			// how often writer wakes up
+			static constexpr uint64_t flush_interval = 50000000;
+
+			struct event_t {
+				const char* category;
+				const char* name;
+				uint64_t begin;
+				uint64_t duration;
+			};
+
+			~trace_t() {
+				this->close();
+			}
+
+			// starts recording, returns false if file can't be opened
+			bool open(const char* path) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				if (m_file != nullptr) {
+					return true;
+				}
+
+				m_file = std::fopen(path, "wb");
+				if (m_file == nullptr) {
+					return false;
+				}
+
+				std::fputs("{\"traceEvents\":[\n", m_file);
+				m_first_event = true;
+				m_origin = fan::time::clock::now();
+				m_dropped = 0;
+				m_running = true;
+				m_writer = std::thread([this] { this->writer(); });
+
+				m_enabled.store(true, std::memory_order_release);
+				return true;
+			}
+
+			void close() {
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					if (m_file == nullptr) {
+						return;
+					}
+					m_enabled.store(false, std::memory_order_release);
+					m_running = false;
+				}
+				m_wake.notify_one();
+				m_writer.join();
+
+				std::lock_guard<std::mutex> lock(m_mutex);
+				this->drain();
+				std::fprintf(m_file, "\n],\"otherData\":{\"dropped_events\":%llu}}\n", (unsigned long long)m_dropped.load());
+				std::fclose(m_file);
+				m_file = nullptr;
+			}
+
+			bool enabled() const {
+				return m_enabled.load(std::memory_order_relaxed);
+			}
+
+			// name shown for calling thread, call when the thread starts
+			// ignored while tracing is closed, so threads of untraced runs don't get a buffer
+			void set_thread_name(const char* name) {
+				if (!this->enabled()) {
+					return;
+				}
+				thread_buffer_t* buffer = this->get_thread_buffer(name);
+				// writer reads it while draining
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (buffer->name != name) {
+					buffer->name = name;
+					buffer->named = false;
+				}
+			}
+
+			void record(const char* category, const char* name, uint64_t begin, uint64_t duration) {
+				if (!this->enabled()) {
+					return;
+				}
+				if (!this->get_thread_buffer()->ring.push({ category, name, begin, duration })) {
+					m_dropped++;
+				}
+			}
+
+		protected:
+
+			struct thread_buffer_t {
+				uint32_t id;
+				const char* name = nullptr;
+				bool named = false;
+				// thread exited, next new thread of the same name takes the buffer (and its id) over
+				bool released = false;
+				spsc_ring_t<event_t, ring_size> ring;
+			};
+
+			// releases the thread's buffer when the thread exits, trace_t must outlive every thread that records
+			struct thread_handle_t {
+				~thread_handle_t() {
+					if (buffer != nullptr) {
+						std::lock_guard<std::mutex> lock(trace->m_mutex);
+						buffer->released = true;
+					}
+				}
+
+				trace_t* trace = nullptr;
+				thread_buffer_t* buffer = nullptr;
+			};
+
+			thread_buffer_t* get_thread_buffer(const char* name = nullptr) {
+				// buffers are owned by trace_t so events of exited threads are still written
+				// & reused, parallel_for starts new threads on every call
+				thread_local thread_handle_t handle;
+				if (handle.buffer == nullptr) {
+					std::lock_guard<std::mutex> lock(m_mutex);
+					for (auto& buffer : m_buffers) {
+						if (buffer->released && buffer->name == name) {
+							handle.buffer = buffer.get();
+							break;
+						}
+					}
+					if (handle.buffer == nullptr) {
+						m_buffers.push_back(std::make_unique<thread_buffer_t>());
+						handle.buffer = m_buffers.back().get();
+						handle.buffer->id = m_buffers.size();
+					}
+					handle.buffer->released = false;
+					handle.trace = this;
+				}
+				return handle.buffer;
+			}
+
+			void writer() {
+				std::unique_lock<std::mutex> lock(m_mutex);
+				while (m_running) {
+					m_wake.wait_for(lock, std::chrono::nanoseconds(flush_interval));
+					this->drain();
+					std::fflush(m_file);
+				}
+			}
+
+			// m_mutex must be locked
+			void drain() {
+				for (auto& buffer : m_buffers) {
+					if (buffer->name != nullptr && !buffer->named) {
+						this->separator();
+						std::fprintf(m_file, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", buffer->id, buffer->name);
+						buffer->named = true;
+					}
+
+					event_t event;
+					while (buffer->ring.pop(event)) {
+						this->separator();
+						// microseconds
+						std::fprintf(
+							m_file,
+							"{\"ph\":\"X\",\"cat\":\"%s\",\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+							event.category,
+							event.name,
+							buffer->id,
+							(int64_t)(event.begin - m_origin) / 1e3,
+							event.duration / 1e3
+						);
+					}
+				}
+			}
+
+			void separator() {
+				if (!m_first_event) {
+					std::fputs(",\n", m_file);
+				}
+				m_first_event = false;
+			}
+
+			std::atomic<bool> m_enabled{ false };
+			std::atomic<uint64_t> m_dropped{ 0 };
+
+			std::mutex m_mutex;
+			std::condition_variable m_wake;
+			std::thread m_writer;
+			bool m_running = false;
+
+			std::FILE* m_file = nullptr;
+			bool m_first_event = true;
+			uint64_t m_origin = 0;
+
+			std::vector<std::unique_ptr<thread_buffer_t>> m_buffers;
+		};
+
+		inline trace_t& get_trace() {
+			static trace_t trace;
+			return trace;
+		}
+
+		struct trace_scope_t {
+
+			trace_scope_t(const char* category, const char* name) : m_category(category), m_name(name) {
+				m_begin = get_trace().enabled() ? fan::time::clock::now() : 0;
+			}
+
+			~trace_scope_t() {
+				if (m_begin) {
+					get_trace().record(m_category, m_name, m_begin, fan::time::clock::now() - m_begin);
+				}
+			}
+
+			const char* m_category;
+			const char* m_name;
+			uint64_t m_begin;
+		};
+
+	}
+}
+
+#if fan_trace
+	// records rest of the enclosing scope as one event when tracing is open
+	#define fan_trace_scope(category_m, name_m) \
+		fan::time::trace_scope_t CONCAT(fan_trace_scope_, __LINE__)(category_m, name_m)
+#else
+	#define fan_trace_scope(category_m, name_m)
+#endif
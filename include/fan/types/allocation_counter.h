@@ -0,0 +1,86 @@
+#pragma once
+
+#include <fan/types/types.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// counts every global operator new and the malloc/realloc calls of fan containers (hector_t, arena_t),
+// on by default in debug builds
+// define fan_count_allocations_implementation in exactly one translation unit before including
+// to replace the global operators, without it only the fan containers are counted
+#ifndef fan_count_allocations
+	#ifdef NDEBUG
+		#define fan_count_allocations 0
+	#else
+		#define fan_count_allocations 1
+	#endif
+#endif
+
+namespace fan {
+
+	inline std::atomic<uint64_t> allocation_counter{ 0 };
+
+	// for heap allocations that bypass operator new
+	inline void count_allocation() {
+	#if fan_count_allocations
+		allocation_counter.fetch_add(1, std::memory_order_relaxed);
+	#endif
+	}
+
+	// heap allocations since start of program, compare two calls to get allocations in between
+	inline uint64_t allocation_count() {
+		return allocation_counter.load(std::memory_order_relaxed);
+	}
+
+}
+
+#if fan_count_allocations && defined(fan_count_allocations_implementation)
+
+	// array, nothrow and sized versions forward to these by default
+
+	void* operator new(std::size_t size) {
+		fan::allocation_counter.fetch_add(1, std::memory_order_relaxed);
+		if (void* ptr = std::malloc(size ? size : 1)) {
+			return ptr;
+		}
+		throw std::bad_alloc();
+	}
+
+	void operator delete(void* ptr) noexcept {
+		std::free(ptr);
+	}
+
+	void operator delete(void* ptr, std::size_t) noexcept {
+		std::free(ptr);
+	}
+
+	void* operator new(std::size_t size, std::align_val_t alignment) {
+		fan::allocation_counter.fetch_add(1, std::memory_order_relaxed);
+		std::size_t a = (std::size_t)alignment;
+	#ifdef fan_platform_windows
+		void* ptr = _aligned_malloc(size ? size : 1, a);
+	#else
+		// aligned_alloc wants size to be a multiple of alignment
+		void* ptr = std::aligned_alloc(a, ((size ? size : 1) + a - 1) / a * a);
+	#endif
+		if (ptr) {
+			return ptr;
+		}
+		throw std::bad_alloc();
+	}
+
+	void operator delete(void* ptr, std::align_val_t) noexcept {
+	#ifdef fan_platform_windows
+		_aligned_free(ptr);
+	#else
+		std::free(ptr);
+	#endif
+	}
+
+	void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+		operator delete(ptr, alignment);
+	}
+
+#endif
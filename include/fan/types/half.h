@@ -0,0 +1,100 @@
+#pragma once
+
+#include <fan/types/types.h>
+
+#include <cstring>
+
+namespace fan {
+
+	// ieee 754 binary16, storage only - convert to f32_t for math
+	struct half_t {
+
+		half_t() = default;
+
+		half_t(f32_t value) : bits(from_float(value)) {}
+
+		operator f32_t() const {
+			return to_float(bits);
+		}
+
+		// round to nearest even, overflow goes to inf, nan stays nan
+		static uint16_t from_float(f32_t value) {
+			uint32_t f;
+			std::memcpy(&f, &value, sizeof(f));
+
+			uint32_t sign = (f >> 16) & 0x8000;
+			uint32_t exponent = (f >> 23) & 0xff;
+			uint32_t mantissa = f & 0x7fffff;
+
+			if (exponent == 0xff) {
+				return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+			}
+
+			int32_t e = (int32_t)exponent - 127 + 15;
+
+			if (e >= 0x1f) {
+				return sign | 0x7c00;
+			}
+
+			if (e <= 0) {
+				// denormal or zero
+				if (e < -10) {
+					return sign;
+				}
+				mantissa |= 0x800000;
+				uint32_t shift = 14 - e;
+				uint32_t half_mantissa = mantissa >> shift;
+				uint32_t remainder = mantissa & ((1 << shift) - 1);
+				uint32_t halfway = 1 << (shift - 1);
+				if (remainder > halfway || (remainder == halfway && (half_mantissa & 1))) {
+					half_mantissa++;
+				}
+				return sign | half_mantissa;
+			}
+
+			uint32_t h = sign | (e << 10) | (mantissa >> 13);
+			uint32_t remainder = mantissa & 0x1fff;
+			// carry may overflow into exponent which is the correct result
+			if (remainder > 0x1000 || (remainder == 0x1000 && (h & 1))) {
+				h++;
+			}
+			return h;
+		}
+
+		static f32_t to_float(uint16_t h) {
+			uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+			uint32_t exponent = (h >> 10) & 0x1f;
+			uint32_t mantissa = h & 0x3ff;
+
+			uint32_t f;
+
+			if (exponent == 0) {
+				if (mantissa == 0) {
+					f = sign;
+				}
+				else {
+					exponent = 127 - 15 + 1;
+					while (!(mantissa & 0x400)) {
+						mantissa <<= 1;
+						exponent--;
+					}
+					mantissa &= 0x3ff;
+					f = sign | (exponent << 23) | (mantissa << 13);
+				}
+			}
+			else if (exponent == 0x1f) {
+				f = sign | 0x7f800000 | (mantissa << 13);
+			}
+			else {
+				f = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+			}
+
+			f32_t value;
+			std::memcpy(&value, &f, sizeof(value));
+			return value;
+		}
+
+		uint16_t bits;
+	};
+
+}
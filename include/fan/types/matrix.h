@@ -154,7 +154,7 @@ namespace fan {
 
       for (int i = 0; i < 4; i++) {
         for (int j = 0; j < 4; j++) {
-          int num = 0;
+          type_t num = 0;
           for (int k = 0; k < 4; k++) {
             num += m_array[i][k] * matrix[k][j];
           }
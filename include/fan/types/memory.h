@@ -2,60 +2,104 @@
 
 #include <fan/types/types.h>
 
+#include <fan/types/allocation_counter.h>
 #include <fan/types/memory.h>
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
 namespace fan {
 
+  // types that can be moved to another address with memcpy and the old copy forgotten
+  // specialize for types that are not trivially copyable but still safe to relocate
+  template <typename type_t>
+  struct is_trivially_relocatable : std::is_trivially_copyable<type_t> {};
+
   template <typename type_t>
   struct hector_t {
 
+    static constexpr bool relocatable = is_trivially_relocatable<type_t>::value;
+
     void open() {
       m_size = 0;
       m_capacity = 0;
       ptr = 0;
     }
     void close() {
-      resize_buffer(ptr, 0);
+      destroy(ptr, ptr + m_size);
+      free_buffer(ptr);
       open();
     }
 
     uintptr_t push_back(const type_t& value) {
-      m_size++;
-      handle_buffer();
-      ptr[m_size - 1] = value;
-      return m_size - 1;
+      if (m_size == m_capacity) {
+        // value may point inside the buffer that is about to move
+        if (&value >= ptr && &value < ptr + m_size) {
+          uintptr_t i = &value - ptr;
+          grow(m_size + 1);
+          new (ptr + m_size) type_t(ptr[i]);
+          return m_size++;
+        }
+        grow(m_size + 1);
+      }
+      new (ptr + m_size) type_t(value);
+      return m_size++;
     }
 
-    void emplace_back(type_t&& value) {
-      push_back(value);
+    uintptr_t emplace_back(type_t&& value) {
+      if (m_size == m_capacity) {
+        if (&value >= ptr && &value < ptr + m_size) {
+          return push_back(value);
+        }
+        grow(m_size + 1);
+      }
+      new (ptr + m_size) type_t(std::move(value));
+      return m_size++;
     }
 
     template <typename T>
     void insert(uintptr_t i, T* begin, T* end) {
     #if fan_debug >= fan_debug_low
-
+      if (i > m_size) {
+        fan::throw_error("invalid insert location");
+      }
     #endif
       uintptr_t n = uintptr_t(end - begin);
 
-      m_size += n;
-      handle_buffer();
+      if (m_size + n > m_capacity) {
+        grow(m_size + n);
+      }
 
-      uintptr_t previous_size = m_size - i - n;
+      open_gap(i, n);
 
-      std::memmove(ptr + i + n, ptr + i, previous_size * sizeof(type_t));
-      std::memmove(ptr + i, begin, n * sizeof(T));
+      if constexpr (relocatable) {
+        std::memmove(ptr + i, begin, n * sizeof(T));
+      }
+      else {
+        for (uintptr_t j = 0; j < n; j++) {
+          new (ptr + i + j) type_t(begin[j]);
+        }
+      }
+      m_size += n;
     }
 
     void insert(uintptr_t i, type_t element) {
-      uintptr_t n = 1;
-
-      uintptr_t previous_size = m_size - i;
-
-      m_size += n;
-      handle_buffer();
+    #if fan_debug >= fan_debug_low
+      if (i > m_size) {
+        fan::throw_error("invalid insert location");
+      }
+    #endif
+      if (m_size == m_capacity) {
+        grow(m_size + 1);
+      }
 
-      std::memmove(ptr + i + n, ptr + i, previous_size * sizeof(type_t));
-      *(ptr + i) = element;
+      open_gap(i, 1);
+      new (ptr + i) type_t(std::move(element));
+      m_size++;
     }
 
     void erase(uintptr_t i) {
@@ -80,10 +124,10 @@ namespace fan {
     #endif
       uintptr_t n = end - begin;
 
-      std::memmove(ptr + begin, ptr + end, (m_size - end) * sizeof(type_t));
+      destroy(ptr + begin, ptr + end);
+      relocate(ptr + begin, ptr + end, m_size - end);
 
       m_size -= n;
-      handle_buffer();
 
       if (m_size == 0) {
         this->clear();
@@ -98,27 +142,39 @@ namespace fan {
       erase(size() - 1);
     }
 
-    void handle_buffer() {
-
-      if (m_size >= m_capacity) {
-        m_capacity = m_size + get_buffer_size();
-        ptr = (type_t*)resize_buffer(ptr, m_capacity * sizeof(type_t));
-      }
-      /*if (m_size <= m_capacity) {
-        m_capacity = m_size;
-        ptr = (type_t*)resize_buffer(ptr, m_capacity * sizeof(type_t));
-      }*/
-    }
-
+    // default constructs new elements, keeps capacity when shrinking
     void resize(uintptr_t size) {
-      ptr = (type_t*)resize_buffer(ptr, size * sizeof(type_t));
+      if (size > m_capacity) {
+        grow(size);
+      }
+      if (size > m_size) {
+        if constexpr (!std::is_trivially_default_constructible<type_t>::value) {
+          for (uintptr_t i = m_size; i < size; i++) {
+            new (ptr + i) type_t();
+          }
+        }
+      }
+      else {
+        destroy(ptr + size, ptr + m_size);
+      }
       m_size = size;
-      m_capacity = size;
     }
 
+    // never shrinks, capacity is exactly size if it grows
     void reserve(uintptr_t size) {
-      ptr = (type_t*)resize_buffer(ptr, size * sizeof(type_t));
-      m_capacity = size;
+      if (size > m_capacity) {
+        reallocate(size);
+      }
+    }
+
+    void shrink_to_fit() {
+      if (m_size == 0) {
+        this->close();
+        return;
+      }
+      if (m_capacity != m_size) {
+        reallocate(m_size);
+      }
     }
 
     type_t operator*() {
@@ -180,13 +236,86 @@ namespace fan {
       close();
     }
 
-    static constexpr uintptr_t buffer_increment = 0x10000;
+    // first allocation, in elements
+    static constexpr uintptr_t min_capacity = 16;
 
   protected:
 
+    // capacity grows 1.5x so n push_backs do O(log n) reallocations
+    // 1.5 instead of 2 lets realloc reuse freed blocks
+    void grow(uintptr_t required) {
+      uintptr_t capacity = m_capacity + m_capacity / 2;
+      if (capacity < min_capacity) {
+        capacity = min_capacity;
+      }
+      if (capacity < required) {
+        capacity = required;
+      }
+      reallocate(capacity);
+    }
+
+    void reallocate(uintptr_t capacity) {
+      if constexpr (relocatable) {
+        ptr = resize_buffer(ptr, capacity * sizeof(type_t));
+      }
+      else {
+        // realloc could move the elements behind their back
+        type_t* new_ptr = resize_buffer(0, capacity * sizeof(type_t));
+        for (uintptr_t i = 0; i < m_size; i++) {
+          new (new_ptr + i) type_t(std::move(ptr[i]));
+          ptr[i].~type_t();
+        }
+        free_buffer(ptr);
+        ptr = new_ptr;
+      }
+      m_capacity = capacity;
+    }
+
+    // shifts [i, m_size) right by n, capacity must already fit
+    // leaves [i, i + n) uninitialized
+    void open_gap(uintptr_t i, uintptr_t n) {
+      if constexpr (relocatable) {
+        std::memmove(ptr + i + n, ptr + i, (m_size - i) * sizeof(type_t));
+      }
+      else {
+        for (uintptr_t j = m_size; j-- > i; ) {
+          new (ptr + j + n) type_t(std::move(ptr[j]));
+          ptr[j].~type_t();
+        }
+      }
+    }
+
+    // moves count elements from src down to dst (dst < src), src range ends up uninitialized
+    static void relocate(type_t* dst, type_t* src, uintptr_t count) {
+      if constexpr (relocatable) {
+        std::memmove(dst, src, count * sizeof(type_t));
+      }
+      else {
+        for (uintptr_t j = 0; j < count; j++) {
+          new (dst + j) type_t(std::move(src[j]));
+          src[j].~type_t();
+        }
+      }
+    }
+
+    static void destroy(type_t* begin, type_t* end) {
+      if constexpr (!std::is_trivially_destructible<type_t>::value) {
+        for (; begin < end; begin++) {
+          begin->~type_t();
+        }
+      }
+    }
+
+    static void free_buffer(type_t* ptr) {
+      if (ptr) {
+        free(ptr);
+      }
+    }
+
     static type_t* resize_buffer(void* ptr, uintptr_t size) {
       if (ptr) {
         if (size) {
+          fan::count_allocation();
           type_t* rptr = (type_t*)realloc(ptr, size);
         #if fan_debug >= fan_debug_low
           if (rptr == 0) {
@@ -202,6 +331,7 @@ namespace fan {
       }
       else {
         if (size) {
+          fan::count_allocation();
           type_t* rptr = (type_t*)malloc(size);
         #if fan_debug >= fan_debug_low
           if (rptr == 0) {
@@ -216,14 +346,6 @@ namespace fan {
       }
     }
 
-    constexpr uintptr_t get_buffer_size() {
-      constexpr uintptr_t r = buffer_increment;
-      if (!r) {
-        return 1;
-      }
-      return r;
-    }
-
     uintptr_t m_size;
     uintptr_t m_capacity;
     type_t* ptr;
@@ -231,6 +353,128 @@ namespace fan {
 
 }
 
+namespace fan {
+
+  // bump allocator for data that lives at most until reset()
+  // reset() merges blocks into one big enough for the previous peak, so after warming up
+  // a frame that uses the same amount of memory as before does not touch the heap
+  struct arena_t {
+
+    static constexpr uintptr_t default_block_size = 0x10000;
+
+    void open(uintptr_t block_size = default_block_size) {
+      m_blocks.open();
+      m_block_size = block_size;
+      m_offset = 0;
+      m_used = 0;
+      m_peak = 0;
+    }
+    void close() {
+      for (uintptr_t i = 0; i < m_blocks.size(); i++) {
+        free(m_blocks[i].data);
+      }
+      m_blocks.close();
+    }
+
+    void* allocate(uintptr_t size, uintptr_t alignment = alignof(std::max_align_t)) {
+      if (!m_blocks.empty()) {
+        block_t& block = m_blocks[m_blocks.size() - 1];
+        uintptr_t offset = (m_offset + alignment - 1) & ~(alignment - 1);
+        if (offset + size <= block.size) {
+          m_used += offset + size - m_offset;
+          m_offset = offset + size;
+          return block.data + offset;
+        }
+      }
+
+      // overflow, chained until next reset
+      uintptr_t block_size = std::max(m_block_size, size + alignment);
+      block_t block;
+      fan::count_allocation();
+      block.data = (uint8_t*)malloc(block_size);
+    #if fan_debug >= fan_debug_low
+      if (block.data == 0) {
+        fan::throw_error("arena allocation failed - size:" + std::to_string(block_size));
+      }
+    #endif
+      block.size = block_size;
+      m_blocks.push_back(block);
+      m_offset = 0;
+      return allocate(size, alignment);
+    }
+
+    template <typename T>
+    T* allocate(uintptr_t count) {
+      return (T*)allocate(count * sizeof(T), alignof(T));
+    }
+
+    // invalidates everything allocated since previous reset, destructors are not called
+    void reset() {
+      m_peak = std::max(m_peak, m_used);
+      if (m_blocks.size() > 1) {
+        for (uintptr_t i = 0; i < m_blocks.size(); i++) {
+          free(m_blocks[i].data);
+        }
+        m_blocks.resize(0);
+        m_block_size = std::max(m_block_size, m_peak + m_peak / 2);
+      }
+      m_offset = 0;
+      m_used = 0;
+    }
+
+    // bytes handed out since reset, including alignment padding
+    uintptr_t used() const {
+      return m_used;
+    }
+
+    uintptr_t peak() const {
+      return std::max(m_peak, m_used);
+    }
+
+  protected:
+
+    struct block_t {
+      uint8_t* data;
+      uintptr_t size;
+    };
+
+    hector_t<block_t> m_blocks;
+    uintptr_t m_block_size;
+    uintptr_t m_offset;
+    uintptr_t m_used;
+    uintptr_t m_peak;
+  };
+
+  // lets std containers take their memory from an arena, deallocate is a no-op
+  template <typename T>
+  struct arena_allocator_t {
+
+    typedef T value_type;
+
+    arena_allocator_t(arena_t* arena) : m_arena(arena) {}
+
+    template <typename U>
+    arena_allocator_t(const arena_allocator_t<U>& other) : m_arena(other.m_arena) {}
+
+    T* allocate(std::size_t n) {
+      return m_arena->allocate<T>(n);
+    }
+    void deallocate(T*, std::size_t) {}
+
+    template <typename U>
+    bool operator==(const arena_allocator_t<U>& other) const {
+      return m_arena == other.m_arena;
+    }
+    template <typename U>
+    bool operator!=(const arena_allocator_t<U>& other) const {
+      return m_arena != other.m_arena;
+    }
+
+    arena_t* m_arena;
+  };
+
+}
+
 namespace fan {
 
 #ifndef A_set_buffer
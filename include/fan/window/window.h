@@ -19,6 +19,7 @@
 
 #include <fan/types/color.h>
 #include <fan/time/time.h>
+#include <fan/time/frame_pacer.h>
 #include <fan/window/window_input.h>
 
 #include <fan/bll.h>
@@ -140,6 +141,8 @@ namespace fan {
 
 		struct events {
 			static constexpr uint32_t close = 1 << 0;
+			// any os event was handled during last handle_events
+			static constexpr uint32_t input = 1 << 1;
 		};
 
 		struct resolutions {
@@ -249,6 +252,9 @@ namespace fan {
 		uintptr_t get_max_fps() const;
 		void set_max_fps(uintptr_t fps);
 
+		// frame time histogram & spin window of the max fps limiter
+		fan::time::frame_pacer_t& get_frame_pacer();
+
 		// use fan::window_t::resolutions for window sizes
 		void set_full_screen(const fan::vec2i& size = uninitialized);
 		void set_windowed_full_screen(const fan::vec2i& size = uninitialized);
@@ -351,6 +357,10 @@ namespace fan {
 
 		uint32_t handle_events();
 
+		// blocks until an event is available or timeout (nanoseconds) passes, returns false on timeout
+		// events are not handled, call handle_events after
+		bool wait_events(uint64_t timeout);
+
 		void* get_user_data() const;
 		void set_user_data(void* user_data);
 
@@ -437,7 +447,7 @@ namespace fan {
 
 		uintptr_t m_max_fps;
 
-		f64_t m_fps_next_tick;
+		fan::time::frame_pacer_t m_frame_pacer;
 		bool m_received_fps;
 		uintptr_t m_fps;
 		fan::time::clock m_fps_timer;
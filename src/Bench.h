@@ -0,0 +1,649 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fan/graphics/graphics.h>
+#include <fan/types/memory.h>
+#include <fan/time/time.h>
+#include <fan/io/log.h>
+
+#include "Broadcaster.h"
+#include "Grid.h"
+#include "Rasterizer.h"
+#include "Spectator.h"
+#include "UniverseReader.h"
+#include "UniverseRing.h"
+
+/// <summary>
+///
+/// Benchmarks & checks run instead of the game with CONGOL_BENCH=<name>, results go to the log
+/// Exit code is non zero if a check failed or the benchmark couldn't run
+///
+/// rectangles    vertex throughput of rectangle.vs vs rectangle_axis_aligned.vs, 1M rectangles drawn offscreen
+///               (LIBGL_ALWAYS_SOFTWARE=1 for llvmpipe, DISPLAY may point at Xvfb)
+/// hector        fan::hector_t against std::vector: push_back of ints & strings, byte ranges appended like glsl_buffer_t
+/// startup       cold start (empty program cache) against warm start (programs loaded from the cache),
+///               window to first frame of a 50x50 grid. Fails if the warm start compiles although binaries are supported
+/// grid          start up time of large grids up to 4096x4096 (Grid::init, bulk buffer build or density view, first frame) & the bulk build
+///               against one push_back per cell
+/// raster        check: Rasterizer RGBA & I420 output against a per pixel reference (scales, steps, gridlines,
+///               output larger than the grid), then Gpixels/s of an 8192x8192 frame. Runs headless
+/// spectate      Broadcaster to Spectator over loopback TCP, 1024x1024 universe with 2% of cells changing per generation:
+///               latency of one generation at a time, then bandwidth of generations published back to back. Runs headless
+/// shm           UniverseRing writer thread against a UniverseReader: frames & GB/s published, frames read, lapped & torn,
+///               publish to read latency. Fails if a copy that passed valid() isn't the published frame. Runs headless
+/// allocations   check: warmed up game frames (paused, ticking once the undo history is full, zoomed out LOD,
+///               profiler overlay) allocate nothing. Needs allocation counting (debug build or fan_count_allocations=1)
+///
+/// </summary>
+
+class Bench {
+public:
+	static int main(const std::string& name) {
+		if (name == "rectangles") return rectangles();
+		if (name == "hector") return hector();
+		if (name == "startup") return startup();
+		if (name == "grid") return grid();
+		if (name == "raster") return raster();
+		if (name == "spectate") return spectate();
+		if (name == "shm") return shm();
+		if (name == "allocations") return allocations();
+
+		fan_log_error("Unknown CONGOL_BENCH:", name);
+		return 1;
+	}
+
+private:
+	// Small window, frames are never swapped to it, only read back
+	static void open_context(fan::window_t& window, fan::opengl::context_t& context, const fan::vec2i& size) {
+		window.open(size, "ConGOL bench");
+		context.init();
+		context.bind_to_window(&window);
+		context.set_viewport(0, window.get_size());
+		context.set_vsync(&window, false);
+
+		const char* renderer = (const char*)context.opengl.glGetString(fan::opengl::GL_RENDERER);
+		fan_log_info("Renderer:", renderer ? renderer : "unknown");
+	}
+
+	// Reading back a pixel waits until everything queued before it is drawn
+	static void finish(fan::opengl::context_t& context) {
+		uint8_t pixel[4];
+		context.opengl.glReadPixels(0, 0, 1, 1, fan::opengl::GL_RGBA, fan::opengl::GL_UNSIGNED_BYTE, pixel);
+	}
+
+	// ns per frame of clear + uploads + draws
+	static uint64_t time_frames(fan::opengl::context_t& context, uint32_t frames) {
+		context.process(); // first frame uploads everything
+		finish(context);
+
+		uint64_t start = fan::time::clock::now();
+		for (uint32_t i = 0; i < frames; i++) {
+			context.process();
+			finish(context);
+		}
+		return (fan::time::clock::now() - start) / frames;
+	}
+
+	// Fastest of runs, ns
+	template <typename function_t>
+	static uint64_t best_of(uint32_t runs, function_t f) {
+		uint64_t best = -1;
+		for (uint32_t i = 0; i < runs; i++) {
+			uint64_t start = fan::time::clock::now();
+			f();
+			best = std::min(best, fan::time::clock::now() - start);
+		}
+		return best;
+	}
+
+	static void compare(const char* name, uint64_t hector, uint64_t vector) {
+		fan_log_info("hector_t", name, "ms:", hector / 1e6, "std::vector ms:", vector / 1e6, "ratio:", (double)hector / vector);
+	}
+
+	static int rectangles() {
+		constexpr uint32_t count = 1000000;
+		constexpr uint32_t frames = 20;
+
+		fan::window_t window;
+		fan::opengl::context_t context;
+		open_context(window, context, fan::vec2i(512, 512));
+
+		// pixel sized so the fragment stage is about the same for both & the vertex stage dominates
+		uint64_t times[2];
+		for (int rotation = 1; rotation >= 0; rotation--) {
+			fan_2d::opengl::rectangle_t::open_properties_t op;
+			op.rotation = rotation;
+			fan_2d::opengl::rectangle_t rects;
+			rects.open(&context, op);
+
+			std::mt19937 random(1);
+			std::uniform_real_distribution<f32_t> position(0, 512);
+			uint64_t start = fan::time::clock::now();
+			for (uint32_t i = 0; i < count; i++) {
+				fan_2d::opengl::rectangle_t::properties_t p;
+				p.position = fan::vec2(position(random), position(random));
+				p.size = 0.5;
+				p.color = fan::colors::white;
+				rects.push_back(&context, p);
+			}
+			uint64_t setup = fan::time::clock::now() - start;
+
+			rects.enable_draw(&context);
+			times[rotation] = time_frames(context, frames);
+			rects.close(&context);
+
+			fan_log_info(
+				"Rectangles:", count, rotation ? "rectangle.vs" : "rectangle_axis_aligned.vs",
+				"ms/frame:", times[rotation] / 1e6,
+				"Mvertices/s:", count * fan_2d::opengl::rectangle_t::vertex_count / (times[rotation] / 1e9) / 1e6,
+				"setup ms:", setup / 1e6
+			);
+		}
+		fan_log_info("Axis aligned speedup:", (double)times[1] / times[0]);
+		return 0;
+	}
+
+	static int hector() {
+		constexpr uint32_t count = 1 << 22;
+		constexpr uint32_t runs = 5;
+		bool ok = true;
+
+		uint64_t hector_time = best_of(runs, [&] {
+			fan::hector_t<uint32_t> h;
+			h.open();
+			for (uint32_t i = 0; i < count; i++) h.push_back(i);
+			ok = ok && h.size() == count && h[count - 1] == count - 1;
+			h.close();
+		});
+		uint64_t vector_time = best_of(runs, [&] {
+			std::vector<uint32_t> v;
+			for (uint32_t i = 0; i < count; i++) v.push_back(i);
+			ok = ok && v.size() == count && v[count - 1] == count - 1;
+		});
+		compare("push_back u32", hector_time, vector_time);
+
+		// one rectangle (6 vertices) at a time, as rectangle_t::push_back fills glsl_buffer_t::m_buffer
+		constexpr uint32_t chunk = fan_2d::opengl::rectangle_t::vertex_count * fan_2d::opengl::rectangle_t::element_byte_size;
+		constexpr uint32_t chunks = count / 16;
+		uint8_t bytes[chunk];
+		for (uint32_t i = 0; i < chunk; i++) bytes[i] = i;
+		hector_time = best_of(runs, [&] {
+			fan::hector_t<uint8_t> h;
+			h.open();
+			for (uint32_t i = 0; i < chunks; i++) h.insert(h.size(), bytes, bytes + chunk);
+			ok = ok && h.size() == (uint64_t)chunk * chunks && h[h.size() - 1] == bytes[chunk - 1];
+			h.close();
+		});
+		vector_time = best_of(runs, [&] {
+			std::vector<uint8_t> v;
+			for (uint32_t i = 0; i < chunks; i++) v.insert(v.end(), bytes, bytes + chunk);
+			ok = ok && v.size() == (uint64_t)chunk * chunks && v[v.size() - 1] == bytes[chunk - 1];
+		});
+		compare("append rectangles", hector_time, vector_time);
+
+		// not trivially relocatable, moved element by element when growing
+		constexpr uint32_t strings = count / 16;
+		hector_time = best_of(runs, [&] {
+			fan::hector_t<std::string> h;
+			h.open();
+			for (uint32_t i = 0; i < strings; i++) h.emplace_back(std::string(32, 'a' + i % 26));
+			ok = ok && h.size() == strings && h[strings - 1][0] == 'a' + (strings - 1) % 26;
+			h.close();
+		});
+		vector_time = best_of(runs, [&] {
+			std::vector<std::string> v;
+			for (uint32_t i = 0; i < strings; i++) v.emplace_back(std::string(32, 'a' + i % 26));
+			ok = ok && v.size() == strings && v[strings - 1][0] == 'a' + (strings - 1) % 26;
+		});
+		compare("emplace_back string", hector_time, vector_time);
+
+		if (!ok) fan_log_error("hector_t contents differ from what was pushed");
+		return ok ? 0 : 1;
+	}
+
+	static int startup() {
+		std::error_code ec;
+		std::filesystem::path directory = std::filesystem::temp_directory_path(ec) / "congol_bench_shaders";
+		std::filesystem::remove_all(directory, ec);
+	#ifdef fan_platform_unix
+		// mesa caches compiled shaders by itself, which would make every cold start after the first one warm
+		setenv("MESA_SHADER_CACHE_DISABLE", "true", 0);
+	#endif
+
+		bool ok = true;
+		uint64_t times[2];
+		for (int warm = 0; warm < 2; warm++) {
+			uint64_t start = fan::time::clock::now();
+
+			fan::window_t window;
+			fan::opengl::context_t context;
+			open_context(window, context, fan::vec2i(512, 512));
+			context.m_programs.set_directory(context.opengl, directory.string());
+			{
+				Grid grid(&window, &context, 50);
+				grid.draw();
+				context.process();
+				finish(context);
+			}
+			times[warm] = fan::time::clock::now() - start;
+
+			const auto& stats = context.m_programs.get_stats();
+			fan_log_info(
+				warm ? "Warm start" : "Cold start", "ms:", times[warm] / 1e6,
+				"programs compiled:", stats.compiled, "loaded:", stats.loaded, "shared:", stats.shared, "program ms:", stats.time / 1e6
+			);
+			if (warm && stats.compiled) {
+				if (context.opengl.has_program_binary) ok = false;
+				else fan_log_warning("Driver has no program binary formats, warm start compiles too");
+			}
+			window.close();
+		}
+		std::filesystem::remove_all(directory, ec);
+
+		fan_log_info("Warm start speedup:", (double)times[0] / times[1]);
+		if (!ok) fan_log_error("Warm start compiled programs instead of loading them");
+		return ok ? 0 : 1;
+	}
+
+	static int grid() {
+		// the grid buffer as Grid::open_graphics opens it, filled per cell (as before the bulk path) and in bulk
+		{
+			constexpr uint32_t subdivisions = 256;
+			constexpr uint32_t count = subdivisions * subdivisions;
+
+			fan::window_t window;
+			fan::opengl::context_t context;
+			open_context(window, context, fan::vec2i(512, 512));
+
+			uint64_t times[2];
+			for (int bulk = 0; bulk < 2; bulk++) {
+				fan_2d::graphics::rectangle_packed_axis_aligned_t::open_properties_t op;
+				op.buffer_mode = fan::opengl::core::glsl_buffer_t::mode::write_only;
+				fan_2d::graphics::rectangle_packed_axis_aligned_t rects;
+				rects.open(&context, op);
+
+				auto fill = [&](uint32_t i, fan_2d::graphics::rectangle_packed_axis_aligned_t::properties_t& p) {
+					p.position = fan::vec2(i % subdivisions + 0.5f, i / subdivisions + 0.5f) * 2;
+					p.size = 1;
+					p.color = fan::colors::black;
+				};
+				uint64_t start = fan::time::clock::now();
+				if (bulk) rects.push_back(&context, count, fill);
+				else for (uint32_t i = 0; i < count; i++) {
+					fan_2d::graphics::rectangle_packed_axis_aligned_t::properties_t p;
+					fill(i, p);
+					rects.push_back(&context, p);
+				}
+				context.process();
+				finish(context);
+				times[bulk] = fan::time::clock::now() - start;
+				rects.close(&context);
+
+				fan_log_info(bulk ? "Bulk build" : "Per cell build", "of", count, "cells ms:", times[bulk] / 1e6);
+			}
+			fan_log_info("Bulk build speedup:", (double)times[0] / times[1]);
+			window.close();
+		}
+
+		// whole start up, a fresh context each so the sizes don't share buffers
+		for (int subdivisions : { 256, 1024, 2048, 4096 }) {
+			fan::window_t window;
+			fan::opengl::context_t context;
+			open_context(window, context, fan::vec2i(512, 512));
+
+			uint64_t start = fan::time::clock::now();
+			Grid grid(&window, &context, subdivisions);
+			uint64_t init = fan::time::clock::now() - start;
+			grid.draw();
+			context.process();
+			finish(context);
+			uint64_t total = fan::time::clock::now() - start;
+
+			fan_log_info(
+				"Grid", subdivisions, "x", subdivisions, "start up ms:", total / 1e6,
+				"init ms:", init / 1e6, "first frame ms:", (total - init) / 1e6, grid.lod_active_ ? "(density view)" : "(cells)"
+			);
+			window.close();
+		}
+		return 0;
+	}
+
+	// what Rasterizer draws, one pixel at a time
+	static bool reference_alive(const Bitplane& bitplane, const Rasterizer::settings_t& settings, int px, int py) {
+		int cx = px / settings.scale * settings.step;
+		int cy = py / settings.scale * settings.step;
+		return cx < bitplane.width() && cy < bitplane.height() && bitplane.get(cx, cy);
+	}
+
+	static bool check_rgba(const Bitplane& bitplane, const Rasterizer::settings_t& settings, int width, int height) {
+		std::vector<uint32_t> pixels((size_t)width * height);
+		Rasterizer::rgba(bitplane, settings, pixels.data(), width, height, width);
+		const bool gridlines = settings.gridlines && settings.scale >= 3;
+		for (int py = 0; py < height; py++) {
+			for (int px = 0; px < width; px++) {
+				uint32_t expected = reference_alive(bitplane, settings, px, py) ? settings.alive : settings.dead;
+				if (gridlines && (px % settings.scale == 0 || py % settings.scale == 0)) expected = settings.gridline;
+				if (pixels[(size_t)py * width + px] != expected) {
+					fan_log_error("RGBA differs at", px, py, "scale:", settings.scale, "step:", settings.step, "gridlines:", gridlines, "size:", width, height);
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	static bool check_i420(const Bitplane& bitplane, const Rasterizer::settings_t& settings, int width, int height) {
+		std::vector<uint8_t> y((size_t)width * height), u((size_t)width * height / 4), v((size_t)width * height / 4);
+		uint8_t* const planes[3] = { y.data(), u.data(), v.data() };
+		const uint32_t stride[3] = { (uint32_t)width, (uint32_t)width / 2, (uint32_t)width / 2 };
+		Rasterizer::i420(bitplane, settings, planes, stride, width, height);
+
+		uint8_t alive[3], dead[3];
+		Rasterizer::to_yuv(settings.alive, alive);
+		Rasterizer::to_yuv(settings.dead, dead);
+		for (int py = 0; py < height; py++) {
+			for (int px = 0; px < width; px++) {
+				uint8_t expected = reference_alive(bitplane, settings, px, py) ? alive[0] : dead[0];
+				if (y[(size_t)py * width + px] != expected) {
+					fan_log_error("I420 luma differs at", px, py, "scale:", settings.scale, "step:", settings.step, "size:", width, height);
+					return false;
+				}
+			}
+		}
+		for (int qy = 0; qy < height / 2; qy++) {
+			for (int qx = 0; qx < width / 2; qx++) {
+				int n = 0;
+				for (int i = 0; i < 4; i++) n += reference_alive(bitplane, settings, qx * 2 + i % 2, qy * 2 + i / 2);
+				size_t at = (size_t)qy * width / 2 + qx;
+				if (u[at] != (dead[1] * (4 - n) + alive[1] * n + 2) / 4 || v[at] != (dead[2] * (4 - n) + alive[2] * n + 2) / 4) {
+					fan_log_error("I420 chroma differs at", qx, qy, "scale:", settings.scale, "step:", settings.step, "size:", width, height);
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	static int raster() {
+		// odd sizes so rows end mid word, output both smaller & larger than the scaled grid
+		std::mt19937 random(1);
+		Bitplane bitplane;
+		bitplane.resize(203, 131);
+		for (int y = 0; y < bitplane.height(); y++) {
+			for (int x = 0; x < bitplane.width(); x++) bitplane.set(x, y, random() % 3 == 0);
+		}
+
+		Rasterizer::settings_t settings;
+		settings.alive = 0xff20c0f0;
+		settings.dead = 0xff101010;
+		bool ok = true;
+		uint32_t checks = 0;
+		for (int scale = 1; scale <= 7 && ok; scale++) {
+			for (int step : { 1, 3 }) {
+				for (bool gridlines : { false, true }) {
+					settings.scale = scale;
+					settings.step = step;
+					settings.gridlines = gridlines;
+					for (fan::vec2i size : { fan::vec2i(128, 96), fan::vec2i(1600, 1000) }) {
+						ok = ok && check_rgba(bitplane, settings, size.x, size.y);
+						ok = ok && check_i420(bitplane, settings, size.x, size.y);
+						checks += 2;
+					}
+				}
+			}
+		}
+		if (!ok) return 1;
+		fan_log_info("Rasterizer frames matching the reference:", checks);
+
+		// throughput, scale 1 like a grid exported at one pixel per cell
+		constexpr int side = 8192;
+		bitplane.resize(side, side);
+		for (int y = 0; y < side; y++) {
+			for (int w = 0; w < bitplane.words_per_row(); w++) bitplane.row(y)[w] = ((uint64_t)random() << 32) | random();
+		}
+		settings = Rasterizer::settings_t();
+		std::vector<uint32_t> pixels((size_t)side * side);
+		std::vector<uint8_t> yuv((size_t)side * side * 3 / 2);
+		uint8_t* const planes[3] = { yuv.data(), yuv.data() + (size_t)side * side, yuv.data() + (size_t)side * side * 5 / 4 };
+		const uint32_t stride[3] = { side, side / 2, side / 2 };
+
+		uint64_t rgba = best_of(5, [&] { Rasterizer::rgba(bitplane, settings, pixels.data(), side, side, side); });
+		uint64_t i420 = best_of(5, [&] { Rasterizer::i420(bitplane, settings, planes, stride, side, side); });
+		fan_log_info("Rasterizer", side, "x", side, "RGBA Gpixels/s:", (double)side * side / rgba, "I420 Gpixels/s:", (double)side * side / i420);
+		return 0;
+	}
+
+	static int spectate() {
+		constexpr int side = 1024;
+		constexpr uint32_t generations = 200;
+		constexpr uint64_t timeout = 5000000000;
+
+		Broadcaster broadcaster;
+		broadcaster.start(0, "127.0.0.1");
+		Spectator spectator;
+		spectator.connect("127.0.0.1", broadcaster.port());
+
+		uint64_t start = fan::time::clock::now();
+		while (broadcaster.stats().spectators == 0) {
+			if (fan::time::clock::now() - start > timeout) {
+				fan_log_error("Spectator didn't connect");
+				return 1;
+			}
+			std::this_thread::yield();
+		}
+
+		std::mt19937 random(1);
+		Bitplane universe;
+		universe.resize(side, side);
+		for (int y = 0; y < side; y++) {
+			for (int w = 0; w < universe.words_per_row(); w++) universe.row(y)[w] = (uint64_t)random() << 32 | random();
+		}
+		auto mutate = [&] {
+			for (int i = 0; i < side * side / 50; i++) {
+				int x = random() % side, y = random() % side;
+				universe.set(x, y, !universe.get(x, y));
+			}
+		};
+
+		Bitplane received;
+		uint64_t generation = 0;
+		auto wait_for = [&](uint64_t wanted) {
+			uint64_t start = fan::time::clock::now();
+			while (generation < wanted) {
+				if (fan::time::clock::now() - start > timeout) return false;
+				if (!spectator.poll(received, generation)) std::this_thread::yield();
+			}
+			return true;
+		};
+
+		// one generation in flight, like a spectator of a slowly ticking game
+		for (uint32_t g = 1; g <= generations; g++) {
+			mutate();
+			broadcaster.publish(universe, g);
+			if (!wait_for(g)) {
+				fan_log_error("Generation", g, "didn't arrive");
+				return 1;
+			}
+		}
+		Spectator::stats_t latency = spectator.stats();
+		fan_log_info(
+			"Latency ms avg:", latency.latency / std::max<uint64_t>(latency.keyframes + latency.deltas, 1) / 1e6,
+			"max:", latency.latency_max / 1e6, "KiB per generation:", latency.bytes / 1024.0 / generations
+		);
+
+		// back to back, spectator falls behind & gets keyframes instead of deltas
+		start = fan::time::clock::now();
+		for (uint32_t g = generations + 1; g <= generations * 2; g++) {
+			mutate();
+			broadcaster.publish(universe, g);
+		}
+		if (!wait_for(generations * 2)) {
+			fan_log_error("Last generation didn't arrive");
+			return 1;
+		}
+		f64_t seconds = (fan::time::clock::now() - start) / 1e9;
+		Spectator::stats_t bandwidth = spectator.stats();
+		Broadcaster::stats_t sent = broadcaster.stats();
+		fan_log_info(
+			"Bandwidth MiB/s:", (bandwidth.bytes - latency.bytes) / seconds / (1 << 20), "generations/s:", generations / seconds,
+			"deltas skipped:", sent.skipped, "keyframes:", sent.keyframes
+		);
+
+		bool ok = std::equal(universe.row(0), universe.row(0) + (size_t)universe.words_per_row() * side, received.row(0));
+		if (!ok) fan_log_error("Spectated universe differs from the published one");
+		spectator.close();
+		broadcaster.stop();
+		return ok ? 0 : 1;
+	}
+
+	static int shm() {
+		constexpr int side = 1024;
+		constexpr uint32_t frames = 5000;
+		const std::string name = "congol_bench";
+
+		// every frame's first word is its generation, the rest a pattern derived from it, so a copy can be checked alone
+		Bitplane universe;
+		universe.resize(side, side);
+		auto fill = [&](uint64_t generation) {
+			uint64_t* words = universe.row(0);
+			const size_t count = (size_t)universe.words_per_row() * side;
+			words[0] = generation;
+			for (size_t i = 1; i < count; i++) words[i] = generation * 0x9e3779b97f4a7c15ull + i;
+		};
+
+		UniverseRing ring;
+		ring.open(name, side, side);
+		fill(0);
+		ring.publish(universe, 0);
+
+		UniverseReader reader;
+		if (!reader.open(name)) {
+			fan_log_error("Failed to open the ring as reader");
+			return 1;
+		}
+
+		std::atomic<bool> done = false;
+		uint64_t publish_time = 0;
+		std::thread writer([&] {
+			fan::time::get_trace().set_thread_name("shm writer");
+			uint64_t start = fan::time::clock::now();
+			for (uint64_t g = 1; g <= frames; g++) {
+				fill(g);
+				ring.publish(universe, g);
+			}
+			publish_time = fan::time::clock::now() - start;
+			done = true;
+		});
+
+		UniverseReader::frame_t frame;
+		std::vector<uint64_t> words;
+		uint64_t read = 0, torn = 0, wrong = 0, latency = 0, latency_max = 0;
+		uint64_t last = 0;
+		while (true) {
+			// read before next(), nothing can be published after a next() that failed once the writer is done
+			bool finished = done;
+			if (!reader.next(frame)) {
+				if (finished) break;
+				std::this_thread::yield();
+				continue;
+			}
+			uint64_t now = fan::time::clock::now();
+			if (!reader.copy(frame, words)) {
+				torn++;
+				continue;
+			}
+			read++;
+			last = frame.generation;
+			uint64_t l = now - std::min(frame.time, now);
+			latency += l;
+			latency_max = std::max(latency_max, l);
+
+			uint64_t population = 0;
+			bool same = words[0] == frame.generation;
+			for (size_t i = 1; i < words.size() && same; i++) same = words[i] == frame.generation * 0x9e3779b97f4a7c15ull + i;
+			for (uint64_t w : words) population += std::popcount(w);
+			if (!same || population != frame.population) wrong++;
+		}
+		writer.join();
+
+		const f64_t seconds = publish_time / 1e9;
+		const f64_t bytes = (f64_t)universe.words_per_row() * side * sizeof(uint64_t);
+		fan_log_info("Published frames/s:", frames / seconds, "GB/s:", frames * bytes / seconds / 1e9, "frame KiB:", bytes / 1024);
+		fan_log_info(
+			"Read:", read, "lapped:", reader.missed(), "torn:", torn,
+			"latency ms avg:", latency / std::max<uint64_t>(read, 1) / 1e6, "max:", latency_max / 1e6
+		);
+
+		bool ok = wrong == 0 && read && last == frames;
+		if (wrong) fan_log_error("Frames that passed valid() but differ from what was published:", wrong);
+		if (last != frames) fan_log_error("Reader never saw the last generation, last read:", last);
+		reader.close();
+		ring.close();
+		return ok ? 0 : 1;
+	}
+
+	static int allocations() {
+	#if !fan_count_allocations
+		fan_log_error("Allocation counting is compiled out, build without NDEBUG or with fan_count_allocations=1");
+		return 1;
+	#else
+		constexpr uint32_t warmup = 10;
+		constexpr uint32_t frames = 100;
+
+		fan::window_t window;
+		fan::opengl::context_t context;
+		open_context(window, context, fan::vec2i(512, 512));
+
+		Grid grid(&window, &context, 50);
+		grid.show_profiler = true;
+		std::mt19937 random(1);
+		for (auto& cell : grid.cells_) cell.alive = random() % 4 == 0;
+
+		// the parts of Grid::run that every drawn frame goes through
+		auto frame = [&] {
+			window.handle_events();
+			grid.draw();
+			grid.update_profiler_hud();
+			context.process();
+			context.render(&window);
+		};
+		auto count = [&](const char* name, auto f) {
+			for (uint32_t i = 0; i < warmup; i++) f();
+			uint64_t start = fan::allocation_count();
+			for (uint32_t i = 0; i < frames; i++) f();
+			uint64_t allocations = fan::allocation_count() - start;
+			fan_log_info("Allocations", name, "per frame:", (double)allocations / frames);
+			return allocations;
+		};
+
+		bool ok = count("paused", frame) == 0;
+
+		// undo history allocates until its ring is full, then overwrites the oldest in place
+		uint64_t start = fan::allocation_count();
+		uint32_t generations = 0;
+		for (size_t size = (size_t)-1; grid.history_.size() != size; generations++) {
+			size = grid.history_.size();
+			grid.evolve();
+			frame();
+		}
+		fan_log_info("Generations until the undo history was full:", generations, "allocations:", fan::allocation_count() - start);
+		ok = count("ticking", [&] { grid.evolve(); frame(); }) == 0 && ok;
+
+		grid.zoom_at(0, 1.f / 16);
+		ok = count("zoomed out", frame) == 0 && ok;
+
+		if (!ok) fan_log_error("Steady state frames allocate");
+		return ok ? 0 : 1;
+	#endif
+	}
+};
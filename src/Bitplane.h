@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+	#include <emmintrin.h>
+#endif
+
+/// <summary>
+///
+/// One bit per cell, rows packed into 64 bit words (bit 0 = leftmost cell of the word)
+/// Used to aggregate cell blocks into densities when zoomed out far enough that a cell is smaller than a pixel
+///
+/// </summary>
+
+class Bitplane {
+public:
+	Bitplane() {}
+
+	void resize(int width, int height) {
+		width_ = width;
+		height_ = height;
+		words_per_row_ = (width + 63) / 64;
+		bits_.assign((size_t)words_per_row_ * height, 0);
+	}
+
+	void clear() {
+		std::fill(bits_.begin(), bits_.end(), 0);
+	}
+
+	void set(int x, int y, bool alive) {
+		uint64_t& word = bits_[(size_t)y * words_per_row_ + x / 64];
+		uint64_t mask = (uint64_t)1 << (x % 64);
+		if (alive) word |= mask;
+		else word &= ~mask;
+	}
+
+	bool get(int x, int y) const {
+		return (bits_[(size_t)y * words_per_row_ + x / 64] >> (x % 64)) & 1;
+	}
+
+	const uint64_t* row(int y) const {
+		return &bits_[(size_t)y * words_per_row_];
+	}
+
+	uint64_t* row(int y) {
+		return &bits_[(size_t)y * words_per_row_];
+	}
+
+	// Packs one row from 8 bit samples, cell x is alive when values[x] >= threshold (< threshold if invert)
+	// width_ samples are read, bits past the width stay 0. Rows are independent, safe to call from several threads
+	void pack_row(int y, const uint8_t* values, uint8_t threshold, bool invert = false) {
+		uint64_t* words = row(y);
+		const uint64_t flip = invert ? ~(uint64_t)0 : 0;
+		const int full_words = width_ / 64;
+
+		for (int w = 0; w < full_words; w++) {
+			words[w] = pack64(values + w * 64, threshold) ^ flip;
+		}
+		int rest = width_ - full_words * 64;
+		if (rest) {
+			uint64_t word = 0;
+			for (int i = 0; i < rest; i++) {
+				word |= (uint64_t)(values[full_words * 64 + i] >= threshold) << i;
+			}
+			words[full_words] = (word ^ flip) & (((uint64_t)1 << rest) - 1);
+		}
+	}
+
+	int width() const { return width_; }
+	int height() const { return height_; }
+	int words_per_row() const { return words_per_row_; }
+
+	// Writes live cell density (0-255) of every block x block square of cells, starting from cell (x0, y0)
+	// for columns x0 .. x0 + out_width * block and rows y0 .. y0 + out_height * block
+	// block must be a power of two, x0 must be a multiple of 64 and of block
+	// out is out_width * out_height bytes, row major
+	void density(int x0, int y0, int block, int out_width, int out_height, uint8_t* out) const {
+		sums_.assign(out_width, 0);
+
+		const uint32_t max = block * block;
+
+		for (int by = 0; by < out_height; by++) {
+			std::fill(sums_.begin(), sums_.end(), 0);
+
+			for (int r = 0; r < block; r++) {
+				int y = y0 + by * block + r;
+				if (y >= height_) break;
+				accumulate_row(row(y), x0, block, out_width, sums_.data());
+			}
+
+			uint8_t* dst = out + (size_t)by * out_width;
+			for (int bx = 0; bx < out_width; bx++) {
+				dst[bx] = (uint8_t)((sums_[bx] * 255 + max / 2) / max);
+			}
+		}
+	}
+
+private:
+
+	// bit i = values[i] >= threshold, for 64 samples
+	// unsigned >= is max(v, t) == v, SSE2/AVX2 only have signed byte compares
+	static uint64_t pack64(const uint8_t* values, uint8_t threshold) {
+	#if defined(__AVX2__)
+		const __m256i t = _mm256_set1_epi8((char)threshold);
+		__m256i a = _mm256_loadu_si256((const __m256i*)values);
+		__m256i b = _mm256_loadu_si256((const __m256i*)(values + 32));
+		uint32_t lo = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(a, t), a));
+		uint32_t hi = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(b, t), b));
+		return lo | (uint64_t)hi << 32;
+	#elif defined(__SSE2__) || defined(_M_X64)
+		const __m128i t = _mm_set1_epi8((char)threshold);
+		uint64_t word = 0;
+		for (int i = 0; i < 4; i++) {
+			__m128i v = _mm_loadu_si128((const __m128i*)(values + i * 16));
+			word |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, t), v)) << (i * 16);
+		}
+		return word;
+	#else
+		uint64_t word = 0;
+		for (int i = 0; i < 64; i++) {
+			word |= (uint64_t)(values[i] >= threshold) << i;
+		}
+		return word;
+	#endif
+	}
+
+	// Counts bits of each field of width 'block' in place (block = 2, 4, ... 32)
+	// classic SWAR popcount stopped at the wanted field width
+	static uint64_t field_popcount(uint64_t x, int block) {
+		x = x - ((x >> 1) & 0x5555555555555555ull);
+		if (block == 2) return x;
+		x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+		if (block == 4) return x;
+		x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+		if (block == 8) return x;
+		x = (x + (x >> 8)) & 0x00ff00ff00ff00ffull;
+		if (block == 16) return x;
+		return (x + (x >> 16)) & 0x0000ffff0000ffffull;
+	}
+
+#if defined(__AVX2__)
+	// same as field_popcount for four words at once
+	static __m256i field_popcount4(__m256i x, int block) {
+		const __m256i m1 = _mm256_set1_epi64x(0x5555555555555555ll);
+		const __m256i m2 = _mm256_set1_epi64x(0x3333333333333333ll);
+		const __m256i m4 = _mm256_set1_epi64x(0x0f0f0f0f0f0f0f0fll);
+		const __m256i m8 = _mm256_set1_epi64x(0x00ff00ff00ff00ffll);
+		const __m256i m16 = _mm256_set1_epi64x(0x0000ffff0000ffffll);
+
+		x = _mm256_sub_epi64(x, _mm256_and_si256(_mm256_srli_epi64(x, 1), m1));
+		if (block == 2) return x;
+		x = _mm256_add_epi64(_mm256_and_si256(x, m2), _mm256_and_si256(_mm256_srli_epi64(x, 2), m2));
+		if (block == 4) return x;
+		x = _mm256_and_si256(_mm256_add_epi64(x, _mm256_srli_epi64(x, 4)), m4);
+		if (block == 8) return x;
+		x = _mm256_and_si256(_mm256_add_epi64(x, _mm256_srli_epi64(x, 8)), m8);
+		if (block == 16) return x;
+		// block == 32, wider blocks go through whole word popcount
+		return _mm256_and_si256(_mm256_add_epi64(x, _mm256_srli_epi64(x, 16)), m16);
+	}
+#endif
+
+	void accumulate_row(const uint64_t* words, int x0, int block, int out_width, uint32_t* sums) const {
+		const int first_word = x0 / 64;
+
+		if (block >= 64) {
+			// whole words per block
+			const int words_per_block = block / 64;
+			for (int bx = 0; bx < out_width; bx++) {
+				int w = first_word + bx * words_per_block;
+				uint32_t count = 0;
+				for (int i = 0; i < words_per_block && w + i < words_per_row_; i++) {
+					count += std::popcount(words[w + i]);
+				}
+				sums[bx] += count;
+			}
+			return;
+		}
+
+		const int fields_per_word = 64 / block;
+		const uint64_t field_mask = ((uint64_t)1 << block) - 1;
+		const int word_count = std::min((out_width + fields_per_word - 1) / fields_per_word, words_per_row_ - first_word);
+
+		int w = 0;
+	#if defined(__AVX2__)
+		alignas(32) uint64_t counted[4];
+		for (; w + 4 <= word_count; w += 4) {
+			__m256i v = _mm256_loadu_si256((const __m256i*)(words + first_word + w));
+			_mm256_store_si256((__m256i*)counted, field_popcount4(v, block));
+			for (int i = 0; i < 4; i++) {
+				spread(counted[i], (w + i) * fields_per_word, fields_per_word, block, field_mask, out_width, sums);
+			}
+		}
+	#endif
+		for (; w < word_count; w++) {
+			spread(field_popcount(words[first_word + w], block), w * fields_per_word, fields_per_word, block, field_mask, out_width, sums);
+		}
+	}
+
+	// adds per field counts of one word to the block sums
+	static void spread(uint64_t counted, int first_block, int fields_per_word, int block, uint64_t field_mask, int out_width, uint32_t* sums) {
+		int n = std::min(fields_per_word, out_width - first_block);
+		for (int f = 0; f < n; f++) {
+			sums[first_block + f] += (uint32_t)((counted >> (f * block)) & field_mask);
+		}
+	}
+
+	int width_ = 0;
+	int height_ = 0;
+	int words_per_row_ = 0;
+	std::vector<uint64_t> bits_;
+
+	// scratch, per block column
+	mutable std::vector<uint32_t> sums_;
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fan/network/stream.h>
+#include <fan/time/time.h>
+#include <fan/io/log.h>
+
+#include "Bitplane.h"
+#include "Delta.h"
+
+/// <summary>
+///
+/// Serves the universe to spectators over TCP (see Delta.h for the format)
+/// A joining spectator gets a keyframe, then one delta per published change
+/// Spectators whose socket is more than max_queued bytes behind are skipped, and get a keyframe once they've caught up
+/// Sends run on the network thread, publish() only encodes once for everyone
+///
+/// </summary>
+
+class Broadcaster {
+public:
+	// Unsent bytes after which a spectator stops receiving deltas
+	static constexpr uint64_t max_queued = 1 << 20;
+
+	struct stats_t {
+		uint32_t spectators = 0;
+		uint64_t published = 0;  // deltas encoded
+		uint64_t keyframes = 0;  // keyframes sent
+		uint64_t skipped = 0;    // deltas not sent to a spectator that was behind
+		uint64_t bytes = 0;      // sent to all spectators
+	};
+
+	Broadcaster() {}
+	~Broadcaster() { stop(); }
+
+	// port 0 picks a free port, see port()
+	void start(uint16_t port, const std::string& address = "0.0.0.0") {
+		stop();
+		fan::network::server_t::callbacks_t callbacks;
+		callbacks.connect = on_connect;
+		callbacks.receive = on_receive;
+		callbacks.disconnect = on_disconnect;
+		callbacks.userptr = this;
+		server_.open_tcp(address, port, callbacks);
+	}
+
+	void stop() {
+		server_.close();
+		std::lock_guard<std::mutex> lock(mutex_);
+		spectators_.clear();
+	}
+
+	bool serving() const {
+		return server_.is_open();
+	}
+
+	uint16_t port() const {
+		return server_.get_port();
+	}
+
+	// Call whenever the universe may have changed, nothing is sent if it didn't
+	void publish(const Bitplane& bitplane, uint64_t generation) {
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		const bool resized = bitplane.width() != last_.width() || bitplane.height() != last_.height();
+		const size_t words = (size_t)bitplane.words_per_row() * bitplane.height();
+		const uint64_t time = fan::time::clock::now();
+
+		fan::network::buffer_t delta;
+		bool changed = resized;
+		if (!resized && words) {
+			std::string message;
+			size_t begin = fan::network::framer_t::begin_message(message);
+			Delta::write_header(message, { Delta::delta, sequence_ + 1, generation, time, 0, 0 }); // deltas carry no size
+			if (Delta::encode(message, bitplane.row(0), last_.row(0), words)) {
+				fan::network::framer_t::end_message(message, begin);
+				delta = fan::network::make_buffer(std::move(message));
+				stats_.published++;
+				changed = true;
+			}
+		}
+
+		if (changed) {
+			sequence_++;
+			generation_ = generation;
+			time_ = time;
+			last_ = bitplane;
+			keyframe_.reset(); // built for the first spectator that needs it
+		}
+
+		for (auto& spectator : spectators_) {
+			// unchanged, only spectators that were skipped earlier may need something
+			if (!changed && !spectator.second.needs_keyframe) continue;
+			if (server_.queued_bytes(spectator.first) > max_queued) {
+				if (changed) stats_.skipped++;
+				spectator.second.needs_keyframe = true;
+				continue;
+			}
+			if (delta && !spectator.second.needs_keyframe) {
+				send(spectator.first, delta);
+				continue;
+			}
+			if (sequence_) send_keyframe(spectator.first, spectator.second);
+		}
+	}
+
+	stats_t stats() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		stats_t stats = stats_;
+		stats.spectators = spectators_.size();
+		return stats;
+	}
+
+private:
+	struct spectator_t {
+		fan::network::framer_t framer;
+		bool needs_keyframe = true;
+	};
+
+	// mutex_ held
+	void send(fan::network::server_t::client_id_t id, const fan::network::buffer_t& buffer) {
+		server_.send(id, buffer);
+		stats_.bytes += buffer->size();
+	}
+
+	void send_keyframe(fan::network::server_t::client_id_t id, spectator_t& spectator) {
+		if (!keyframe_) {
+			std::string message;
+			size_t begin = fan::network::framer_t::begin_message(message);
+			Delta::write_header(message, { Delta::keyframe, sequence_, generation_, time_, (uint32_t)last_.width(), (uint32_t)last_.height() });
+			const size_t words = (size_t)last_.words_per_row() * last_.height();
+			if (words == 0 || !Delta::encode(message, last_.row(0), nullptr, words)) {
+				message.push_back((char)Delta::runs); // empty universe, no runs
+			}
+			fan::network::framer_t::end_message(message, begin);
+			keyframe_ = fan::network::make_buffer(std::move(message));
+		}
+		send(id, keyframe_);
+		spectator.needs_keyframe = false;
+		stats_.keyframes++;
+	}
+
+	// network thread
+	static void on_connect(fan::network::server_t*, fan::network::server_t::client_id_t id, void* userptr) {
+		Broadcaster* broadcaster = (Broadcaster*)userptr;
+		std::lock_guard<std::mutex> lock(broadcaster->mutex_);
+		spectator_t& spectator = broadcaster->spectators_[id];
+		// nothing published yet, first publish() sends the keyframe
+		if (broadcaster->sequence_) broadcaster->send_keyframe(id, spectator);
+	}
+
+	static void on_receive(fan::network::server_t* server, fan::network::server_t::client_id_t id, const char* data, size_t size, void* userptr) {
+		Broadcaster* broadcaster = (Broadcaster*)userptr;
+		std::lock_guard<std::mutex> lock(broadcaster->mutex_);
+		auto found = broadcaster->spectators_.find(id);
+		if (found == broadcaster->spectators_.end()) return;
+
+		bool valid = found->second.framer.feed(data, size, [&](const char* message, size_t length) {
+			if (length == 1 && message[0] == (char)Delta::request_keyframe && broadcaster->sequence_) {
+				broadcaster->send_keyframe(id, found->second);
+			}
+		});
+		if (!valid) server->disconnect(id);
+	}
+
+	static void on_disconnect(fan::network::server_t*, fan::network::server_t::client_id_t id, void* userptr) {
+		Broadcaster* broadcaster = (Broadcaster*)userptr;
+		std::lock_guard<std::mutex> lock(broadcaster->mutex_);
+		broadcaster->spectators_.erase(id);
+	}
+
+	fan::network::server_t server_;
+
+	std::mutex mutex_;
+	std::unordered_map<fan::network::server_t::client_id_t, spectator_t> spectators_;
+	Bitplane last_;   // last published universe, deltas are against it
+	uint64_t sequence_ = 0;
+	uint64_t generation_ = 0;
+	uint64_t time_ = 0;
+	fan::network::buffer_t keyframe_;
+	stats_t stats_;
+};
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fan/types/types.h>
+#include <fan/io/shared_memory.h>
+#include <fan/time/time.h>
+#include <fan/io/log.h>
+
+#if defined(fan_platform_unix)
+	#include <sys/wait.h>
+	#include <unistd.h>
+#endif
+
+#include "Domain.h"
+#include "Transport.h"
+
+/// <summary>
+///
+/// Headless domain decomposed runs: the universe is split into rectangles (Domain), one worker process each
+/// Locally the launcher forks the workers, they exchange halos over shared memory (or TCP on loopback) and report through
+/// a control segment. On several machines every worker is started by hand with its rank & the hosts, halos go over TCP
+/// The soup only depends on the seed & cell coordinates, so every worker count must end with the same population & checksum
+///
+/// CONGOL_DOMAINS=<workers>|bench              local run, or 1 .. 16 workers one after another
+/// CONGOL_DOMAIN_WORKER=<rank>                  one worker of a multi machine run, needs CONGOL_DOMAIN_COUNT & CONGOL_DOMAIN_HOSTS
+/// CONGOL_DOMAIN_COUNT=<workers>
+/// CONGOL_DOMAIN_HOSTS=<host0>,<host1>,...      where rank i listens (port + i), the last host repeats
+/// CONGOL_DOMAIN_SIZE=<width>x<height>          universe, 4096x4096
+/// CONGOL_DOMAIN_GENERATIONS=<n>                1000
+/// CONGOL_DOMAIN_TRANSPORT=shm|tcp              shm, local runs only
+/// CONGOL_DOMAIN_PORT=<port>                    7700
+/// CONGOL_DOMAIN_SEED=<n>                       1
+///
+/// </summary>
+
+class Cluster {
+public:
+	struct settings_t {
+		int width = 4096;
+		int height = 4096;
+		int workers = 1;
+		uint64_t generations = 1000;
+		uint64_t seed = 1;
+		bool tcp = false;
+		uint16_t port = 7700;
+		std::vector<std::string> hosts = { "127.0.0.1" };
+	};
+
+	struct result_t {
+		uint64_t elapsed = 0;     // ns, slowest worker
+		uint64_t waited = 0;      // ns blocked on halos, all workers
+		uint64_t population = 0;
+		uint64_t checksum = 0;
+		bool ok = false;
+		char error[160] = {};     // why the worker stopped, written by forked workers that can't log
+	};
+
+	// Runs whatever the environment asks for, returns the process exit code
+	static int main() {
+		settings_t settings = from_env();
+
+		if (const char* rank = std::getenv("CONGOL_DOMAIN_WORKER")) {
+			settings.tcp = true;
+			result_t result;
+			if (!work(settings, std::atoi(rank), nullptr, result)) {
+				fan_log_error(result.error);
+				return 1;
+			}
+			fan_log_info("Domain", rank, "of", settings.workers, "generations/s:", settings.generations / (result.elapsed / 1e9),
+				"halo wait %:", 100.0 * result.waited / std::max<uint64_t>(result.elapsed, 1), "population:", result.population, "checksum:", result.checksum);
+			return 0;
+		}
+
+		std::string workers = std::getenv("CONGOL_DOMAINS");
+		if (workers != "bench") {
+			settings.workers = std::max(std::atoi(workers.c_str()), 1);
+			result_t result;
+			if (!run(settings, result)) return 1;
+			report(settings, result, result);
+			return 0;
+		}
+
+		result_t single;
+		for (int count : { 1, 2, 4, 8, 16 }) {
+			settings.workers = count;
+			result_t result;
+			if (!run(settings, result)) return 1;
+			if (count == 1) single = result;
+			report(settings, result, single);
+			if (result.population != single.population || result.checksum != single.checksum) {
+				fan_log_error("Domains disagree with the single worker run at", count, "workers");
+				return 1;
+			}
+		}
+		return 0;
+	}
+
+	static settings_t from_env() {
+		settings_t settings;
+		if (const char* size = std::getenv("CONGOL_DOMAIN_SIZE")) {
+			int width = 0, height = 0;
+			if (std::sscanf(size, "%dx%d", &width, &height) == 2 && width > 0 && height > 0) {
+				settings.width = width;
+				settings.height = height;
+			}
+		}
+		if (const char* generations = std::getenv("CONGOL_DOMAIN_GENERATIONS")) settings.generations = std::strtoull(generations, nullptr, 10);
+		if (const char* seed = std::getenv("CONGOL_DOMAIN_SEED")) settings.seed = std::strtoull(seed, nullptr, 10);
+		if (const char* transport = std::getenv("CONGOL_DOMAIN_TRANSPORT")) settings.tcp = std::string(transport) == "tcp";
+		if (const char* port = std::getenv("CONGOL_DOMAIN_PORT")) settings.port = std::atoi(port);
+		if (const char* count = std::getenv("CONGOL_DOMAIN_COUNT")) settings.workers = std::max(std::atoi(count), 1);
+		if (const char* hosts = std::getenv("CONGOL_DOMAIN_HOSTS")) {
+			settings.hosts.clear();
+			std::stringstream list(hosts);
+			for (std::string host; std::getline(list, host, ',');) {
+				if (!host.empty()) settings.hosts.push_back(host);
+			}
+			if (settings.hosts.empty()) settings.hosts.push_back("127.0.0.1");
+		}
+		return settings;
+	}
+
+	// All workers as local processes, result of the whole universe
+	static bool run(const settings_t& settings, result_t& total) {
+	#if defined(fan_platform_unix)
+		const Domain::layout_t layout = Domain::partition(settings.width, settings.height, settings.workers);
+		if (layout.count() != settings.workers) {
+			fan_log_error("Universe too small for", settings.workers, "domains");
+			return false;
+		}
+
+		const std::string suffix = std::to_string(getpid());
+		fan::io::shared_memory_t control;
+		control.create("congol_cluster_" + suffix, sizeof(control_t) + sizeof(result_t) * settings.workers);
+		control_t* block = new (control.data()) control_t();
+		result_t* results = (result_t*)(block + 1);
+		for (int i = 0; i < settings.workers; i++) new (results + i) result_t();
+
+		SharedMemoryTransport halos;
+		if (!settings.tcp) halos.create("congol_halo_" + suffix, settings.workers, Domain::message_size(layout));
+
+		// the log writer may already run (report() of an earlier run), forking a threaded process
+		// children only touch their own transport & the segments and never log, a failure goes to the parent through results
+		std::vector<pid_t> children;
+		for (int rank = 0; rank < settings.workers; rank++) {
+			pid_t pid = fork();
+			if (pid == 0) {
+				settings_t worker = settings;
+				worker.hosts = { "127.0.0.1" };
+				result_t result;
+				bool ok = work(worker, rank, block, result, "congol_halo_" + suffix);
+				results[rank] = result;
+				if (!ok) block->failed.store(1);
+				std::fflush(stdout);
+				_exit(ok ? 0 : 1);
+			}
+			if (pid == -1) {
+				fan_log_error("fork failed");
+				block->failed.store(1);
+				break;
+			}
+			children.push_back(pid);
+		}
+
+		// polled, a worker that dies early fails the run at once instead of leaving the others waiting for it
+		bool ok = (int)children.size() == settings.workers;
+		std::vector<bool> exited(children.size());
+		for (size_t remaining = children.size(); remaining;) {
+			bool any = false;
+			for (int rank = 0; rank < (int)children.size(); rank++) {
+				int status = 0;
+				if (exited[rank] || waitpid(children[rank], &status, WNOHANG) == 0) continue;
+				exited[rank] = true;
+				remaining--;
+				any = true;
+				if (WIFEXITED(status) && WEXITSTATUS(status) == 0) continue;
+				ok = false;
+				block->failed.store(1);
+				if (results[rank].error[0]) fan_log_error(results[rank].error);
+				else if (WIFSIGNALED(status)) fan_log_error("Domain", rank, "killed by signal", WTERMSIG(status));
+				else fan_log_error("Domain", rank, "exited with", WEXITSTATUS(status));
+			}
+			if (!any) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		total = result_t();
+		for (int i = 0; i < settings.workers && ok; i++) {
+			total.elapsed = std::max(total.elapsed, results[i].elapsed);
+			total.waited += results[i].waited;
+			total.population += results[i].population;
+			total.checksum += results[i].checksum;
+		}
+		total.ok = ok;
+		if (!ok) fan_log_error("A domain worker failed");
+		return ok;
+	#else
+		fan_log_error("Local domain runs fork workers, start them with CONGOL_DOMAIN_WORKER on this platform");
+		return false;
+	#endif
+	}
+
+private:
+	struct control_t {
+		std::atomic<uint32_t> ready;   // workers past setup, they start together
+		std::atomic<uint32_t> failed;
+	};
+
+	static bool work(const settings_t& settings, int rank, control_t* control, result_t& result, const std::string& segment = std::string()) {
+		const Domain::layout_t layout = Domain::partition(settings.width, settings.height, settings.workers);
+		if (layout.count() != settings.workers || rank < 0 || rank >= settings.workers) {
+			std::snprintf(result.error, sizeof(result.error), "No domain %d in %d domains of %d x %d", rank, settings.workers, settings.width, settings.height);
+			return false;
+		}
+
+		Domain domain;
+		domain.open(layout, rank);
+		domain.fill_random(settings.seed, 25);
+
+		std::unique_ptr<Transport> transport;
+		if (settings.tcp) {
+			auto tcp = std::make_unique<TcpTransport>();
+			if (!tcp->open(rank, settings.hosts, settings.port, domain.neighbours())) {
+				std::snprintf(result.error, sizeof(result.error), "Domain %d couldn't reach its neighbours: %s", rank, tcp->error().c_str());
+				return false;
+			}
+			transport = std::move(tcp);
+		}
+		else {
+			auto shm = std::make_unique<SharedMemoryTransport>();
+			if (!shm->open(segment, rank)) {
+				std::snprintf(result.error, sizeof(result.error), "Domain %d couldn't open %s", rank, segment.c_str());
+				return false;
+			}
+			transport = std::move(shm);
+		}
+
+		if (control) {
+			control->ready.fetch_add(1);
+			const uint64_t start = fan::time::clock::now();
+			while (control->ready.load() < (uint32_t)settings.workers) {
+				if (control->failed.load()) {
+					std::snprintf(result.error, sizeof(result.error), "Domain %d stopped, another domain failed its setup", rank);
+					return false;
+				}
+				if (fan::time::clock::now() - start > Transport::timeout) {
+					std::snprintf(result.error, sizeof(result.error), "Domain %d timed out waiting for the other domains' setup", rank);
+					return false;
+				}
+				std::this_thread::yield();
+			}
+		}
+
+		uint64_t start = fan::time::clock::now();
+		for (uint64_t g = 0; g < settings.generations; g++) {
+			if (!domain.step(*transport)) {
+				std::snprintf(result.error, sizeof(result.error), "Domain %d lost a neighbour at generation %llu", rank, (unsigned long long)g);
+				return false;
+			}
+		}
+		result.elapsed = fan::time::clock::now() - start;
+		result.waited = domain.waited();
+		result.population = domain.population();
+		result.checksum = domain.checksum();
+		result.ok = true;
+		return true;
+	}
+
+	static void report(const settings_t& settings, const result_t& result, const result_t& single) {
+		const double seconds = result.elapsed / 1e9;
+		const double cells = (double)settings.width * settings.height * settings.generations;
+		fan_log_info(
+			"Domains:", settings.workers, settings.tcp ? "(tcp)" : "(shm)",
+			"generations/s:", settings.generations / seconds,
+			"Gcells/s:", cells / seconds / 1e9,
+			"speedup:", (double)single.elapsed / result.elapsed,
+			"halo wait %:", 100.0 * result.waited / settings.workers / std::max<uint64_t>(result.elapsed, 1),
+			"population:", result.population,
+			"checksum:", result.checksum
+		);
+	}
+};
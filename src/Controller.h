@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <fan/network/stream.h>
+
+/// <summary>
+///
+/// Control endpoint for scripts, a unix socket (named pipe on windows) served from the network thread
+/// Messages are framed by fan::network::framer_t (u32 length), all integers little endian
+/// request:  u32 id, u8 command, arguments
+/// response: u32 id, u8 status, result (status error: a message)
+/// Requests are queued as they arrive and executed in order on the simulation thread (Grid::update_control), so a script
+/// can pipeline any number of them and match the responses by id
+///
+/// command        arguments                                        result
+/// step           u32 generations                                  state
+/// run_until      u64 generation                                   state, sent once the generation is reached
+/// pause          -                                                state
+/// stats          -                                                state
+/// set_cells      u8 alive, u32 count, count x (u32 x, u32 y)      -
+/// write_region   u32 x, y, width, height, rows of bits            -
+/// read_region    u32 x, y, width, height                          u32 width, height, rows of bits
+/// checkpoint     path                                             u64 bytes written
+/// restore        path                                             state
+///
+/// state is u64 generation, u64 population, u32 side, u8 ticking
+/// rows of bits are (width + 7) / 8 bytes per row, bit i of byte j is cell 8j + i of the row
+/// checkpoint files are a Delta keyframe of the whole grid, restore brings back its size & generation and clears the undo history
+///
+/// </summary>
+
+class Controller {
+public:
+	enum command_t : uint8_t {
+		step = 1,
+		run_until,
+		pause,
+		stats,
+		set_cells,
+		write_region,
+		read_region,
+		checkpoint,
+		restore,
+	};
+
+	enum status_t : uint8_t {
+		ok = 0,
+		error = 1,
+	};
+
+	struct request_t {
+		fan::network::server_t::client_id_t client;
+		uint32_t id;
+		uint8_t command;
+		std::string arguments;
+	};
+
+	// Reads arguments in order, any read past the end leaves ok false
+	struct reader_t {
+		const std::string& data;
+		size_t offset = 0;
+		bool ok = true;
+
+		template <typename T>
+		T get() {
+			T value = 0;
+			if (data.size() - offset < sizeof(T)) {
+				ok = false;
+				return value;
+			}
+			for (size_t i = 0; i < sizeof(T); i++) value |= (T)(uint8_t)data[offset + i] << (i * 8);
+			offset += sizeof(T);
+			return value;
+		}
+
+		const uint8_t* bytes(size_t size) {
+			if (data.size() - offset < size) {
+				ok = false;
+				return nullptr;
+			}
+			offset += size;
+			return (const uint8_t*)data.data() + offset - size;
+		}
+
+		std::string rest() {
+			std::string value = data.substr(offset);
+			offset = data.size();
+			return value;
+		}
+	};
+
+	// Response under construction, see reply()
+	struct writer_t {
+		std::string data;
+
+		template <typename T>
+		void put(T value) {
+			for (size_t i = 0; i < sizeof(T); i++) data.push_back((char)(value >> (i * 8)));
+		}
+	};
+
+	Controller() {}
+	~Controller() { close(); }
+
+	void open(const std::string& path) {
+		close();
+		fan::network::server_t::callbacks_t callbacks;
+		callbacks.receive = on_receive;
+		callbacks.disconnect = on_disconnect;
+		callbacks.userptr = this;
+		server_.open_pipe(path, callbacks);
+		path_ = path;
+	}
+
+	void close() {
+		server_.close();
+		std::lock_guard<std::mutex> lock(mutex_);
+		framers_.clear();
+		requests_.clear();
+	}
+
+	bool is_open() const {
+		return server_.is_open();
+	}
+
+	const std::string& path() const {
+		return path_;
+	}
+
+	uint32_t client_count() {
+		return server_.client_count();
+	}
+
+	// Moves requests received since the last call to the back of queue
+	void take(std::deque<request_t>& queue) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (auto& request : requests_) queue.push_back(std::move(request));
+		requests_.clear();
+	}
+
+	void reply(const request_t& request, status_t status, const std::string& result = std::string()) {
+		std::string message;
+		size_t begin = fan::network::framer_t::begin_message(message);
+		writer_t header;
+		header.put(request.id);
+		header.put((uint8_t)status);
+		message += header.data;
+		message += result;
+		fan::network::framer_t::end_message(message, begin);
+		server_.send(request.client, fan::network::make_buffer(std::move(message)));
+	}
+
+private:
+	// network thread
+	static void on_receive(fan::network::server_t* server, fan::network::server_t::client_id_t id, const char* data, size_t size, void* userptr) {
+		Controller* controller = (Controller*)userptr;
+		std::lock_guard<std::mutex> lock(controller->mutex_);
+		bool valid = controller->framers_[id].feed(data, size, [&](const char* message, size_t length) {
+			if (length < 5) return; // no room for id & command, nothing to answer to
+			request_t request;
+			request.client = id;
+			std::memcpy(&request.id, message, 4);
+			request.command = (uint8_t)message[4];
+			request.arguments.assign(message + 5, length - 5);
+			controller->requests_.push_back(std::move(request));
+		});
+		if (!valid) server->disconnect(id);
+	}
+
+	static void on_disconnect(fan::network::server_t*, fan::network::server_t::client_id_t id, void* userptr) {
+		Controller* controller = (Controller*)userptr;
+		std::lock_guard<std::mutex> lock(controller->mutex_);
+		controller->framers_.erase(id);
+	}
+
+	fan::network::server_t server_;
+	std::string path_;
+
+	std::mutex mutex_;
+	std::unordered_map<fan::network::server_t::client_id_t, fan::network::framer_t> framers_;
+	std::deque<request_t> requests_;
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "Bitplane.h"
+
+/// <summary>
+///
+/// Wire format of streamed universes (Broadcaster -> Spectator), all integers little endian
+/// keyframe: 'K', sequence u64, generation u64, time u64, width u32, height u32, bits
+/// delta:    'D', sequence u64, generation u64, time u64, bits XOR the previous sequence's bits
+/// bits are either runs (varint pairs of cleared bits skipped, set bits) or the raw words, whichever is smaller
+/// Runs are over the whole bitplane as one bit string, padding bits past the width are always 0
+///
+/// </summary>
+
+class Delta {
+public:
+	enum : uint8_t {
+		keyframe = 'K',
+		delta = 'D',
+		request_keyframe = 'R', // spectator -> broadcaster, the spectator lost track
+	};
+
+	enum : uint8_t {
+		runs = 0,
+		raw = 1,
+	};
+
+	struct header_t {
+		uint8_t type;
+		uint64_t sequence;
+		uint64_t generation;
+		uint64_t time;     // fan::time::clock::now() of the sender, only comparable on the same machine
+		uint32_t width;    // keyframes only
+		uint32_t height;
+	};
+
+	static void write_header(std::string& out, const header_t& header) {
+		out.push_back((char)header.type);
+		put(out, header.sequence);
+		put(out, header.generation);
+		put(out, header.time);
+		if (header.type == keyframe) {
+			put(out, header.width);
+			put(out, header.height);
+		}
+	}
+
+	// Bits of a, XOR b if b isn't null. Returns false (and writes nothing) if all bits are 0
+	static bool encode(std::string& out, const uint64_t* a, const uint64_t* b, size_t words) {
+		const size_t begin = out.size();
+		out.push_back((char)runs);
+
+		auto word = [&](size_t i) { return b ? a[i] ^ b[i] : a[i]; };
+		const uint64_t total = (uint64_t)words * 64;
+		const size_t limit = begin + 1 + words * 8; // raw is smaller past this
+
+		uint64_t position = 0;
+		for (;;) {
+			uint64_t start = find(word, words, position, false);
+			if (start == total) break;
+			uint64_t end = find(word, words, start, true);
+			put_varint(out, start - position);
+			put_varint(out, end - start);
+			position = end;
+			if (out.size() >= limit) {
+				out.resize(begin);
+				out.push_back((char)raw);
+				for (size_t i = 0; i < words; i++) put(out, word(i));
+				return true;
+			}
+		}
+		if (position == 0) {
+			out.resize(begin);
+			return false;
+		}
+		return true;
+	}
+
+	// XORs encoded bits into words, false if the data doesn't fit words
+	static bool decode(const char* data, size_t size, uint64_t* words, size_t count) {
+		if (size == 0) return false;
+		const uint8_t* p = (const uint8_t*)data + 1;
+		const uint8_t* end = (const uint8_t*)data + size;
+
+		if (data[0] == raw) {
+			if ((size_t)(end - p) != count * 8) return false;
+			for (size_t i = 0; i < count; i++) {
+				uint64_t w;
+				std::memcpy(&w, p + i * 8, 8);
+				words[i] ^= w;
+			}
+			return true;
+		}
+		if (data[0] != runs) return false;
+
+		const uint64_t total = (uint64_t)count * 64;
+		uint64_t position = 0;
+		while (p < end) {
+			uint64_t skip, length;
+			if (!get_varint(p, end, skip) || !get_varint(p, end, length)) return false;
+			if (skip > total - position || length > total - position - skip) return false;
+			position += skip;
+			flip(words, position, length);
+			position += length;
+		}
+		return true;
+	}
+
+	static bool read_header(const char*& data, size_t& size, header_t& header) {
+		const uint8_t* p = (const uint8_t*)data;
+		const uint8_t* end = p + size;
+		if (p == end) return false;
+		header.type = *p++;
+		if (header.type != keyframe && header.type != delta) return false;
+		if (!get(p, end, header.sequence) || !get(p, end, header.generation) || !get(p, end, header.time)) return false;
+		header.width = header.height = 0;
+		if (header.type == keyframe && (!get(p, end, header.width) || !get(p, end, header.height))) return false;
+		size -= (const char*)p - data;
+		data = (const char*)p;
+		return true;
+	}
+
+private:
+	// first bit at or after position that is set (or cleared if cleared), words * 64 if none
+	template <typename word_t>
+	static uint64_t find(const word_t& word, size_t words, uint64_t position, bool cleared) {
+		size_t i = position / 64;
+		if (i >= words) return (uint64_t)words * 64;
+		const uint64_t invert = cleared ? ~(uint64_t)0 : 0;
+		uint64_t w = (word(i) ^ invert) & (~(uint64_t)0 << (position % 64));
+		while (w == 0) {
+			if (++i == words) return (uint64_t)words * 64;
+			w = word(i) ^ invert;
+		}
+		return (uint64_t)i * 64 + std::countr_zero(w);
+	}
+
+	static void flip(uint64_t* words, uint64_t position, uint64_t length) {
+		while (length) {
+			uint64_t offset = position % 64;
+			uint64_t n = std::min<uint64_t>(64 - offset, length);
+			uint64_t mask = n == 64 ? ~(uint64_t)0 : (((uint64_t)1 << n) - 1) << offset;
+			words[position / 64] ^= mask;
+			position += n;
+			length -= n;
+		}
+	}
+
+	template <typename T>
+	static void put(std::string& out, T value) {
+		for (size_t i = 0; i < sizeof(T); i++) out.push_back((char)(value >> (i * 8)));
+	}
+
+	template <typename T>
+	static bool get(const uint8_t*& p, const uint8_t* end, T& value) {
+		if ((size_t)(end - p) < sizeof(T)) return false;
+		value = 0;
+		for (size_t i = 0; i < sizeof(T); i++) value |= (T)p[i] << (i * 8);
+		p += sizeof(T);
+		return true;
+	}
+
+	static void put_varint(std::string& out, uint64_t value) {
+		while (value >= 0x80) {
+			out.push_back((char)(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back((char)value);
+	}
+
+	static bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+		value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (p == end) return false;
+			uint8_t byte = *p++;
+			value |= (uint64_t)(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) return true;
+		}
+		return false;
+	}
+};
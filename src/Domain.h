@@ -0,0 +1,280 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#include <fan/time/time.h>
+
+#include "Life.h"
+#include "Transport.h"
+
+/// <summary>
+///
+/// One rectangle of a universe split into columns x rows domains, simulated by its own worker (see Cluster.h)
+/// Cells are packed rows with a one cell halo around them: local cell (x, y) is bit x + 1 of row y + 1
+/// Each generation the edge cells go to the (up to) 8 neighbours, and their edges come back into the halo
+/// The interior is computed while the halo is in flight, only the rows & words touching the halo wait for it
+/// Outside of the universe is dead
+///
+/// </summary>
+
+class Domain {
+public:
+	enum direction_t { north, south, west, east, north_west, north_east, south_west, south_east, direction_count };
+
+	struct layout_t {
+		int width = 0;
+		int height = 0;
+		int columns = 1;
+		int rows = 1;
+
+		int count() const {
+			return columns * rows;
+		}
+	};
+
+	// count domains in the grid with the least halo per domain
+	static layout_t partition(int width, int height, int count) {
+		layout_t layout;
+		layout.width = width;
+		layout.height = height;
+		double best = -1;
+		for (int columns = 1; columns <= count; columns++) {
+			if (count % columns) continue;
+			int rows = count / columns;
+			if (columns > width || rows > height) continue;
+			double edge = (double)width / columns + (double)height / rows;
+			if (best < 0 || edge < best) {
+				best = edge;
+				layout.columns = columns;
+				layout.rows = rows;
+			}
+		}
+		return layout;
+	}
+
+	// Cells of rank, remainders go to the first columns / rows
+	static void bounds(const layout_t& layout, int rank, int& x0, int& y0, int& width, int& height) {
+		auto split = [](int total, int parts, int i, int& begin, int& size) {
+			size = total / parts + (i < total % parts);
+			begin = i * (total / parts) + std::min(i, total % parts);
+		};
+		split(layout.width, layout.columns, rank % layout.columns, x0, width);
+		split(layout.height, layout.rows, rank / layout.columns, y0, height);
+	}
+
+	// Largest halo message of layout, in bytes
+	static size_t message_size(const layout_t& layout) {
+		int side = std::max((layout.width + layout.columns - 1) / layout.columns, (layout.height + layout.rows - 1) / layout.rows);
+		return (size_t)(side + 63) / 64 * sizeof(uint64_t);
+	}
+
+	void open(const layout_t& layout, int rank) {
+		layout_ = layout;
+		rank_ = rank;
+		bounds(layout, rank, x0_, y0_, width_, height_);
+		words_ = (width_ + 2 + 63) / 64;
+		current_.assign((size_t)words_ * (height_ + 2), 0);
+		next_.assign(current_.size(), 0);
+		message_.resize(message_size(layout) / sizeof(uint64_t));
+
+		// cells 1 .. width of a row
+		masks_.assign(words_, 0);
+		for (int x = 1; x <= width_; x++) masks_[x / 64] |= (uint64_t)1 << (x % 64);
+
+		const int column = rank % layout.columns, row = rank / layout.columns;
+		const int offsets[direction_count][2] = { { 0, -1 }, { 0, 1 }, { -1, 0 }, { 1, 0 }, { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 } };
+		for (int d = 0; d < direction_count; d++) {
+			int c = column + offsets[d][0], r = row + offsets[d][1];
+			bool inside = c >= 0 && c < layout.columns && r >= 0 && r < layout.rows;
+			neighbours_[d] = inside ? r * layout.columns + c : -1;
+		}
+		generation_ = 0;
+		waited_ = 0;
+	}
+
+	// Ranks next to this one, for connecting transports
+	std::vector<int> neighbours() const {
+		std::vector<int> ranks;
+		for (int d = 0; d < direction_count; d++) {
+			if (neighbours_[d] != -1) ranks.push_back(neighbours_[d]);
+		}
+		return ranks;
+	}
+
+	// Same soup whatever the layout: a cell's state only depends on seed and its universe coordinates
+	void fill_random(uint64_t seed, int percent) {
+		for (int y = 0; y < height_; y++) {
+			for (int x = 0; x < width_; x++) {
+				if (hash(seed, x0_ + x, y0_ + y) % 100 < (uint64_t)percent) set(x, y, true);
+			}
+		}
+	}
+
+	void set(int x, int y, bool alive) {
+		uint64_t& word = current_[(size_t)(y + 1) * words_ + (x + 1) / 64];
+		uint64_t mask = (uint64_t)1 << ((x + 1) % 64);
+		word = alive ? word | mask : word & ~mask;
+	}
+
+	bool get(int x, int y) const {
+		return current_[(size_t)(y + 1) * words_ + (x + 1) / 64] >> ((x + 1) % 64) & 1;
+	}
+
+	// One generation. false if a neighbour's halo didn't arrive
+	bool step(Transport& transport) {
+		for (int d = 0; d < direction_count; d++) {
+			if (neighbours_[d] == -1) continue;
+			size_t size = pack((direction_t)d);
+			transport.send(neighbours_[d], generation_, message_.data(), size);
+		}
+
+		// rows not next to the halo rows, the words next to the halo columns are redone below
+		for (int y = 2; y < height_; y++) compute(y, 0, words_);
+
+		uint64_t start = fan::time::clock::now();
+		for (int d = 0; d < direction_count; d++) {
+			if (neighbours_[d] == -1) continue;
+			// what the neighbour to the north sent is its south edge, and so on
+			if (!transport.receive(neighbours_[d], generation_, message_.data(), message_size(layout_))) return false;
+			unpack((direction_t)d);
+		}
+		waited_ += fan::time::clock::now() - start;
+
+		compute(1, 0, words_);
+		if (height_ > 1) compute(height_, 0, words_);
+		const int last = width_ / 64; // word of cell width, next to the east halo
+		for (int y = 2; y < height_; y++) {
+			compute(y, 0, 1);
+			if (last > 0) compute(y, last, last + 1);
+		}
+
+		current_.swap(next_);
+		generation_++;
+		return true;
+	}
+
+	uint64_t population() const {
+		uint64_t population = 0;
+		for (int y = 1; y <= height_; y++) {
+			for (int i = 0; i < words_; i++) population += std::popcount(current_[(size_t)y * words_ + i] & masks_[i]);
+		}
+		return population;
+	}
+
+	// Sum over live cells of a hash of their universe coordinates, adds up across domains the same for any layout
+	uint64_t checksum() const {
+		uint64_t sum = 0;
+		for (int y = 0; y < height_; y++) {
+			for (int x = 0; x < width_; x++) {
+				if (get(x, y)) sum += hash(0, x0_ + x, y0_ + y);
+			}
+		}
+		return sum;
+	}
+
+	uint64_t generation() const { return generation_; }
+	uint64_t waited() const { return waited_; } // ns blocked on halos
+	int width() const { return width_; }
+	int height() const { return height_; }
+
+private:
+	static uint64_t hash(uint64_t seed, int x, int y) {
+		uint64_t z = seed ^ ((uint64_t)(uint32_t)y << 32 | (uint32_t)x);
+		z += 0x9e3779b97f4a7c15;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+		return z ^ (z >> 31);
+	}
+
+	uint64_t* row(std::vector<uint64_t>& cells, int y) {
+		return &cells[(size_t)y * words_];
+	}
+
+	void compute(int y, int begin, int end) {
+		uint64_t* out = row(next_, y);
+		Life::step(row(current_, y - 1), row(current_, y), row(current_, y + 1), out, begin, end, words_);
+		for (int i = begin; i < end; i++) out[i] &= masks_[i];
+	}
+
+	// Edge going to the neighbour in direction d, into message_. Returns bytes
+	size_t pack(direction_t d) {
+		std::fill(message_.begin(), message_.end(), 0);
+		switch (d) {
+		case north:
+		case south: {
+			// cells 1 .. width shifted down to bit 0
+			const uint64_t* src = row(current_, d == north ? 1 : height_);
+			for (int i = 0; i < (width_ + 63) / 64; i++) {
+				message_[i] = src[i] >> 1 | (i + 1 < words_ ? src[i + 1] << 63 : 0);
+			}
+			return (size_t)(width_ + 63) / 64 * sizeof(uint64_t);
+		}
+		case west:
+		case east: {
+			const int x = d == west ? 1 : width_;
+			for (int y = 0; y < height_; y++) {
+				message_[y / 64] |= (row(current_, y + 1)[x / 64] >> (x % 64) & 1) << (y % 64);
+			}
+			return (size_t)(height_ + 63) / 64 * sizeof(uint64_t);
+		}
+		default: {
+			const int x = d == north_west || d == south_west ? 1 : width_;
+			const int y = d == north_west || d == north_east ? 1 : height_;
+			message_[0] = row(current_, y)[x / 64] >> (x % 64) & 1;
+			return sizeof(uint64_t);
+		}
+		}
+	}
+
+	// Edge of the neighbour in direction d from message_ into the halo
+	void unpack(direction_t d) {
+		switch (d) {
+		case north:
+		case south: {
+			uint64_t* dst = row(current_, d == north ? 0 : height_ + 1);
+			for (int i = 0; i < words_; i++) {
+				uint64_t low = i > 0 ? message_[i - 1] >> 63 : 0;
+				uint64_t word = i < (int)message_.size() ? message_[i] << 1 : 0;
+				// corners are written after, by their own messages
+				dst[i] = (word | low) & masks_[i];
+			}
+			break;
+		}
+		case west:
+		case east: {
+			const int x = d == west ? 0 : width_ + 1;
+			const uint64_t bit = (uint64_t)1 << (x % 64);
+			for (int y = 0; y < height_; y++) {
+				uint64_t& word = row(current_, y + 1)[x / 64];
+				word = (message_[y / 64] >> (y % 64) & 1) ? word | bit : word & ~bit;
+			}
+			break;
+		}
+		default: {
+			const int x = d == north_west || d == south_west ? 0 : width_ + 1;
+			const int y = d == north_west || d == north_east ? 0 : height_ + 1;
+			uint64_t& word = row(current_, y)[x / 64];
+			const uint64_t bit = (uint64_t)1 << (x % 64);
+			word = (message_[0] & 1) ? word | bit : word & ~bit;
+			break;
+		}
+		}
+	}
+
+	layout_t layout_;
+	int rank_ = 0;
+	int x0_ = 0, y0_ = 0, width_ = 0, height_ = 0;
+	int words_ = 0;
+	int neighbours_[direction_count];
+
+	std::vector<uint64_t> current_;
+	std::vector<uint64_t> next_;
+	std::vector<uint64_t> masks_;
+	std::vector<uint64_t> message_;
+
+	uint64_t generation_ = 0;
+	uint64_t waited_ = 0;
+};
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fan/types/color.h>
+#include <fan/time/time.h>
+#include <fan/io/log.h>
+#include <fan/time/trace.h>
+#include <fan/graphics/webp.h>
+
+#include "Bitplane.h"
+#include "Rasterizer.h"
+
+/// <summary>
+///
+/// Lossless WebP export of generations, single images and animations of a generation range, and of screenshots
+/// Simulation thread only copies the bitplane (one bit per cell), rasterizing & encoding happen on the export thread
+///
+/// </summary>
+
+class Exporter {
+public:
+	Exporter() {}
+	~Exporter() {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			running_ = false;
+		}
+		wake_.notify_one();
+		if (thread_.joinable()) thread_.join();
+	}
+
+	// Pixels per cell, reduced when the image would exceed the format's size limit
+	void set_scale(int scale) { settings_.scale = std::max(scale, 1); }
+
+	// Lines between cells, only drawn at 3 or more pixels per cell
+	void set_gridlines(bool gridlines) { settings_.gridlines = gridlines; }
+
+	void set_colors(fan::color alive, fan::color dead) {
+		settings_.alive = Rasterizer::to_rgba(alive);
+		settings_.dead = Rasterizer::to_rgba(dead);
+	}
+
+	void save_still(const std::string& path, const Bitplane& bitplane) {
+		push(job_t{ job_t::still, path, bitplane, settings_, 0, {}, {} });
+	}
+
+	// Already rendered RGBA pixels, e.g. a screenshot, top row first
+	void save_pixels(const std::string& path, std::vector<uint32_t> pixels, fan::vec2i size) {
+		push(job_t{ job_t::image, path, Bitplane(), settings_, 0, std::move(pixels), size });
+	}
+
+	// Following add_generation calls become frames of one animated file, written by end_animation
+	void begin_animation(const std::string& path, uint32_t frame_duration_ms) {
+		animating_ = true;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			dropped_ = 0;
+		}
+		push(job_t{ job_t::begin, path, Bitplane(), settings_, frame_duration_ms, {}, {} });
+	}
+
+	// Dropped (and counted) instead of queued while max_queued_frames generations wait for the export thread
+	void add_generation(const Bitplane& bitplane) {
+		if (!animating_) return;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (queued_frames_ >= max_queued_frames) {
+				dropped_++;
+				return;
+			}
+			queued_frames_++;
+		}
+		push(job_t{ job_t::frame, std::string(), bitplane, settings_, 0, {}, {} });
+	}
+
+	void end_animation() {
+		if (!animating_) return;
+		animating_ = false;
+		push(job_t{ job_t::end, std::string(), Bitplane(), settings_, 0, {}, {} });
+	}
+
+	bool animating() const { return animating_; }
+
+	// Each queued generation holds a copy of the bitplane
+	static constexpr size_t max_queued_frames = 32;
+
+	struct stats_t {
+		size_t backlog;   // generations waiting for the export thread
+		uint64_t dropped; // generations of the current/last animation that weren't exported
+	};
+
+	stats_t stats() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return stats_t{ queued_frames_, dropped_ };
+	}
+
+private:
+	// Copied into every job, export thread never reads members the simulation thread writes
+	typedef Rasterizer::settings_t settings_t;
+
+	struct job_t {
+		enum { still, begin, frame, end, image } type;
+		std::string path;
+		Bitplane bitplane;
+		settings_t settings;
+		uint32_t duration; // ms per frame, begin only
+		std::vector<uint32_t> pixels; // image only
+		fan::vec2i size;
+	};
+
+	void push(job_t job) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			jobs_.push_back(std::move(job));
+			if (!thread_.joinable()) {
+				thread_ = std::thread([this] {
+					fan::time::get_trace().set_thread_name("exporter");
+					work();
+				});
+			}
+		}
+		wake_.notify_one();
+	}
+
+	void work() {
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (true) {
+			wake_.wait(lock, [this] { return !jobs_.empty() || !running_; });
+			if (jobs_.empty()) return;
+			job_t job = std::move(jobs_.front());
+			jobs_.pop_front();
+			if (job.type == job_t::frame) queued_frames_--;
+			lock.unlock();
+			{
+				fan_trace_scope("export", "webp");
+				run(job);
+			}
+			lock.lock();
+		}
+	}
+
+	// Scale that keeps the image within the webp limit, 0 if not even one pixel per cell fits
+	static int fit_scale(const Bitplane& bitplane, int scale) {
+		int side = std::max(bitplane.width(), bitplane.height());
+		if (side == 0 || side > fan::webp::max_size) return 0;
+		return std::min(scale, fan::webp::max_size / side);
+	}
+
+	void rasterize(const Bitplane& bitplane, int scale, settings_t settings) {
+		const int w = bitplane.width() * scale;
+		const int h = bitplane.height() * scale;
+		pixels_.resize((size_t)w * h);
+		settings.scale = scale;
+		Rasterizer::rgba(bitplane, settings, pixels_.data(), w, h, w);
+	}
+
+	void run(const job_t& job) {
+		switch (job.type) {
+		case job_t::still: {
+			int scale = fit_scale(job.bitplane, job.settings.scale);
+			if (scale == 0) {
+				fan_log_error("WebP export: grid too large for one image:", job.bitplane.width());
+				return;
+			}
+			uint64_t start = fan::time::clock::now();
+			rasterize(job.bitplane, scale, job.settings);
+			std::string encoded;
+			if (!fan::webp::encode_lossless((const uint8_t*)pixels_.data(), fan::vec2i(job.bitplane.width(), job.bitplane.height()) * scale, encoded)) {
+				fan_log_error("WebP export: encoding failed");
+				return;
+			}
+			fan::io::file::write(job.path, encoded, std::ios_base::binary | std::ios_base::trunc);
+			fan_log_info("WebP export:", job.path, "KiB:", encoded.size() / 1024, "ms:", fan::time::clock::elapsed(start) / 1e6);
+			break;
+		}
+		case job_t::image: {
+			uint64_t start = fan::time::clock::now();
+			std::string encoded;
+			if (!fan::webp::encode_lossless((const uint8_t*)job.pixels.data(), job.size, encoded)) {
+				fan_log_error("WebP export: encoding failed");
+				return;
+			}
+			fan::io::file::write(job.path, encoded, std::ios_base::binary | std::ios_base::trunc);
+			fan_log_info("WebP export:", job.path, "KiB:", encoded.size() / 1024, "ms:", fan::time::clock::elapsed(start) / 1e6);
+			break;
+		}
+		case job_t::begin: {
+			animation_path_ = job.path;
+			animation_duration_ = job.duration;
+			animation_settings_ = job.settings;
+			animation_started_ = false;
+			animation_scale_ = 0;
+			break;
+		}
+		case job_t::frame: {
+			if (!animation_started_) {
+				animation_scale_ = fit_scale(job.bitplane, animation_settings_.scale);
+				if (animation_scale_ == 0) {
+					fan_log_error("WebP export: grid too large for one image:", job.bitplane.width());
+					animation_started_ = true;
+					return;
+				}
+				animation_size_ = fan::vec2i(job.bitplane.width(), job.bitplane.height());
+				animation_.open(animation_size_ * animation_scale_);
+				animation_time_ = 0;
+				animation_started_ = true;
+			}
+			// later frames of a different size (grid re-initialized) can't share the canvas
+			if (animation_scale_ == 0 || fan::vec2i(job.bitplane.width(), job.bitplane.height()) != animation_size_) return;
+			uint64_t start = fan::time::clock::now();
+			rasterize(job.bitplane, animation_scale_, animation_settings_);
+			if (!animation_.add_frame((const uint8_t*)pixels_.data(), animation_duration_)) {
+				fan_log_error("WebP export: encoding frame failed");
+			}
+			animation_time_ += fan::time::clock::elapsed(start);
+			break;
+		}
+		case job_t::end: {
+			if (animation_.frame_count() == 0) {
+				fan_log_warning("WebP export: no frames for", animation_path_);
+				return;
+			}
+			animation_.save(animation_path_);
+			// throughput of rasterize + encode only, time spent waiting for generations isn't counted
+			f64_t seconds = animation_time_ / 1e9;
+			fan_log_info("WebP export:", animation_path_, "frames:", animation_.frame_count(), "export fps:", animation_.frame_count() / std::max(seconds, 1e-9));
+			animation_.open(0);
+			break;
+		}
+		}
+	}
+
+	// simulation thread side
+	settings_t settings_;
+	bool animating_ = false;
+
+	// export thread side
+	std::vector<uint32_t> pixels_;
+	fan::webp::animation_t animation_;
+	std::string animation_path_;
+	bool animation_started_ = false;
+	int animation_scale_ = 0;
+	fan::vec2i animation_size_;
+	uint32_t animation_duration_ = 100;
+	settings_t animation_settings_;
+	uint64_t animation_time_ = 0; // nanoseconds spent on frames
+
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::deque<job_t> jobs_;
+	size_t queued_frames_ = 0; // frame jobs in jobs_
+	uint64_t dropped_ = 0;
+	std::thread thread_;
+	bool running_ = true;
+};
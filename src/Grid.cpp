@@ -1,4 +1,7 @@
+#include <bit>
 #include <cmath>
+#include <ctime>
+#include <fstream>
 #include "Grid.h"
 #include "Utils.h"
 // Container
@@ -6,23 +9,43 @@ Grid::Grid() {};
 
 // Initialize from scratch
 Grid::Grid(fan::window_t* window, fan::opengl::context_t* context, int subdivisions) {
-	rects_.open(context);
-	rects_.enable_draw(context);
 	this->context = context;
 	this->window = window;
+	this->open_graphics();
 	this->init(subdivisions);
 }
 
 // Initialize from save
 Grid::Grid(fan::window_t* window, fan::opengl::context_t* context, CellData cell_data) {
-	rects_.open(context);
-	rects_.enable_draw(context);
 	this->context = context;
 	this->window = window;
+	this->open_graphics();
 	this->init(1);
 	this->import(cell_data);
 }
 
+void Grid::open_graphics() {
+	// Every cell color is rewritten each frame, write them straight to the mapped buffer
+	fan_2d::graphics::rectangle_packed_axis_aligned_t::open_properties_t op;
+	op.buffer_mode = fan::opengl::core::glsl_buffer_t::mode::write_only; // grid is never read back, no need for a ram copy
+	rects_.open(context, op);
+	lod_sprite_.open(context);
+
+	// One draw call slot for both so that the cursor highlight stays on top when switching
+	context->enable_draw(this, [](fan::opengl::context_t* c, void* d) {
+		Grid* grid = (Grid*)d;
+		if (grid->lod_active_) grid->lod_sprite_.draw(c);
+		else grid->rects_.draw(c);
+	});
+
+	phase_.events = profiler_.add_phase("events");
+	phase_.input = profiler_.add_phase("input");
+	phase_.evolve = profiler_.add_phase("evolve");
+	phase_.draw = profiler_.add_phase("draw");
+	phase_.process = profiler_.add_phase("process");
+	phase_.render = profiler_.add_phase("render");
+}
+
 void Grid::run() {
 	// Lower  value = faster simulation
 	int tickrate = 25;
@@ -33,34 +56,153 @@ void Grid::run() {
 
 	int count = 0;
 
+	// Idle when paused and last frame had no input, the loop then blocks on window events instead of redrawing the same picture
+	bool idle = false;
+	uint64_t last_draw = 0;
+
 	while (true) {
+		// overlays change on their own, wake up for their refresh
+		// spectated generations & control requests don't wake the window, poll for them often enough
+		if (idle) {
+			uint64_t timeout = show_profiler || show_fps ? 250000000 : 1000000000;
+			if (spectator_.spectating()) timeout = 10000000;
+			if (controller_.is_open() && controller_.client_count()) timeout = 1000000;
+			window->wait_events(timeout);
+		}
+
+		fan_trace_scope("frame", "frame");
+
+		uint64_t allocations = fan::allocation_count();
 
-		uint32_t window_event = window->handle_events();
+		profiler_.collect();
+
+		uint32_t window_event;
+		{
+			fan_profile_scope(&profiler_, phase_.events);
+			fan_trace_scope("frame", "events");
+			window_event = window->handle_events();
+		}
     if(window_event & fan::window_t::events::close){
+      if (recorder_.recording()) toggle_recording(); // finish the file
+      if (exporter_.animating()) toggle_animation_export();
+      broadcaster_.stop();
+      spectator_.close();
+      ring_.close();
+      controller_.close();
       window->close();
       break;
     }
 
 		if (show_fps) window->get_fps();
 
-		if (paintingLive) set_alive_at_click();
-		if (paintingDead) set_dead_at_click();
+		bool remote = poll_spectated();
+		if (controller_.is_open()) controller_.take(control_queue_);
 
-		// ugly, but works for now
-		if (count > tickrate && ticking_) {
-			evolve();
-			count = 0;
+		// a pending screenshot arrives a frame or two after it was requested
+		bool dirty = (window_event & fan::window_t::events::input) || ticking_ || paintingLive || paintingDead || context->is_capturing() || remote || !control_queue_.empty();
+		idle = !dirty;
+		if (!dirty && !((show_profiler || show_fps) && fan::time::clock::elapsed(last_draw) >= 250000000)) continue;
+		last_draw = fan::time::clock::now();
+
+		{
+			fan_profile_scope(&profiler_, phase_.input);
+			fan_trace_scope("frame", "input");
+			if (paintingLive) set_alive_at_click();
+			if (paintingDead) set_dead_at_click();
+		}
+
+		{
+			fan_profile_scope(&profiler_, phase_.evolve);
+			fan_trace_scope("frame", "evolve");
+			// ugly, but works for now
+			if (count > tickrate && ticking_) {
+				evolve();
+				count = 0;
+			}
+			else if (ticking_) count++;
+
+			update_control();
+			publish_generation();
 		}
-		else if (ticking_) count++;
 
-		draw();
+		{
+			fan_profile_scope(&profiler_, phase_.draw);
+			fan_trace_scope("frame", "draw");
+			draw();
+			update_profiler_hud();
+		}
 
-    context->process();
-    context->render(window);
+		{
+			fan_profile_scope(&profiler_, phase_.process);
+			fan_trace_scope("frame", "process"); // buffer uploads & draw calls
+			context->process();
+		}
+		{
+			fan_profile_scope(&profiler_, phase_.render);
+			fan_trace_scope("frame", "render");
+			context->render(window);
+		}
 
+		frame_allocations_ = fan::allocation_count() - allocations;
 	}
 }
 
+Grid::Perimeter Grid::Cell::perimeter(Grid& grid) {
+	int i = index;
+
+	// lazy solution, but scalable - definitely in need of a better one
+	Perimeter perimeter;
+	int vertical_increment = std::sqrt(grid.cells_.size());
+
+	
+	i = i - vertical_increment - 1;
+	if (i == (0 - vertical_increment - 1)) {
+		perimeter.push_back(grid.cells_.back());
+	}
+	else if (i == (0 - vertical_increment)) {
+		perimeter.push_back(grid.cells_[Corners(grid).LowerLeft]);
+	}
+	else if (i == (0 - vertical_increment + 1)) {
+
+	}
+	else perimeter.push_back(grid.cells_[i]);
+
+	i++;
+	perimeter.push_back(grid.cells_[i]);
+
+	i++;
+	perimeter.push_back(grid.cells_[i]);
+
+	i = i + vertical_increment - 2;
+	perimeter.push_back(grid.cells_[i]);
+
+	/*i++;							// the cell itself
+	perimeter.push_back(i);*/
+
+	i = i + 2;
+	perimeter.push_back(grid.cells_[i]);
+
+	i = i + vertical_increment - 2;
+	perimeter.push_back(grid.cells_[i]);
+
+	i++;
+	perimeter.push_back(grid.cells_[i]);
+
+	i++;
+	perimeter.push_back(grid.cells_[i]);
+
+	return perimeter;
+}
+
+int Grid::count_live_cells(Perimeter& perimeter) {
+	int count = 0;
+	for (int i = 0; i < perimeter.size(); i++)
+	{
+		if (perimeter[i].alive) count++;
+	}
+	return count;
+}
+
 std::vector<Grid::Cell> Grid::get_live_cells() {
 	std::vector<Cell> live_cells;
 	
@@ -84,39 +226,12 @@ std::vector<Grid::Cell> Grid::get_live_cells(std::vector<Cell> cells) {
 }
 
 void Grid::init(int subdivisions) {
-	if (window != NULL)
-	{
-		// Clean previous data, whether it exists or not
-		this->cells_.clear();
-		this->map_.clear();
-
-		// Determine size of a single cell
-		this->cell_size_ = fan::cast<float>(window->get_size()) / subdivisions;
-
-		// Fill current grid with dead cells
-		for (size_t i = 0; i < ((long long int)subdivisions * subdivisions); i++)
-		{
-			this->cells_.push_back(Cell(false, cells_.size()));
-		}
-
-		// Offset drawing points by cell size
-		fan::vec2 offset(cell_size_.x, cell_size_.y);
+	if (window != NULL) reset_cells(subdivisions);
+	else fan_log_error("Grid::init Failure: Null window pointer");
 
-		fan::vec2 loc(0, 0);
-		for (size_t i = 0; i < subdivisions; i++)
-		{
-			for (size_t i = 0; i < subdivisions; i++)
-			{
-				map_.push_back(loc + cell_size_ / 2);
-				loc.x += offset.x; // wnd_x / 20
-			}
-			loc.x = 0;
-			loc.y += offset.y; // wnd_y / 20
-		}
-	}
-	else fan::print("Grid::init Failure: Null window pointer");
-
-	cursor_rects_.open(context);
+	fan_2d::graphics::rectangle_t::open_properties_t op;
+	op.rotation = false; // highlight is never rotated
+	cursor_rects_.open(context, op);
 	cursor_rects_.enable_draw(context);
 	fan_2d::graphics::rectangle_t::properties_t p;
 	p.position = 0;
@@ -126,6 +241,43 @@ void Grid::init(int subdivisions) {
 	p.size = (cell_size_ * 0.875) / 2;
 	p.color = color_dead_;
 	cursor_rects_.push_back(context, p); // selection highlight filler (completes illusion of outline)
+	cursor_cell_ = -1;
+}
+
+void Grid::reset_cells(int subdivisions) {
+	uint64_t start = fan::time::clock::now();
+
+	// Clean previous data, whether it exists or not
+	this->cells_.clear();
+	this->map_.clear();
+	bitplane_dirty_ = true;
+
+	// Determine size of a single cell
+	this->cell_size_ = fan::cast<float>(window->get_size()) / subdivisions;
+
+	// Sized once, then every cell is independent - filled in parallel
+	const uint64_t cell_count = (uint64_t)subdivisions * subdivisions;
+	this->cells_.resize(cell_count);
+	this->map_.resize(cell_count);
+
+	fan::parallel_for(cell_count, [&](uint64_t begin, uint64_t end) {
+		for (uint64_t i = begin; i < end; i++)
+		{
+			// Dead cell at the center of its square
+			cells_[i] = Cell(false, i);
+			map_[i] = fan::vec2(i % subdivisions + 0.5f, i / subdivisions + 0.5f) * cell_size_;
+		}
+	});
+
+	fan_log_info("Grid init:", cell_count, "cells in ms:", (fan::time::clock::now() - start) / 1e6);
+}
+
+void Grid::resize_grid(int subdivisions) {
+	reset_cells(subdivisions);
+	// cell buffer is rebuilt by draw() for the new size
+	rects_.clear(context);
+	cursor_rects_.set_size(context, 0, cell_size_ / 2);
+	cursor_rects_.set_size(context, 1, (cell_size_ * 0.875) / 2);
 }
 
 void Grid::import(CellData cell_data) {
@@ -135,21 +287,352 @@ void Grid::import(CellData cell_data) {
 	this->cells_ = cell_data.cells_;
 	this->map_ = cell_data.map_;
 	this->cell_size_ = cell_data.cell_size_;
+	bitplane_dirty_ = true;
+	cursor_cell_ = -1;
 }
 
 void Grid::import(int i) {
-	if (history_.size() >= i) { 
-		this->import(history_[i]); 
-		slot_ = i;
-		fan::print("Current slot:", slot_);
-		fan::print("History size:", history_.size());
-	}
+	// slots older than the history kept can't be reached
+	if (i < 0 || (uint32_t)i >= slot_ || slot_ - (uint32_t)i > history_.size()) return;
+	while (slot_ > (uint32_t)i) devolve();
+	fan_log_info("Current slot:", slot_);
+	fan_log_info("History size:", history_.size());
 }
 
 void Grid::toggle_simulation() {
 	ticking_ = !ticking_;
 }
 
+void Grid::toggle_recording() {
+	if (recorder_.recording()) {
+		recorder_.stop();
+		auto stats = recorder_.stats();
+		fan_log_info("Recording stopped, frames encoded:", stats.encoded, "dropped:", stats.dropped, "KiB:", stats.bytes / 1024);
+		return;
+	}
+
+	std::string path = "congol_" + std::to_string(std::time(nullptr)) + ".ivf";
+	try {
+		recorder_.start(path, get_window_divisor(), color_alive_, color_dead_, record_every);
+	}
+	catch (const std::exception&) {
+		fan_log_error("Failed to start recording to", path);
+		return;
+	}
+	fan_log_info("Recording to", path, "every", record_every, "generation(s)");
+
+	// starting state is the first frame
+	update_bitplane();
+	recorder_.capture(bitplane_);
+}
+
+void Grid::export_image() {
+	std::string path = "congol_" + std::to_string(std::time(nullptr)) + ".webp";
+	update_bitplane();
+	exporter_.set_scale(export_scale);
+	exporter_.set_gridlines(export_gridlines);
+	exporter_.set_colors(color_alive_, color_dead_);
+	exporter_.save_still(path, bitplane_); // encoded on the export thread, logged when written
+}
+
+void Grid::toggle_animation_export() {
+	if (exporter_.animating()) {
+		exporter_.end_animation();
+		if (uint64_t dropped = exporter_.stats().dropped) fan_log_warning("Animation export fell behind, generations dropped:", dropped);
+		return;
+	}
+
+	std::string path = "congol_" + std::to_string(std::time(nullptr)) + "_anim.webp";
+	exporter_.set_scale(export_scale);
+	exporter_.set_gridlines(export_gridlines);
+	exporter_.set_colors(color_alive_, color_dead_);
+	exporter_.begin_animation(path, 100);
+	fan_log_info("Exporting generations to", path);
+
+	update_bitplane();
+	exporter_.add_generation(bitplane_);
+}
+
+void Grid::screenshot() {
+	context->capture_once([](fan::opengl::context_t*, const fan::opengl::capture_frame_t& frame, void* userptr) {
+		// GL rows are bottom up, alpha of the back buffer isn't meaningful
+		std::vector<uint32_t> pixels((size_t)frame.size.x * frame.size.y);
+		for (int y = 0; y < frame.size.y; y++) {
+			const uint32_t* src = (const uint32_t*)(frame.pixels + (size_t)(frame.size.y - 1 - y) * frame.stride);
+			uint32_t* dst = pixels.data() + (size_t)y * frame.size.x;
+			for (int x = 0; x < frame.size.x; x++) dst[x] = src[x] | 0xff000000;
+		}
+		std::string path = "congol_" + std::to_string(std::time(nullptr)) + "_screen.webp";
+		((Grid*)userptr)->exporter_.save_pixels(path, std::move(pixels), frame.size);
+	}, this);
+}
+
+void Grid::import_image(const std::string& path) {
+	uint64_t start = fan::time::clock::now();
+
+	Bitplane image;
+	fan::webp::channel_t channel = import_alpha ? fan::webp::channel_t::alpha : fan::webp::channel_t::luma;
+	if (!Importer::load(path, channel, import_threshold, import_invert, image)) {
+		fan_log_error("Image import failed:", path);
+		return;
+	}
+
+	if (!load_bitplane(image)) {
+		fan_log_error("Image import failed:", path, image.width(), "x", image.height(), "is larger than", max_load_side, "x", max_load_side, "cells");
+		return;
+	}
+	fan_log_info("Imported", path, image.width(), "x", image.height(), "in ms:", (fan::time::clock::now() - start) / 1e6);
+}
+
+bool Grid::load_bitplane(const Bitplane& bitplane) {
+	if (std::max(bitplane.width(), bitplane.height()) > max_load_side) return false;
+
+	int side = get_window_divisor();
+	if (bitplane.width() > side || bitplane.height() > side) {
+		side = std::max(bitplane.width(), bitplane.height());
+		resize_grid(side);
+	}
+
+	// Centered, everything outside the bitplane is dead
+	const int x0 = (side - bitplane.width()) / 2;
+	const int y0 = (side - bitplane.height()) / 2;
+	fan::parallel_for(side, [&](uint64_t begin, uint64_t end) {
+		for (uint64_t y = begin; y < end; y++)
+		{
+			Cell* row = &cells_[y * side];
+			int by = (int)y - y0;
+			bool inside = by >= 0 && by < bitplane.height();
+			for (int x = 0; x < side; x++)
+			{
+				int bx = x - x0;
+				row[x].alive = inside && bx >= 0 && bx < bitplane.width() && bitplane.get(bx, by);
+			}
+		}
+	}, 16);
+
+	bitplane_dirty_ = true;
+	cursor_cell_ = -1;
+	return true;
+}
+
+void Grid::serve(uint16_t port) {
+	try {
+		broadcaster_.start(port);
+	}
+	catch (const std::exception& e) {
+		fan_log_error("Failed to serve spectators:", e.what());
+		return;
+	}
+	fan_log_info("Serving spectators on port", broadcaster_.port());
+}
+
+void Grid::spectate(const std::string& host, uint16_t port) {
+	ticking_ = false;
+	spectator_.connect(host, port);
+	fan_log_info("Spectating", host + ":" + std::to_string(port));
+}
+
+void Grid::share(const std::string& name) {
+	update_bitplane();
+	try {
+		ring_.open(name, bitplane_.width(), bitplane_.height());
+	}
+	catch (const std::exception& e) {
+		fan_log_error("Failed to share generations:", e.what());
+		return;
+	}
+	fan_log_info("Sharing generations as", name);
+	ring_.publish(bitplane_, slot_); // readers start from the current state
+}
+
+void Grid::control(const std::string& path) {
+	try {
+		controller_.open(path);
+	}
+	catch (const std::exception& e) {
+		fan_log_error("Failed to open control socket:", e.what());
+		return;
+	}
+	fan_log_info("Control socket at", path);
+}
+
+void Grid::update_control() {
+	fan_trace_scope("control", "requests");
+	const uint64_t start = fan::time::clock::now();
+	while (!control_queue_.empty()) {
+		if (!execute(control_queue_.front(), start)) return;
+		control_queue_.pop_front();
+	}
+}
+
+void Grid::write_state(Controller::writer_t& out) {
+	update_bitplane();
+	uint64_t population = 0;
+	const uint64_t words = (uint64_t)bitplane_.words_per_row() * bitplane_.height();
+	for (uint64_t i = 0; i < words; i++) population += std::popcount(bitplane_.row(0)[i]);
+	out.put((uint64_t)slot_);
+	out.put(population);
+	out.put((uint32_t)get_window_divisor());
+	out.put((uint8_t)ticking_);
+}
+
+bool Grid::execute(const Controller::request_t& request, uint64_t start) {
+	// generations run per frame before the window gets its turn again
+	const uint64_t budget = 10000000;
+
+	Controller::reader_t in{ request.arguments };
+	Controller::writer_t out;
+	const int side = get_window_divisor();
+	auto fail = [&](const std::string& message) {
+		controller_.reply(request, Controller::error, message);
+		return true;
+	};
+
+	switch (request.command) {
+	case Controller::step:
+	case Controller::run_until: {
+		if (!control_running_) {
+			control_target_ = request.command == Controller::step ? slot_ + in.get<uint32_t>() : in.get<uint64_t>();
+			if (!in.ok) return fail("missing generation count");
+			control_running_ = true;
+		}
+		while (slot_ < control_target_) {
+			if (fan::time::clock::now() - start >= budget) return false;
+			evolve();
+		}
+		control_running_ = false;
+		break;
+	}
+	case Controller::pause: {
+		ticking_ = false;
+		break;
+	}
+	case Controller::stats: {
+		break;
+	}
+	case Controller::set_cells: {
+		bool alive = in.get<uint8_t>();
+		uint32_t count = in.get<uint32_t>();
+		if (!in.ok || (request.arguments.size() - in.offset) / 8 < count) return fail("truncated cell list");
+		for (uint32_t i = 0; i < count; i++) {
+			uint32_t x = in.get<uint32_t>();
+			uint32_t y = in.get<uint32_t>();
+			if (x >= (uint32_t)side || y >= (uint32_t)side) return fail("cell outside the grid");
+			cells_[(size_t)y * side + x].alive = alive;
+		}
+		bitplane_dirty_ = true;
+		cursor_cell_ = -1;
+		controller_.reply(request, Controller::ok);
+		return true;
+	}
+	case Controller::write_region:
+	case Controller::read_region: {
+		uint32_t x0 = in.get<uint32_t>(), y0 = in.get<uint32_t>(), width = in.get<uint32_t>(), height = in.get<uint32_t>();
+		if (!in.ok) return fail("missing region");
+		if (x0 > (uint32_t)side || y0 > (uint32_t)side || width > side - x0 || height > side - y0) return fail("region outside the grid");
+		const size_t row_bytes = (width + 7) / 8;
+
+		if (request.command == Controller::write_region) {
+			const uint8_t* bits = in.bytes(row_bytes * height);
+			if (!in.ok) return fail("truncated region");
+			for (uint32_t y = 0; y < height; y++) {
+				Cell* row = &cells_[(size_t)(y0 + y) * side + x0];
+				const uint8_t* src = bits + y * row_bytes;
+				for (uint32_t x = 0; x < width; x++) row[x].alive = src[x / 8] >> (x % 8) & 1;
+			}
+			bitplane_dirty_ = true;
+			cursor_cell_ = -1;
+			controller_.reply(request, Controller::ok);
+			return true;
+		}
+
+		out.put(width);
+		out.put(height);
+		out.data.reserve(out.data.size() + row_bytes * height);
+		for (uint32_t y = 0; y < height; y++) {
+			const Cell* row = &cells_[(size_t)(y0 + y) * side + x0];
+			for (uint32_t x = 0; x < width; x += 8) {
+				uint8_t byte = 0;
+				for (uint32_t i = 0; i < 8 && x + i < width; i++) byte |= (uint8_t)row[x + i].alive << i;
+				out.data.push_back((char)byte);
+			}
+		}
+		controller_.reply(request, Controller::ok, out.data);
+		return true;
+	}
+	case Controller::checkpoint: {
+		std::string path = in.rest();
+		update_bitplane();
+		std::string data;
+		Delta::write_header(data, { Delta::keyframe, 0, (uint64_t)slot_, fan::time::clock::now(), (uint32_t)bitplane_.width(), (uint32_t)bitplane_.height() });
+		const size_t words = (size_t)bitplane_.words_per_row() * bitplane_.height();
+		if (words == 0 || !Delta::encode(data, bitplane_.row(0), nullptr, words)) data.push_back((char)Delta::runs);
+		std::ofstream file(path, std::ios_base::binary | std::ios_base::trunc);
+		if (!file.write(data.data(), data.size())) return fail("failed to write " + path);
+		out.put((uint64_t)data.size());
+		controller_.reply(request, Controller::ok, out.data);
+		return true;
+	}
+	case Controller::restore: {
+		std::string path = in.rest();
+		std::string data;
+		try {
+			data = fan::io::file::read(path);
+		}
+		catch (const std::exception&) {
+			return fail("failed to read " + path);
+		}
+		const char* p = data.data();
+		size_t size = data.size();
+		Delta::header_t header;
+		if (!Delta::read_header(p, size, header) || header.type != Delta::keyframe || (uint64_t)header.width * header.height > ((uint64_t)1 << 30)) {
+			return fail("not a checkpoint: " + path);
+		}
+		// the grid is square, checkpoints are written from it
+		if (header.width != header.height || header.width == 0 || header.generation > UINT32_MAX) return fail("not a checkpoint of this grid: " + path);
+		if (header.width > (uint32_t)max_load_side) return fail("checkpoint larger than " + std::to_string(max_load_side) + " cells a side: " + path);
+		Bitplane bitplane;
+		bitplane.resize(header.width, header.height);
+		const size_t words = (size_t)bitplane.words_per_row() * bitplane.height();
+		if (words && !Delta::decode(p, size, bitplane.row(0), words)) return fail("corrupt checkpoint: " + path);
+
+		// exactly the checkpointed universe: same size, same generation, no undo into what came before it
+		if ((uint32_t)get_window_divisor() != header.width) resize_grid(header.width);
+		load_bitplane(bitplane);
+		slot_ = (uint32_t)header.generation;
+		history_.clear();
+		history_first_ = 0;
+		break;
+	}
+	default:
+		return fail("unknown command " + std::to_string(request.command));
+	}
+
+	write_state(out);
+	controller_.reply(request, Controller::ok, out.data);
+	return true;
+}
+
+bool Grid::poll_spectated() {
+	if (!spectator_.spectating()) return false;
+	fan_trace_scope("network", "spectate");
+	if (!spectator_.poll(remote_, remote_generation_)) return false;
+	const bool rejected = !load_bitplane(remote_);
+	if (rejected != spectate_rejected_) {
+		spectate_rejected_ = rejected;
+		if (rejected) fan_log_error("Spectated universe", remote_.width(), "x", remote_.height(), "is larger than", max_load_side, "x", max_load_side, "cells, not shown");
+		else fan_log_info("Spectated universe shown again");
+	}
+	return !rejected;
+}
+
+void Grid::publish_generation() {
+	if (!broadcaster_.serving()) return;
+	fan_trace_scope("network", "publish");
+	update_bitplane();
+	broadcaster_.publish(bitplane_, slot_); // unchanged universe sends nothing
+}
+
 Grid::cellvec2 Grid::cv_to_cv2D(cellvec& cv) {
 	cellvec2 cv2;
 
@@ -196,40 +679,45 @@ Grid::cellvec Grid::cv2D_to_cv(cellvec2& cv2) {
 
 // Apply the game rules & necessary corrections upon boundary overlaps (side overlap
 void Grid::evolve() {
+	fan_trace_scope("simulation", "evolve");
+
 	// unimplemented
 	//cellvec2 cells2D_ = cv_to_cv2D(this->cells_); // convert cells from 1D to 2D
 	// unimplemented ^^^^^^
 
-	std::vector<Cell> live_cells = get_live_cells();
-
 	// Save current state
 	slot_++;
-	history_.push_back(CellData(this->cells_, this->map_, this->cell_size_));
-	fan::print("Evolved   to slot: ", slot_);
+	push_history();
+	fan_log_debug("Evolved   to slot:", slot_); // every generation, rate limited & gone in release builds
 	//
 
-	std::vector<int> live_indices;
-	std::vector<int> kill_indices; // is there a better, in this case, more readable solution?
-
-	
+	// scratch, freed with the frame (context->render)
+	fan::arena_allocator_t<int> frame_allocator(&context->m_frame_arena);
+	std::vector<int, fan::arena_allocator_t<int>> live_indices(frame_allocator);
+	std::vector<int, fan::arena_allocator_t<int>> kill_indices(frame_allocator); // is there a better, in this case, more readable solution?
 
-	for (int i = 0; i < live_cells.size(); i++)
+	for (int c = 0; c < cells_.size(); c++)
 	{
+		if (!cells_[c].alive) continue;
+
+		Perimeter cell_perimeter = cells_[c].perimeter(*(this)); // get perimeter of live cell
+		int live_neighbours = count_live_cells(cell_perimeter);
+
 		// Any live cell with fewer than two live neighbours dies, as if by underpopulation
-		if (get_live_cells(live_cells[i].perimeter(*(this))).size() < 2) kill_indices.push_back(live_cells[i].index);
+		if (live_neighbours < 2) kill_indices.push_back(cells_[c].index);
 
 		// Any live cell with two or three live neighbours lives on to the next generation
-		if (get_live_cells(live_cells[i].perimeter(*(this))).size() == 2 || get_live_cells(live_cells[i].perimeter(*(this))).size() == 3) live_indices.push_back(live_cells[i].index);
+		if (live_neighbours == 2 || live_neighbours == 3) live_indices.push_back(cells_[c].index);
 
 		// Any live cell with more than three live neighbours dies, as if by overpopulation
-		if (get_live_cells(live_cells[i].perimeter(*(this))).size() > 3) kill_indices.push_back(live_cells[i].index);
+		if (live_neighbours > 3) kill_indices.push_back(cells_[c].index);
 
 		// Any dead cell with exactly three live neighbours becomes a live cell, as if by reproduction (not added to queue as release moment doesn't matter for last one)
-		std::vector<Cell> cell_perimeter = live_cells[i].perimeter(*(this)); // get perimeter of i (live_cell)
 		for (int i = 0; i < cell_perimeter.size(); i++)
 		{
 			// Takes perimeters of perimeter cells
-			if (get_live_cells(cell_perimeter[i].perimeter(*(this))).size() == 3)
+			Perimeter neighbour_perimeter = cell_perimeter[i].perimeter(*(this));
+			if (count_live_cells(neighbour_perimeter) == 3)
 			{
 				live_indices.push_back(cell_perimeter[i].index);
 			}
@@ -247,59 +735,379 @@ void Grid::evolve() {
 	{
 		cells_[live_indices[i]].alive = true;
 	}
+
+	bitplane_dirty_ = true;
+
+	if (recorder_.recording() || exporter_.animating() || ring_.is_open()) {
+		fan_trace_scope("simulation", "record");
+		update_bitplane();
+		if (recorder_.recording()) recorder_.capture(bitplane_);
+		exporter_.add_generation(bitplane_);
+		if (ring_.is_open() && !ring_.publish(bitplane_, slot_)) {
+			fan_log_error("Stopped sharing generations, the shared memory couldn't grow to", bitplane_.width(), "x", bitplane_.height());
+		}
+	}
+}
+
+void Grid::push_history() {
+	const uint64_t bytes = cells_.size() * sizeof(Cell) + map_.size() * sizeof(fan::vec2);
+	const size_t capacity = std::max<uint64_t>(history_budget / std::max<uint64_t>(bytes, 1), 1);
+
+	if (history_.size() == capacity) {
+		// overwrite the oldest, assigning keeps its buffers so a full ring doesn't allocate
+		CellData& oldest = history_[history_first_];
+		oldest.cells_ = cells_;
+		oldest.map_ = map_;
+		oldest.cell_size_ = cell_size_;
+		history_first_ = (history_first_ + 1) % history_.size();
+		return;
+	}
+
+	// oldest first, then drop what doesn't fit anymore if the grid grew
+	std::rotate(history_.begin(), history_.begin() + history_first_, history_.end());
+	history_first_ = 0;
+	if (history_.size() >= capacity) history_.erase(history_.begin(), history_.end() - (capacity - 1));
+	history_.push_back(CellData(cells_, map_, cell_size_));
 }
 
 void Grid::devolve() {
-	if (slot_ != 0) {
+	if (slot_ != 0 && !history_.empty()) {
 		--slot_;
-		import(history_[slot_]);
+		// newest entry last
+		std::rotate(history_.begin(), history_.begin() + history_first_, history_.end());
+		history_first_ = 0;
+		import(history_.back());
 		history_.pop_back();
-		fan::print("Devolved  to slot: ", slot_);
+		fan_log_debug("Devolved  to slot:", slot_);
 	}
 }
 
 uint32_t Grid::translate_mouse_to_gridmap() {  // could use a better; shorter name without sacrificing readability
-	fan::vec2i cell_origin = (window->get_mouse_position() / cell_size_).floor();
+	fan::vec2i cell_origin = (screen_to_world(window->get_mouse_position()) / cell_size_).floor();
 
-	uint32_t index = cell_origin.y * get_window_divisor() + cell_origin.x;
+	// x & y checked apart, a flat index would wrap a click beside the grid into the next row
+	const int side = get_window_divisor();
+	if (cell_origin.x < 0 || cell_origin.y < 0 || cell_origin.x >= side || cell_origin.y >= side) return no_cell;
 
-	return fan::clamp(index, (uint32_t)0, (uint32_t)cells_.size() - 1); // clamp index between boundaries & return
+	return cell_origin.y * side + cell_origin.x;
 }
 
 void Grid::set_alive_at_click() {
-	int i = translate_mouse_to_gridmap();
+	uint32_t i = translate_mouse_to_gridmap();
+	if (i == no_cell) return;
 	cells_[i].alive = true;
-	rects_.set_color(context, 1, color_alive_); // a confusing line - updates the highlight filler to match the new state ... refactor away
+	bitplane_dirty_ = true;
 	update_cursor_highlight();
 }
 
 void Grid::set_dead_at_click() {
-	int i = translate_mouse_to_gridmap();
+	uint32_t i = translate_mouse_to_gridmap();
+	if (i == no_cell) return;
 	cells_[i].alive = false;
-	rects_.set_color(context, 1, color_dead_); // a confusing line - updates the highlight filler to match the new state ... refactor away
+	bitplane_dirty_ = true;
 	update_cursor_highlight();
 }
 
 // Draw based on object data
 void Grid::draw() {
+	// Cells smaller than a pixel - draw densities instead, cost depends on screen size rather than cell count
+	// The cell buffer isn't built until the cells are drawn one by one
+	lod_active_ = cell_size_.x * zoom_ < 1;
+	if (lod_active_) {
+		draw_lod();
+		update_cursor_highlight();
+		return;
+	}
+
+	// cells_ changed since the colors were last written
+	update_bitplane();
+	const bool changed = rects_version_ != bitplane_version_;
+	rects_version_ = bitplane_version_;
+
+	// A grid of another size needs the buffer built again
+	if (drawn_alive_.size() != cells_.size() && rects_.size(context)) rects_.clear(context);
+
 	// Initialize grid_ for drawing if uninitialized 
 	if (rects_.size(context) == 0) { 
-		for (int i = 0; i < cells_.size(); i++)
-		{
-			fan_2d::graphics::rectangle_t::properties_t p;
-			p.position = map_[i] - p.size;
+		uint64_t start = fan::time::clock::now();
+
+		// One allocation & one upload for the whole grid
+		drawn_alive_.resize(cells_.size());
+		rects_.push_back(context, cells_.size(), [&](uint32_t i, fan_2d::graphics::rectangle_packed_axis_aligned_t::properties_t& p) {
+			p.position = map_[i];
 			p.size = cell_size_ / 2;
-			p.color = color_dead_;
-			rects_.push_back(context, p);
+			p.color = cells_[i].alive ? color_alive_ : color_dead_;
+			drawn_alive_[i] = cells_[i].alive;
+		});
+
+		fan_log_info("Grid buffer built in ms:", (fan::time::clock::now() - start) / 1e6, "shadow copy bytes saved:", rects_.m_glsl_buffer.get_shadow_bytes_saved());
+	}
+	else if (changed) {
+		// Only cells that changed state get a new color (alive? dead?)
+		for (uint32_t i = 0; i < cells_.size(); i++)
+		{
+			if (cells_[i].alive == drawn_alive_[i]) continue;
+			drawn_alive_[i] = cells_[i].alive;
+			rects_.set_color(context, i, cells_[i].alive ? color_alive_ : color_dead_);
 		}
 	}
 
-	// Determine and set cell color (alive? dead?)
+	update_cursor_highlight();
+}
+
+fan::vec2 Grid::screen_to_world(const fan::vec2& position) {
+	return (position + camera_position_) / zoom_;
+}
+
+void Grid::zoom_at(const fan::vec2& position, f32_t factor) {
+	fan::vec2 world = screen_to_world(position);
+
+	zoom_ = fan::clamp(zoom_ * factor, 1.f / 256, 64.f);
+
+	// keep world point under cursor
+	camera_position_ = world * zoom_ - position;
+	update_camera();
+}
+
+void Grid::pan(const fan::vec2& offset) {
+	camera_position_ += offset;
+	update_camera();
+}
+
+void Grid::update_camera() {
+	context->camera.set_position(fan::vec3(camera_position_.x, camera_position_.y, 0));
+	context->camera.set_zoom(zoom_);
+}
+
+void Grid::update_bitplane() {
+	if (!bitplane_dirty_) return;
+
+	const int side = get_window_divisor();
+	bitplane_.resize(side, side);
 	for (int i = 0; i < cells_.size(); i++)
 	{
-		if (cells_[i].alive) { rects_.set_color(context, i, color_alive_); }
-		else { rects_.set_color(context, i, color_dead_); };// If cell is alive, color - else, leave black (dead)
+		if (cells_[i].alive) bitplane_.set(i % side, i / side, true);
 	}
+	bitplane_dirty_ = false;
+	bitplane_version_++;
+}
 
-	update_cursor_highlight();
-}
\ No newline at end of file
+void Grid::draw_lod() {
+	const int side = get_window_divisor();
+
+	// bitplane may have been rebuilt elsewhere (recording, export, ring, serving) since the last upload
+	update_bitplane();
+	bool rebuilt = lod_version_ != bitplane_version_;
+
+	// Smallest power of two block of cells that covers a pixel
+	int block = 2;
+	while (cell_size_.x * zoom_ * block < 1 && block < side) block *= 2;
+
+	// Visible cells only, x aligned to whole words of the bitplane
+	fan::vec2 first = screen_to_world(0) / cell_size_;
+	fan::vec2 last = screen_to_world(window->get_size()) / cell_size_;
+
+	int x0 = fan::clamp((int)std::floor(first.x), 0, side);
+	int y0 = fan::clamp((int)std::floor(first.y), 0, side);
+	int x1 = fan::clamp((int)std::ceil(last.x), 0, side);
+	int y1 = fan::clamp((int)std::ceil(last.y), 0, side);
+	x0 -= x0 % std::max(64, block);
+	y0 -= y0 % block;
+
+	if (x1 <= x0 || y1 <= y0) {
+		lod_sprite_.clear(context);
+		return;
+	}
+
+	const int w = (x1 - x0 + block - 1) / block;
+	const int h = (y1 - y0 + block - 1) / block;
+
+	// Nothing moved since last frame
+	const int view[] = { x0, y0, w, h, block };
+	if (!rebuilt && lod_sprite_.size(context) && std::equal(std::begin(view), std::end(view), lod_view_)) {
+		return;
+	}
+	std::copy(std::begin(view), std::end(view), lod_view_);
+	lod_version_ = bitplane_version_;
+
+	lod_density_.resize((size_t)w * h);
+	bitplane_.density(x0, y0, block, w, h, lod_density_.data());
+
+	// density -> color, blended between dead & alive
+	uint32_t palette[256];
+	for (int i = 0; i < 256; i++)
+	{
+		f32_t t = i / 255.f;
+		auto channel = [&](f32_t dead, f32_t alive) { return (uint32_t)((dead + (alive - dead) * t) * 255 + 0.5f); };
+		palette[i] =
+			channel(color_dead_.r, color_alive_.r) |
+			channel(color_dead_.g, color_alive_.g) << 8 |
+			channel(color_dead_.b, color_alive_.b) << 16 |
+			channel(color_dead_.a, color_alive_.a) << 24;
+	}
+	lod_pixels_.resize(lod_density_.size());
+	for (size_t i = 0; i < lod_density_.size(); i++)
+	{
+		lod_pixels_[i] = palette[lod_density_[i]];
+	}
+
+	if (lod_image_ == nullptr || lod_image_->size != fan::vec2i(w, h)) {
+		if (lod_image_ != nullptr) {
+			fan::opengl::unload_image(context, lod_image_);
+			delete lod_image_;
+		}
+		fan::webp::image_info_t info;
+		info.data = (uint8_t*)lod_pixels_.data();
+		info.size = fan::vec2i(w, h);
+		lod_image_ = fan::opengl::load_image(context, info);
+	}
+	else {
+		context->opengl.bind_texture(fan::opengl::GL_TEXTURE_2D, lod_image_->texture);
+		context->opengl.glTexSubImage2D(fan::opengl::GL_TEXTURE_2D, 0, 0, 0, w, h, fan::opengl::GL_RGBA, fan::opengl::GL_UNSIGNED_BYTE, lod_pixels_.data());
+	}
+
+	fan::vec2 size = fan::vec2(w * block, h * block) * cell_size_;
+
+	fan_2d::graphics::sprite_t::properties_t p;
+	p.image = lod_image_;
+	p.position = fan::vec2(x0, y0) * cell_size_ + size / 2;
+	p.size = size / 2;
+	lod_sprite_.clear(context);
+	lod_sprite_.push_back(context, p);
+}
+
+void Grid::update_profiler_hud() {
+	if (!show_profiler) {
+		if (hud_shown_) {
+			hud_.clear(context);
+			hud_shown_ = false;
+		}
+		return;
+	}
+
+	// opened lazily, needs font files
+	if (!hud_open_) {
+		hud_.open(context);
+		context->enable_draw(this, [](fan::opengl::context_t* c, void* d) {
+			// overlay is in window coordinates, ignore zoom & pan
+			fan::vec3 position = c->camera.get_position();
+			f32_t zoom = c->camera.get_zoom();
+			c->camera.set_position(0);
+			c->camera.set_zoom(1);
+			((Grid*)d)->hud_.draw(c);
+			c->camera.set_position(position);
+			c->camera.set_zoom(zoom);
+		});
+		hud_open_ = true;
+	}
+
+	// rebuilding text every frame would cost more than most of the phases measured
+	uint64_t now = fan::time::clock::now();
+	if (hud_shown_ && now - hud_refresh_ < 250000000) return;
+	hud_refresh_ = now;
+	hud_shown_ = true;
+
+	hud_.clear(context);
+
+	const f32_t font_size = 14;
+	const f32_t line_height = fan_2d::opengl::gui::text_renderer_t::get_line_height(context, font_size);
+	const f32_t columns[] = { 10, 90, 150, 210, 270 };
+
+	// left aligned, text renderer positions by center
+	auto push = [&](const std::string& text, int column, int row) {
+		fan_2d::opengl::gui::text_renderer_t::properties_t p;
+		p.text = text;
+		p.font_size = font_size;
+		p.text_color = fan::colors::yellow;
+		p.outline_color = fan::colors::black;
+		fan::vec2 size = fan_2d::opengl::gui::text_renderer_t::get_text_size(context, p.text, font_size);
+		p.position = fan::vec2(columns[column] + size.x / 2, 10 + line_height * row);
+		hud_.push_back(context, p);
+	};
+
+	const char* header[] = { "ms", "last", "avg", "p99", "max" };
+	for (int i = 0; i < std::size(header); i++) push(header[i], i, 0);
+
+	for (uint32_t i = 0; i < profiler_.phase_count(); i++)
+	{
+		auto stats = profiler_.get_stats(i);
+		const uint64_t values[] = { stats.last, stats.average, stats.p99, stats.max };
+
+		push(profiler_.get_name(i), 0, i + 1);
+		for (int j = 0; j < std::size(values); j++)
+		{
+			char buffer[32];
+			snprintf(buffer, sizeof(buffer), "%.3f", values[j] / 1e6);
+			push(buffer, j + 1, i + 1);
+		}
+	}
+
+	// whole frame period as seen by the fps limiter, since start
+	uint32_t row = profiler_.phase_count() + 1;
+	const fan::time::frame_histogram_t& frames = window->get_frame_pacer().get_histogram();
+	const uint64_t frame_values[] = { frames.average(), frames.percentile(0.99), frames.max() };
+	push("frame", 0, row);
+	for (int j = 0; j < std::size(frame_values); j++)
+	{
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.3f", frame_values[j] / 1e6);
+		push(buffer, j + 2, row);
+	}
+	row++;
+
+	// binds/toggles of the previous frame that reached the driver vs were skipped by the state cache
+	const fan::opengl::opengl_t::state_stats_t& gl_stats = context->opengl.get_frame_state_stats();
+	push("gl calls", 0, row);
+	push(std::to_string(gl_stats.issued), 1, row);
+	push("elided", 2, row);
+	push(std::to_string(gl_stats.elided), 4, row);
+	row++;
+
+	if (recorder_.recording()) {
+		auto stats = recorder_.stats();
+		push("rec", 0, row);
+		push(std::to_string(stats.encoded), 1, row);
+		push("dropped", 2, row);
+		push(std::to_string(stats.dropped), 4, row);
+		row++;
+	}
+
+	if (exporter_.animating()) {
+		auto stats = exporter_.stats();
+		push("export", 0, row);
+		push(std::to_string(stats.backlog), 1, row);
+		push("dropped", 2, row);
+		push(std::to_string(stats.dropped), 4, row);
+		row++;
+	}
+
+	if (broadcaster_.serving()) {
+		auto stats = broadcaster_.stats();
+		push("serve", 0, row);
+		push(std::to_string(stats.spectators), 1, row);
+		push("KiB", 2, row);
+		push(std::to_string(stats.bytes / 1024), 4, row);
+		row++;
+	}
+
+	if (spectator_.spectating()) {
+		// broadcast to applied, same clock only on the same machine
+		auto stats = spectator_.stats();
+		uint64_t frames = std::max<uint64_t>(stats.keyframes + stats.deltas, 1);
+		char latency[32];
+		snprintf(latency, sizeof(latency), "%.3f", stats.latency / frames / 1e6);
+		push("spectate", 0, row);
+		push(std::to_string(remote_generation_), 1, row);
+		push("ms", 2, row);
+		push(latency, 4, row);
+		row++;
+	}
+
+#if fan_count_allocations
+	// should stay 0 while nothing changes, refresh frames aren't the ones shown
+	push("allocs", 0, row);
+	push(std::to_string(frame_allocations_), 1, row);
+	push("arena KiB", 2, row);
+	push(std::to_string(context->m_frame_arena.peak() / 1024), 4, row);
+#endif
+}
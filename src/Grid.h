@@ -1,12 +1,30 @@
 #pragma once
 
 #include <fan/graphics/gui.h>
+#include <deque>
 #include <vector>
 #include "Grid.h"
+#include "Bitplane.h"
+#include "Recorder.h"
+#include "Exporter.h"
+#include "Importer.h"
+#include "Broadcaster.h"
+#include "Spectator.h"
+#include "UniverseRing.h"
+#include "Controller.h"
+
+#include <fan/time/profiler.h>
+#include <fan/time/trace.h>
+#include <fan/types/allocation_counter.h>
+#include <fan/io/log.h>
+#include <fan/parallel.h>
 
 class Grid
 {
+	friend class Bench; // seeds cells_ for the allocation check
 private:
+	struct Perimeter;
+
 	struct Cell { // Could use refactoring, perhaps
 		int index;
 		bool alive;
@@ -16,53 +34,20 @@ private:
 			this->index = index;
 		}
 
-		// Returns indices (8) around a cell (top to bottom)
-		std::vector<Cell> perimeter(Grid& grid) {
-			int i = index;
-
-			// lazy solution, but scalable - definitely in need of a better one
-			std::vector<Cell> perimeter;
-			int vertical_increment = std::sqrt(grid.cells_.size());
-
-			
-			i = i - vertical_increment - 1;
-			if (i == (0 - vertical_increment - 1)) {
-				perimeter.push_back(grid.cells_.back());
-			}
-			else if (i == (0 - vertical_increment)) {
-				perimeter.push_back(grid.cells_[Corners(grid).LowerLeft]);
-			}
-			else if (i == (0 - vertical_increment + 1)) {
-
-			}
-			else perimeter.push_back(grid.cells_[i]);
-
-			i++;
-			perimeter.push_back(grid.cells_[i]);
-
-			i++;
-			perimeter.push_back(grid.cells_[i]);
-
-			i = i + vertical_increment - 2;
-			perimeter.push_back(grid.cells_[i]);
-
-			/*i++;							// the cell itself
-			perimeter.push_back(i);*/
-
-			i = i + 2;
-			perimeter.push_back(grid.cells_[i]);
-
-			i = i + vertical_increment - 2;
-			perimeter.push_back(grid.cells_[i]);
+		Cell() {}
 
-			i++;
-			perimeter.push_back(grid.cells_[i]);
+		// Returns cells (up to 8) around a cell (top to bottom)
+		Perimeter perimeter(Grid& grid);
+	};
 
-			i++;
-			perimeter.push_back(grid.cells_[i]);
+	// Fixed size so evolve doesn't allocate per cell
+	struct Perimeter {
+		Cell cells[8];
+		int count = 0;
 
-			return perimeter;
-		}
+		void push_back(const Cell& cell) { cells[count++] = cell; }
+		int size() const { return count; }
+		Cell& operator[](int i) { return cells[i]; }
 	};
 
 	struct Corners {
@@ -71,7 +56,7 @@ private:
 		int LowerLeft;
 		int LowerRight;
 
-		Corners(Grid grid)
+		Corners(Grid& grid)
 			:
 			UpperLeft(0), 
 			UpperRight(std::sqrt(grid.cells_.size()) - 1), 
@@ -130,7 +115,7 @@ private:
 		fan::vec2 cell_size_;
 		
 		CellData() {}
-		CellData(std::vector<Cell> cells, std::vector<fan::vec2> map, fan::vec2 cell_size) {
+		CellData(const std::vector<Cell>& cells, const std::vector<fan::vec2>& map, fan::vec2 cell_size) {
 			cells_ = cells;
 			map_ = map;
 			cell_size_ = cell_size;
@@ -152,9 +137,67 @@ public:
 private:
 	//inline static fan_2d::graphics::gui::text_renderer* text_;
 	
-	fan_2d::graphics::rectangle_t rects_;
+	fan_2d::graphics::rectangle_packed_axis_aligned_t rects_; // cells are axis aligned, 12 bytes per vertex instead of 60
 	fan_2d::graphics::rectangle_t cursor_rects_;
 
+	// Camera, position is in zoomed units (screen = world * zoom - position), see fan::camera::get_view_matrix
+	fan::vec2 camera_position_ = 0;
+	f32_t zoom_ = 1;
+
+	// Level of detail, used when a cell is smaller than a pixel - one texel per block of cells
+	Bitplane bitplane_;
+	bool bitplane_dirty_ = true;
+	uint64_t bitplane_version_ = 0; // counts rebuilds of bitplane_
+	bool lod_active_ = false;
+	fan_2d::graphics::sprite_t lod_sprite_;
+	fan::opengl::image_t* lod_image_ = nullptr;
+	std::vector<uint8_t> lod_density_;
+	std::vector<uint32_t> lod_pixels_;
+	int lod_view_[5] = {}; // x0, y0, width, height, block of last upload
+	uint64_t lod_version_ = 0; // bitplane_version_ of last upload
+	uint64_t rects_version_ = 0; // bitplane_version_ the cell colors in rects_ were last written for
+	std::vector<uint8_t> drawn_alive_; // state each cell's color in rects_ shows
+
+	// Video of the run, fed from evolve()
+	Recorder recorder_;
+	// WebP images & animations, also fed from evolve()
+	Exporter exporter_;
+
+	// Live universe to spectators (serve), or a remote universe mirrored here (spectate)
+	Broadcaster broadcaster_;
+	Spectator spectator_;
+	Bitplane remote_; // latest spectated universe, copied out of the spectator
+	uint64_t remote_generation_ = 0;
+
+	// Generations for local processes to map, also fed from evolve()
+	UniverseRing ring_;
+
+	// Scripted control, requests run in order from update_control(). A step/run_until at the front runs over several frames
+	Controller controller_;
+	std::deque<Controller::request_t> control_queue_;
+	bool control_running_ = false;
+	uint64_t control_target_ = 0;
+
+	// Frame phase timings (see run()), shown with show_profiler
+	fan::time::profiler_t profiler_;
+	struct {
+		uint32_t events;
+		uint32_t input;
+		uint32_t evolve;
+		uint32_t draw;
+		uint32_t process;
+		uint32_t render;
+	} phase_;
+	fan_2d::opengl::gui::text_renderer_t hud_;
+	bool hud_open_ = false;
+	bool hud_shown_ = false;
+	uint64_t hud_refresh_ = 0;
+	uint64_t frame_allocations_ = 0; // heap allocations during last frame, counted in debug builds
+
+	// Last highlighted cell & its state, edits are queued only when either changes
+	int cursor_cell_ = -1;
+	bool cursor_alive_ = false;
+
 	
 
 	// Current save slot
@@ -163,11 +206,52 @@ private:
 	const int horizontal_increment_ = 1;
 
 	// Stores each generation of cells, or more generally, each movement
+	// ring of the latest generations that fit history_budget, the oldest is overwritten (its storage reused) once full
+	static constexpr uint64_t history_budget = 64ull << 20;
 	std::vector<CellData> history_;
+	size_t history_first_ = 0; // oldest entry of history_
 	std::vector<fan::vec2> map_; // Grid coordinates of each cell (for graphical representation of cells)
 	std::vector<Cell> cells_;	// Stores cell data
 	fan::vec2 cell_size_;
 
+	// Opens cell & level of detail objects and hooks them to the draw queue
+	void open_graphics();
+
+	// Saves current cells as the newest undo state, see history_
+	void push_history();
+
+	// Rebuilds bitplane_ from cells_ if they changed since last call
+	void update_bitplane();
+
+	// Dead subdivisions x subdivisions cells & their mapping, graphics are left alone
+	void reset_cells(int subdivisions);
+
+	// reset_cells, then the cell & cursor graphics follow the new size
+	void resize_grid(int subdivisions);
+
+	// Replaces cells with bitplane, centered. Grid grows to the bitplane if it doesn't fit
+	// false & cells untouched when a side is above max_load_side - no cell of a universe is dropped
+	bool load_bitplane(const Bitplane& bitplane);
+
+	// Largest side load_bitplane grows the grid to, cells & their vertices take about a hundred bytes each
+	static constexpr int max_load_side = 4096;
+	bool spectate_rejected_ = false; // spectated universe too large to show, logged when it changes
+
+	// Applies the latest spectated generation, true if there was a new one
+	bool poll_spectated();
+
+	// Sends changes since the last call to spectators, once per frame
+	void publish_generation();
+
+	// Runs queued control requests until the queue is empty or the frame's time for it is used up
+	void update_control();
+
+	// false if request isn't finished yet (generations left to run)
+	bool execute(const Controller::request_t& request, uint64_t start);
+
+	// generation, population, side, ticking
+	void write_state(Controller::writer_t& out);
+
 	int get_window_divisor() {
 		return (int)sqrt(cells_.size());
 	}
@@ -177,7 +261,13 @@ private:
 		const int filler_rect_indice = 1;
 		const int cursor_rect_indice = 2;
 
-		int i = translate_mouse_to_gridmap();
+		uint32_t cell = translate_mouse_to_gridmap();
+		if (cell == no_cell) return; // keeps highlighting the last cell while the mouse is off the grid
+		int i = cell;
+		if (i == cursor_cell_ && cells_[i].alive == cursor_alive_) return;
+		cursor_cell_ = i;
+		cursor_alive_ = cells_[i].alive;
+
 		if (cells_[i].alive) {
 			cursor_rects_.set_color(context, filler_rect_indice, color_alive_);
 		}
@@ -197,6 +287,24 @@ public:
 	// Hook for external function (window.get_fps())
 	bool show_fps = false;
 
+	// Per phase frame timings overlay
+	bool show_profiler = false;
+
+	// Middle mouse drag
+	bool panning = false;
+
+	// Recording captures every n-th generation
+	int record_every = 1;
+
+	// Pixels per cell of exported images, optionally with lines between cells
+	int export_scale = 1;
+	bool export_gridlines = false;
+
+	// Imported pixels at or above the threshold (0-255) become live, alpha instead of luminance if import_alpha
+	int import_threshold = 128;
+	bool import_alpha = false;
+	bool import_invert = false;
+
 	inline static bool ticking_ = false;
 
 	fan::color color_alive_ = fan::colors::white;
@@ -216,6 +324,33 @@ public:
 	// Change state of simulation (play/pause)
 	void toggle_simulation();
 
+	// Start/stop recording generations to congol_<time>.ivf
+	void toggle_recording();
+
+	// Current generation to congol_<time>.webp
+	void export_image();
+
+	// Start/stop collecting generations into an animated congol_<time>.webp
+	void toggle_animation_export();
+
+	// Window contents (with zoom, overlays & cursor) to congol_<time>_screen.webp, read back asynchronously
+	void screenshot();
+
+	// Replaces cells with a thresholded WebP image, centered. Grid grows to the image if it doesn't fit
+	void import_image(const std::string& path);
+
+	// Streams the universe to spectators connecting to port (TCP)
+	void serve(uint16_t port);
+
+	// Mirrors the universe served at host:port, local simulation is paused while spectating
+	void spectate(const std::string& host, uint16_t port);
+
+	// Publishes every generation to shared memory name, see UniverseReader.h
+	void share(const std::string& name);
+
+	// Accepts scripted commands on a unix socket at path, see Controller.h
+	void control(const std::string& path);
+
 	// Convert from one-dimensional to two-dimensional vector of cells & vice-versa (provided the Grid::horizontal_increment_ is properly updated)
 	cellvec2 cv_to_cv2D(cellvec& cv);
 	cellvec cv2D_to_cv(cellvec2& cv2);
@@ -228,16 +363,35 @@ public:
 	// It's evolving, just backwards!
 	void devolve();
 
-	// Returns the corresponding cell map indice determined from mouse click point
+	// Returns the corresponding cell map indice determined from mouse click point, no_cell if the point is off the grid
+	static constexpr uint32_t no_cell = (uint32_t)-1;
 	uint32_t translate_mouse_to_gridmap();
 
+	// Window coordinates to grid coordinates, takes camera into account
+	fan::vec2 screen_to_world(const fan::vec2& position);
+
+	// Zooms by factor keeping the point under position in place
+	void zoom_at(const fan::vec2& position, f32_t factor);
+
+	// Moves view by offset (in pixels)
+	void pan(const fan::vec2& offset);
+
+	void update_camera();
+
 	void set_alive_at_click();
 
 	void set_dead_at_click();
 
 	std::vector<Cell> get_live_cells();
 	std::vector<Cell> get_live_cells(std::vector<Cell> cells);
+	int count_live_cells(Perimeter& perimeter);
 
 	void draw();
+
+	// Draws visible part of the grid as a density texture, one texel per power of two block of cells
+	void draw_lod();
+
+	// Refreshes profiler overlay text a few times per second
+	void update_profiler_hud();
 };
 
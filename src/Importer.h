@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include <fan/io/file.h>
+#include <fan/io/log.h>
+#include <fan/parallel.h>
+#include <fan/graphics/webp.h>
+
+#include "Bitplane.h"
+
+/// <summary>
+///
+/// Seeds a universe from a WebP image, a pixel becomes a live cell when its luminance (or alpha) reaches the threshold
+/// The image is decoded to one 8 bit plane and packed straight into bitplane rows, 64 cells per compare
+/// No per cell objects or RGBA copy, peak memory is the YUV(A) decode plus one bit per cell
+///
+/// </summary>
+
+class Importer {
+public:
+	// threshold is 0-255 in full range for either channel, invert makes pixels below it alive instead
+	static bool load(const std::string& path, fan::webp::channel_t channel, int threshold, bool invert, Bitplane& out) {
+		std::string data;
+		try {
+			data = fan::io::file::read(path);
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+
+		fan::webp::plane_t plane;
+		if (!fan::webp::decode_plane((const uint8_t*)data.data(), data.size(), channel, plane)) {
+			return false;
+		}
+		// compressed data isn't needed past decoding
+		std::string().swap(data);
+
+		threshold = std::clamp(threshold, 0, 255);
+		// decoder's luma is limited range, 0 -> 16 and 255 -> 235
+		if (channel == fan::webp::channel_t::luma) threshold = 16 + (threshold * 219 + 127) / 255;
+
+		out.resize(plane.size.x, plane.size.y);
+		fan::parallel_for(plane.size.y, [&](uint64_t begin, uint64_t end) {
+			for (uint64_t y = begin; y < end; y++) {
+				out.pack_row(y, plane.data + y * plane.stride, (uint8_t)threshold, invert);
+			}
+		}, 64);
+
+		fan::webp::free_plane(plane);
+		return true;
+	}
+};
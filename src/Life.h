@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+
+/// <summary>
+///
+/// Bit parallel Game of Life step on packed rows (Bitplane layout, bit 0 = leftmost cell of a word)
+/// 64 cells per word: the eight neighbour words are summed with bit sliced adders into a 3 bit count per cell
+///
+/// </summary>
+
+class Life {
+public:
+	// Next state of words [begin, end) of row, given the rows above & below. Cells past the row ends are dead
+	static void step(const uint64_t* above, const uint64_t* row, const uint64_t* below, uint64_t* out, int begin, int end, int words) {
+		for (int i = begin; i < end; i++) {
+			const uint64_t a = above[i], c = row[i], b = below[i];
+			// cell j's left neighbour is bit j - 1, carried in from the previous word
+			const uint64_t a_prev = i > 0 ? above[i - 1] >> 63 : 0, a_next = i + 1 < words ? above[i + 1] << 63 : 0;
+			const uint64_t c_prev = i > 0 ? row[i - 1] >> 63 : 0, c_next = i + 1 < words ? row[i + 1] << 63 : 0;
+			const uint64_t b_prev = i > 0 ? below[i - 1] >> 63 : 0, b_next = i + 1 < words ? below[i + 1] << 63 : 0;
+
+			out[i] = next(
+				a << 1 | a_prev, a, a >> 1 | a_next,
+				c << 1 | c_prev, c >> 1 | c_next,
+				b << 1 | b_prev, b, b >> 1 | b_next,
+				c);
+		}
+	}
+
+private:
+	static void full_add(uint64_t a, uint64_t b, uint64_t c, uint64_t& sum, uint64_t& carry) {
+		uint64_t t = a ^ b;
+		sum = t ^ c;
+		carry = (a & b) | (t & c);
+	}
+
+	// alive next if 3 neighbours, or 2 and alive now. Count is kept mod 8, 8 neighbours reads as 0 which is dead either way
+	static uint64_t next(uint64_t n0, uint64_t n1, uint64_t n2, uint64_t n3, uint64_t n4, uint64_t n5, uint64_t n6, uint64_t n7, uint64_t alive) {
+		uint64_t s0, c0, s1, c1, s2, c2;
+		full_add(n0, n1, n2, s0, c0);
+		full_add(n3, n4, n5, s1, c1);
+		s2 = n6 ^ n7;
+		c2 = n6 & n7;
+
+		uint64_t ones, c3;
+		full_add(s0, s1, s2, ones, c3);
+
+		// c0 .. c3 all weigh 2
+		uint64_t t, c4;
+		full_add(c0, c1, c2, t, c4);
+		uint64_t twos = t ^ c3;
+		uint64_t fours = c4 ^ (t & c3);
+
+		return twos & ~fours & (ones | alive);
+	}
+};
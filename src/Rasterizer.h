@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+	#include <emmintrin.h>
+#endif
+
+#include <fan/types/color.h>
+#include <fan/parallel.h>
+
+#include "Bitplane.h"
+
+/// <summary>
+///
+/// CPU rasterizer, expands the bitplane into RGBA or I420 pixels without any GL
+/// Source of video/image export, works headless
+/// Cells are expanded a byte of bits at a time with SIMD compares, each output row is built once per cell row and copied for the rest
+/// Row bands are rendered in parallel
+///
+/// </summary>
+
+class Rasterizer {
+public:
+	struct settings_t {
+		int scale = 1;                  // pixels per cell
+		int step = 1;                   // cells per pixel, bigger grids sample every step-th cell
+		uint32_t alive = 0xffffffff;    // RGBA bytes, little endian
+		uint32_t dead = 0xff000000;
+		bool gridlines = false;         // RGBA only, drawn when scale >= 3
+		uint32_t gridline = 0xff404040;
+	};
+
+	static uint32_t to_rgba(const fan::color& c) {
+		auto channel = [](float v) { return (uint32_t)std::clamp(v * 255.f + 0.5f, 0.f, 255.f); };
+		return channel(c.r) | channel(c.g) << 8 | channel(c.b) << 16 | 0xffu << 24;
+	}
+
+	// BT.601 limited range
+	static void to_yuv(uint32_t rgba, uint8_t* yuv) {
+		double r = (rgba & 0xff) / 255.0, g = (rgba >> 8 & 0xff) / 255.0, b = (rgba >> 16 & 0xff) / 255.0;
+		yuv[0] = (uint8_t)std::lround(16 + 65.481 * r + 128.553 * g + 24.966 * b);
+		yuv[1] = (uint8_t)std::lround(128 - 37.797 * r - 74.203 * g + 112.0 * b);
+		yuv[2] = (uint8_t)std::lround(128 + 112.0 * r - 93.786 * g - 18.214 * b);
+	}
+
+	// width x height pixels, stride in pixels. Pixels past the grid are dead
+	static void rgba(const Bitplane& bitplane, const settings_t& settings, uint32_t* pixels, int width, int height, size_t stride) {
+		const int scale = std::max(settings.scale, 1);
+		const bool gridlines = settings.gridlines && scale >= 3;
+
+		fan::parallel_for(height, [&](uint64_t begin, uint64_t end) {
+			std::vector<uint64_t>& bits = scratch_bits();
+			for (int py = (int)begin; py < (int)end; py++) {
+				uint32_t* out = pixels + (size_t)py * stride;
+				int sub = py % scale;
+				if (gridlines && sub == 0) {
+					std::fill(out, out + width, settings.gridline);
+					continue;
+				}
+				// same cell row as the row above, built already
+				if (py > (int)begin && sub != (gridlines ? 1 : 0)) {
+					std::memcpy(out, out - stride, width * sizeof(uint32_t));
+					continue;
+				}
+				sample_row(bitplane, py / scale * settings.step, settings.step, (width + scale - 1) / scale, bits);
+				expand(bits.data(), scale, settings.alive, settings.dead, out, width);
+				if (gridlines) {
+					for (int px = 0; px < width; px += scale) out[px] = settings.gridline;
+				}
+			}
+		}, min_rows(width));
+	}
+
+	// planes are y, u, v, width and height even
+	static void i420(const Bitplane& bitplane, const settings_t& settings, uint8_t* const planes[3], const uint32_t stride[3], int width, int height) {
+		const int scale = std::max(settings.scale, 1);
+		uint8_t alive[3], dead[3];
+		to_yuv(settings.alive, alive);
+		to_yuv(settings.dead, dead);
+
+		// chroma by live pixels in the 2x2 block
+		uint8_t u_blend[5], v_blend[5];
+		for (int n = 0; n <= 4; n++) {
+			u_blend[n] = (uint8_t)((dead[1] * (4 - n) + alive[1] * n + 2) / 4);
+			v_blend[n] = (uint8_t)((dead[2] * (4 - n) + alive[2] * n + 2) / 4);
+		}
+
+		fan::parallel_for(height / 2, [&](uint64_t begin, uint64_t end) {
+			std::vector<uint64_t>& bits = scratch_bits();
+			std::vector<uint8_t>& masks = scratch_masks();
+			masks.resize((size_t)width * 2);
+			uint8_t* mask[2] = { masks.data(), masks.data() + width };
+			int mask_row[2] = { -1, -1 }; // cell row each mask was built for
+			int luma_row = -1;               // cell row of the last luma row written
+
+			for (int qy = (int)begin; qy < (int)end; qy++) {
+				for (int r = 0; r < 2; r++) {
+					int cy = (qy * 2 + r) / scale * settings.step;
+					uint8_t* y = planes[0] + (size_t)(qy * 2 + r) * stride[0];
+					if (cy == luma_row) {
+						std::memcpy(y, y - stride[0], width);
+					}
+					else {
+						sample_row(bitplane, cy, settings.step, (width + scale - 1) / scale, bits);
+						expand<uint8_t>(bits.data(), scale, alive[0], dead[0], y, width);
+						expand<uint8_t>(bits.data(), scale, 1, 0, mask[r], width);
+						mask_row[r] = cy;
+						luma_row = cy;
+					}
+					if (cy != mask_row[r]) {
+						std::memcpy(mask[r], mask[r ^ 1], width);
+						mask_row[r] = cy;
+					}
+				}
+
+				uint8_t* u = planes[1] + (size_t)qy * stride[1];
+				uint8_t* v = planes[2] + (size_t)qy * stride[2];
+				int qx = 0;
+			#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+				// 8 chroma samples from 16 x 2 masks, (dead * 4 + (alive - dead) * n + 2) / 4 in 16 bit lanes
+				const __m128i low = _mm_set1_epi16(0xff);
+				const __m128i u_base = _mm_set1_epi16(dead[1] * 4 + 2), u_delta = _mm_set1_epi16(alive[1] - dead[1]);
+				const __m128i v_base = _mm_set1_epi16(dead[2] * 4 + 2), v_delta = _mm_set1_epi16(alive[2] - dead[2]);
+				for (; qx + 8 <= width / 2; qx += 8) {
+					__m128i rows = _mm_add_epi8(_mm_loadu_si128((const __m128i*)(mask[0] + qx * 2)), _mm_loadu_si128((const __m128i*)(mask[1] + qx * 2)));
+					__m128i n = _mm_add_epi16(_mm_and_si128(rows, low), _mm_srli_epi16(rows, 8));
+					__m128i cu = _mm_srli_epi16(_mm_add_epi16(u_base, _mm_mullo_epi16(u_delta, n)), 2);
+					__m128i cv = _mm_srli_epi16(_mm_add_epi16(v_base, _mm_mullo_epi16(v_delta, n)), 2);
+					_mm_storel_epi64((__m128i*)(u + qx), _mm_packus_epi16(cu, cu));
+					_mm_storel_epi64((__m128i*)(v + qx), _mm_packus_epi16(cv, cv));
+				}
+			#endif
+				for (; qx < width / 2; qx++) {
+					int n = mask[0][qx * 2] + mask[0][qx * 2 + 1] + mask[1][qx * 2] + mask[1][qx * 2 + 1];
+					u[qx] = u_blend[n];
+					v[qx] = v_blend[n];
+				}
+			}
+		}, std::max<uint64_t>(min_rows(width) / 2, 1));
+	}
+
+private:
+	// rows worth a thread, small frames stay on the calling thread
+	static uint64_t min_rows(int width) {
+		return std::max<uint64_t>(1, (1 << 18) / std::max(width, 1));
+	}
+
+	static std::vector<uint64_t>& scratch_bits() {
+		thread_local std::vector<uint64_t> bits;
+		return bits;
+	}
+
+	static std::vector<uint8_t>& scratch_masks() {
+		thread_local std::vector<uint8_t> masks;
+		return masks;
+	}
+
+	// cells x0 = 0, step, 2 * step ... of row cy, count cells, packed like a bitplane row. Missing cells are dead
+	static void sample_row(const Bitplane& bitplane, int cy, int step, int count, std::vector<uint64_t>& bits) {
+		const int words = (count + 63) / 64;
+		bits.assign(words, 0);
+		if (cy >= bitplane.height()) return;
+
+		const uint64_t* row = bitplane.row(cy);
+		if (step == 1) {
+			// bits past the bitplane width are 0 already
+			std::memcpy(bits.data(), row, std::min(words, bitplane.words_per_row()) * sizeof(uint64_t));
+			if (count % 64 && words <= bitplane.words_per_row()) bits[words - 1] &= ((uint64_t)1 << (count % 64)) - 1;
+			return;
+		}
+		const int available = std::min(count, (bitplane.width() + step - 1) / step);
+		for (int i = 0; i < available; i++) {
+			uint64_t x = (uint64_t)i * step;
+			bits[i / 64] |= (row[x / 64] >> (x % 64) & 1) << (i % 64);
+		}
+	}
+
+	// Writes width pixels, each bit of bits repeated scale times
+	template <typename pixel_t>
+	static void expand(const uint64_t* bits, int scale, pixel_t alive, pixel_t dead, pixel_t* out, int width) {
+		const uint8_t* bytes = (const uint8_t*)bits; // little endian, byte i = cells 8i .. 8i + 7
+
+		if (scale > 1) {
+			int px = 0;
+			for (int cx = 0; px < width; cx++) {
+				int n = std::min(scale, width - px);
+				std::fill_n(out + px, n, (bits[cx / 64] >> (cx % 64) & 1) ? alive : dead);
+				px += n;
+			}
+			return;
+		}
+
+		int px = 0;
+		if constexpr (sizeof(pixel_t) == 4) {
+		#if defined(__AVX2__)
+			// byte broadcast to 8 lanes, lane i keeps bit i
+			const __m256i select = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+			const __m256i a = _mm256_set1_epi32((int)alive);
+			const __m256i d = _mm256_set1_epi32((int)dead);
+			for (; px + 8 <= width; px += 8) {
+				__m256i v = _mm256_and_si256(_mm256_set1_epi32(bytes[px / 8]), select);
+				__m256i m = _mm256_cmpeq_epi32(v, select);
+				_mm256_storeu_si256((__m256i*)(out + px), _mm256_blendv_epi8(d, a, m));
+			}
+		#elif defined(__SSE2__) || defined(_M_X64)
+			const __m128i select = _mm_setr_epi32(1, 2, 4, 8);
+			const __m128i a = _mm_set1_epi32((int)alive);
+			const __m128i d = _mm_set1_epi32((int)dead);
+			for (; px + 4 <= width; px += 4) {
+				int nibble = bytes[px / 8] >> (px % 8);
+				__m128i m = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(nibble), select), select);
+				_mm_storeu_si128((__m128i*)(out + px), _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, d)));
+			}
+		#endif
+		}
+		else {
+		#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+			// two bytes of bits spread to 8 lanes each, lane i keeps bit i % 8
+			const __m128i select = _mm_set1_epi64x((long long)0x8040201008040201ull);
+			const __m128i a = _mm_set1_epi8((char)alive);
+			const __m128i d = _mm_set1_epi8((char)dead);
+			for (; px + 16 <= width; px += 16) {
+				uint16_t pair;
+				std::memcpy(&pair, bytes + px / 8, 2);
+				__m128i v = _mm_cvtsi32_si128(pair);
+				v = _mm_unpacklo_epi8(v, v);
+				v = _mm_unpacklo_epi16(v, v);
+				v = _mm_unpacklo_epi32(v, v);
+				__m128i m = _mm_cmpeq_epi8(_mm_and_si128(v, select), select);
+				_mm_storeu_si128((__m128i*)(out + px), _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, d)));
+			}
+		#endif
+		}
+		for (; px < width; px++) {
+			out[px] = (bytes[px / 8] >> (px % 8) & 1) ? alive : dead;
+		}
+	}
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include <fan/types/color.h>
+#include <fan/graphics/video_encoder.h>
+
+#include "Bitplane.h"
+#include "Rasterizer.h"
+
+/// <summary>
+///
+/// Records generations to a VP8/VP9 IVF file
+/// Each captured generation is rasterized on the CPU (Rasterizer) from the bitplane straight into I420, no GL readback
+/// Encoding runs on the encoder's own thread, a full queue drops the generation instead of stalling the simulation
+///
+/// </summary>
+
+class Recorder {
+public:
+	// Largest video side in pixels, bigger grids sample every n-th cell
+	static constexpr int max_size = 1024;
+
+	Recorder() {}
+	~Recorder() { stop(); }
+
+	// side x side cells, every k-th generation is captured
+	void start(const std::string& path, int side, fan::color alive, fan::color dead, int every = 1, uint32_t fps = 30) {
+		stop();
+
+		every_ = std::max(every, 1);
+		if (side <= max_size) {
+			settings_.scale = max_size / side;
+			settings_.step = 1;
+		}
+		else {
+			settings_.scale = 1;
+			settings_.step = (side + max_size - 1) / max_size;
+		}
+		settings_.alive = Rasterizer::to_rgba(alive);
+		settings_.dead = Rasterizer::to_rgba(dead);
+
+		fan::video::encoder_t::properties_t p;
+		int pixels = (side + settings_.step - 1) / settings_.step * settings_.scale;
+		p.size = fan::vec2ui(pixels, pixels);
+		p.fps = fps;
+		encoder_.open(path, p);
+
+		generation_ = 0;
+		pts_ = 0;
+	}
+
+	void stop() {
+		encoder_.close();
+	}
+
+	bool recording() const {
+		return encoder_.is_open();
+	}
+
+	// Call once per generation
+	void capture(const Bitplane& bitplane) {
+		if (generation_++ % every_) return;
+
+		fan::video::encoder_t::frame_t* frame = encoder_.acquire();
+		if (frame == nullptr) return; // encoder behind, counted as dropped
+
+		// pixels past the grid are dead, grid may have been resized since start
+		Rasterizer::i420(bitplane, settings_, frame->planes, frame->stride, frame->size.x, frame->size.y);
+		encoder_.submit(frame, pts_++);
+	}
+
+	fan::video::encoder_t::stats_t stats() {
+		return encoder_.get_stats();
+	}
+
+private:
+	fan::video::encoder_t encoder_;
+
+	int every_ = 1;
+	Rasterizer::settings_t settings_;
+
+	uint64_t generation_ = 0;
+	int64_t pts_ = 0;
+};
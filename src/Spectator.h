@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include <fan/network/stream.h>
+#include <fan/time/time.h>
+#include <fan/io/log.h>
+
+#include "Bitplane.h"
+#include "Delta.h"
+
+/// <summary>
+///
+/// Mirrors a universe served by a Broadcaster
+/// Messages are applied on the network thread, the simulation thread polls for the latest universe
+/// A delta that doesn't follow the current universe (or can't be decoded) asks the broadcaster for a keyframe
+///
+/// </summary>
+
+class Spectator {
+public:
+	struct stats_t {
+		uint64_t keyframes = 0;
+		uint64_t deltas = 0;
+		uint64_t rejected = 0;     // out of sequence or malformed
+		uint64_t bytes = 0;
+		uint64_t latency = 0;      // sum of broadcast to applied, ns. Only meaningful on the same machine (loopback)
+		uint64_t latency_max = 0;
+	};
+
+	Spectator() {}
+	~Spectator() { close(); }
+
+	void connect(const std::string& host, uint16_t port) {
+		close();
+		fan::network::client_t::callbacks_t callbacks;
+		callbacks.connect = on_connect;
+		callbacks.receive = on_receive;
+		callbacks.disconnect = on_disconnect;
+		callbacks.userptr = this;
+		client_.connect_tcp(host, port, callbacks);
+		open_ = true;
+	}
+
+	void close() {
+		client_.close();
+		open_ = false;
+		std::lock_guard<std::mutex> lock(mutex_);
+		framer_ = fan::network::framer_t();
+		sequence_ = 0;
+		changed_ = false;
+		requested_ = false;
+	}
+
+	// connect() was called, the connection itself may still be pending or lost
+	bool spectating() const {
+		return open_;
+	}
+
+	bool connected() const {
+		return client_.is_connected();
+	}
+
+	// Copies the latest universe into bitplane if it changed since the last call
+	bool poll(Bitplane& bitplane, uint64_t& generation) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!changed_) return false;
+		bitplane = universe_;
+		generation = generation_;
+		changed_ = false;
+		return true;
+	}
+
+	stats_t stats() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return stats_;
+	}
+
+private:
+	// network thread, mutex_ held
+	void apply(const char* data, size_t size) {
+		Delta::header_t header;
+		if (!Delta::read_header(data, size, header)) {
+			reject();
+			return;
+		}
+
+		if (header.type == Delta::keyframe) {
+			if ((uint64_t)header.width * header.height > ((uint64_t)1 << 30)) {
+				reject();
+				return;
+			}
+			universe_.resize(header.width, header.height);
+			stats_.keyframes++;
+		}
+		else if (sequence_ == 0 || header.sequence != sequence_ + 1) {
+			// deltas queued before a keyframe we asked for, or lost track
+			if (header.sequence > sequence_) reject();
+			return;
+		}
+		else {
+			stats_.deltas++;
+		}
+
+		const size_t words = (size_t)universe_.words_per_row() * universe_.height();
+		if (words && !Delta::decode(data, size, universe_.row(0), words)) {
+			sequence_ = 0;
+			reject();
+			return;
+		}
+
+		sequence_ = header.sequence;
+		generation_ = header.generation;
+		changed_ = true;
+
+		uint64_t now = fan::time::clock::now();
+		uint64_t latency = now - std::min(header.time, now);
+		stats_.latency += latency;
+		stats_.latency_max = std::max(stats_.latency_max, latency);
+	}
+
+	void reject() {
+		stats_.rejected++;
+		if (requested_) return; // one request until the keyframe arrives
+		std::string message;
+		size_t begin = fan::network::framer_t::begin_message(message);
+		message.push_back((char)Delta::request_keyframe);
+		fan::network::framer_t::end_message(message, begin);
+		client_.send(fan::network::make_buffer(std::move(message)));
+		requested_ = true;
+	}
+
+	static void on_connect(fan::network::client_t*, bool connected, void*) {
+		if (connected) fan_log_info("Spectating");
+		else fan_log_error("Spectator failed to connect");
+	}
+
+	static void on_receive(fan::network::client_t* client, const char* data, size_t size, void* userptr) {
+		Spectator* spectator = (Spectator*)userptr;
+		std::lock_guard<std::mutex> lock(spectator->mutex_);
+		spectator->stats_.bytes += size;
+		bool valid = spectator->framer_.feed(data, size, [&](const char* message, size_t length) {
+			if (length && message[0] == (char)Delta::keyframe) spectator->requested_ = false;
+			spectator->apply(message, length);
+		});
+		if (!valid) {
+			fan_log_error("Spectator received a message over the size limit, disconnecting");
+			client->disconnect();
+		}
+	}
+
+	static void on_disconnect(fan::network::client_t*, void*) {
+		fan_log_warning("Spectator disconnected");
+	}
+
+	fan::network::client_t client_;
+	bool open_ = false;
+
+	std::mutex mutex_;
+	fan::network::framer_t framer_;
+	Bitplane universe_;
+	uint64_t sequence_ = 0;  // of universe_, 0 before the first keyframe
+	uint64_t generation_ = 0;
+	bool changed_ = false;
+	bool requested_ = false;
+	stats_t stats_;
+};
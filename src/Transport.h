@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fan/io/shared_memory.h>
+#include <fan/network/stream.h>
+#include <fan/time/time.h>
+
+/// <summary>
+///
+/// Moves halo strips between domain workers (see Domain.h), one message per neighbour pair, direction & generation
+/// send never waits for the receiver, receive blocks until the peer's message for that generation is there
+/// SharedMemoryTransport: processes on one machine, a mailbox per directed pair in one segment, no syscalls on the hot path
+/// TcpTransport: workers on several machines, each worker listens on base port + rank and connects to its neighbours
+///
+/// </summary>
+
+class Transport {
+public:
+	// Peer silent for this long is considered gone
+	static constexpr uint64_t timeout = 30000000000;
+
+	virtual ~Transport() {}
+
+	// data is copied before returning
+	virtual void send(int peer, uint64_t generation, const void* data, size_t size) = 0;
+
+	// false if the peer didn't deliver within timeout
+	virtual bool receive(int peer, uint64_t generation, void* data, size_t size) = 0;
+};
+
+class SharedMemoryTransport : public Transport {
+public:
+	// Messages of a generation g go to buffer g % 2. A sender can't get two generations ahead of its receiver:
+	// its g + 2 needs the receiver's g + 1 halo, which the receiver only sends after taking g
+	struct alignas(64) mailbox_t {
+		std::atomic<uint64_t> stamp[2]; // generation + 1 of the message in each buffer
+	};
+
+	struct header_t {
+		uint32_t magic;
+		uint32_t workers;
+		uint64_t capacity; // bytes per message
+	};
+
+	static constexpr uint32_t magic = 0x4f4c4148; // "HALO"
+
+	// Coordinator side, before the workers start. The segment is removed when this transport closes
+	void create(const std::string& name, int workers, size_t capacity) {
+		capacity = (capacity + 63) / 64 * 64;
+		memory_.create(name, 64 + (uint64_t)workers * workers * (sizeof(mailbox_t) + capacity * 2));
+		header_t* header = (header_t*)memory_.data();
+		header->magic = magic;
+		header->workers = workers;
+		header->capacity = capacity;
+		for (int i = 0; i < workers * workers; i++) new (mailbox(i)) mailbox_t();
+	}
+
+	// Worker side
+	bool open(const std::string& name, int rank) {
+		if (!memory_.open(name, false)) return false;
+		const header_t* header = (const header_t*)memory_.data();
+		if (header->magic != magic || (int)header->workers <= rank) {
+			memory_.close();
+			return false;
+		}
+		rank_ = rank;
+		return true;
+	}
+
+	void send(int peer, uint64_t generation, const void* data, size_t size) override {
+		mailbox_t* box = mailbox(rank_ * workers() + peer);
+		std::memcpy(buffer(box, generation), data, size);
+		box->stamp[generation % 2].store(generation + 1, std::memory_order_release);
+	}
+
+	bool receive(int peer, uint64_t generation, void* data, size_t size) override {
+		mailbox_t* box = mailbox(peer * workers() + rank_);
+		std::atomic<uint64_t>& stamp = box->stamp[generation % 2];
+		if (stamp.load(std::memory_order_acquire) != generation + 1) {
+			// neighbours are usually within microseconds, more workers than cores need the yield
+			uint64_t start = fan::time::clock::now();
+			for (uint32_t spin = 0; stamp.load(std::memory_order_acquire) != generation + 1; spin++) {
+				if (spin < 256) continue;
+				std::this_thread::yield();
+				if (spin % 4096 == 0 && fan::time::clock::now() - start > timeout) return false;
+			}
+		}
+		std::memcpy(data, buffer(box, generation), size);
+		return true;
+	}
+
+private:
+	int workers() const {
+		return ((const header_t*)memory_.data())->workers;
+	}
+
+	mailbox_t* mailbox(int i) {
+		const header_t* header = (const header_t*)memory_.data();
+		return (mailbox_t*)(memory_.data() + 64 + i * (sizeof(mailbox_t) + header->capacity * 2));
+	}
+
+	uint8_t* buffer(mailbox_t* box, uint64_t generation) {
+		const header_t* header = (const header_t*)memory_.data();
+		return (uint8_t*)(box + 1) + generation % 2 * header->capacity;
+	}
+
+	fan::io::shared_memory_t memory_;
+	int rank_ = 0;
+};
+
+class TcpTransport : public Transport {
+public:
+	~TcpTransport() { close(); }
+
+	// hosts[i] is where rank i listens, on base_port + i. Returns once connected to every peer, false on timeout
+	bool open(int rank, const std::vector<std::string>& hosts, uint16_t base_port, const std::vector<int>& peers) {
+		rank_ = rank;
+		fan::network::server_t::callbacks_t callbacks;
+		callbacks.receive = on_receive;
+		callbacks.disconnect = on_disconnect;
+		callbacks.userptr = this;
+		try {
+			server_.open_tcp("0.0.0.0", base_port + rank, callbacks);
+		}
+		catch (const std::exception& e) {
+			// callers may be forked workers, they report it. fan::throw_error prints the reason & throws an empty message
+			error_ = *e.what() ? e.what() : "couldn't listen on " + std::to_string(base_port + rank);
+			return false;
+		}
+
+		// peers start in any order, retry until they listen
+		uint64_t start = fan::time::clock::now();
+		for (int peer : peers) {
+			auto connection = std::make_unique<peer_t>();
+			for (;;) {
+				connection->state = 0;
+				fan::network::client_t::callbacks_t client_callbacks;
+				client_callbacks.connect = [](fan::network::client_t*, bool connected, void* userptr) {
+					((peer_t*)userptr)->state = connected ? 1 : -1;
+				};
+				client_callbacks.userptr = connection.get();
+				client_callbacks.log_failures = false; // refusals are expected until the peer listens, callers may be forked workers
+				connection->client.connect_tcp(hosts[std::min<size_t>(peer, hosts.size() - 1)], base_port + peer, client_callbacks);
+				while (connection->state == 0 && fan::time::clock::now() - start <= timeout) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				if (connection->state == 1) break;
+				if (fan::time::clock::now() - start > timeout) {
+					error_ = "timed out connecting to " + std::to_string(peer);
+					connection->client.close();
+					return false;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			}
+			peers_[peer] = std::move(connection);
+		}
+		return true;
+	}
+
+	// why open failed
+	const std::string& error() const {
+		return error_;
+	}
+
+	void close() {
+		for (auto& peer : peers_) peer.second->client.close();
+		peers_.clear();
+		server_.close();
+	}
+
+	void send(int peer, uint64_t generation, const void* data, size_t size) override {
+		std::string message;
+		size_t begin = fan::network::framer_t::begin_message(message);
+		message.append((const char*)&rank_, sizeof(rank_));
+		message.append((const char*)&generation, sizeof(generation));
+		message.append((const char*)data, size);
+		fan::network::framer_t::end_message(message, begin);
+		peers_[peer]->client.send(fan::network::make_buffer(std::move(message)));
+	}
+
+	bool receive(int peer, uint64_t generation, void* data, size_t size) override {
+		std::unique_lock<std::mutex> lock(mutex_);
+		auto key = std::make_pair(peer, generation);
+		if (!arrived_.wait_for(lock, std::chrono::nanoseconds(timeout), [&] { return inbox_.count(key) != 0; })) return false;
+		std::string& message = inbox_[key];
+		std::memcpy(data, message.data(), std::min(size, message.size()));
+		inbox_.erase(key);
+		return true;
+	}
+
+private:
+	struct peer_t {
+		fan::network::client_t client;
+		std::atomic<int> state = 0;
+	};
+
+	// network thread
+	static void on_receive(fan::network::server_t* server, fan::network::server_t::client_id_t id, const char* data, size_t size, void* userptr) {
+		TcpTransport* transport = (TcpTransport*)userptr;
+		std::lock_guard<std::mutex> lock(transport->mutex_);
+		bool valid = transport->framers_[id].feed(data, size, [&](const char* message, size_t length) {
+			int32_t peer;
+			uint64_t generation;
+			if (length < sizeof(peer) + sizeof(generation)) return;
+			std::memcpy(&peer, message, sizeof(peer));
+			std::memcpy(&generation, message + sizeof(peer), sizeof(generation));
+			size_t header = sizeof(peer) + sizeof(generation);
+			transport->inbox_[std::make_pair((int)peer, generation)].assign(message + header, length - header);
+		});
+		if (!valid) server->disconnect(id);
+		transport->arrived_.notify_all();
+	}
+
+	static void on_disconnect(fan::network::server_t*, fan::network::server_t::client_id_t id, void* userptr) {
+		TcpTransport* transport = (TcpTransport*)userptr;
+		std::lock_guard<std::mutex> lock(transport->mutex_);
+		transport->framers_.erase(id);
+	}
+
+	int32_t rank_ = 0;
+	std::string error_;
+	fan::network::server_t server_;
+	std::map<int, std::unique_ptr<peer_t>> peers_;
+
+	std::mutex mutex_;
+	std::condition_variable arrived_;
+	std::map<fan::network::server_t::client_id_t, fan::network::framer_t> framers_;
+	std::map<std::pair<int, uint64_t>, std::string> inbox_;
+};
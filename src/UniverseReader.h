@@ -0,0 +1,235 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fan/io/shared_memory.h>
+
+#include "UniverseRing.h"
+
+/// <summary>
+///
+/// Reader side of UniverseRing, for tools running next to the simulation (census, plotting ...)
+/// Maps the segment read only, frames are read in place: use the frame, then check it with valid()
+/// A reader slower than the simulation skips to the oldest frame still in the ring and counts what it missed
+///
+///	UniverseReader reader;
+///	reader.open("congol");
+///	UniverseReader::frame_t frame;
+///	while (...) {
+///		if (!reader.next(frame)) continue;
+///		uint64_t live = census(frame);
+///		if (reader.valid(frame)) record(frame.generation, live);
+///	}
+///
+/// </summary>
+
+class UniverseReader {
+public:
+	struct status_t {
+		uint64_t publish = 0;
+		uint64_t generation = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint64_t population = 0;
+	};
+
+	struct frame_t {
+		uint64_t publish = 0;
+		uint64_t generation = 0;
+		uint64_t time = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t words_per_row = 0;
+		uint64_t population = 0;
+		const uint64_t* words = nullptr; // in the shared segment, rows like Bitplane
+
+		const uint64_t* row(uint32_t y) const {
+			return words + (size_t)y * words_per_row;
+		}
+
+		bool get(uint32_t x, uint32_t y) const {
+			return row(y)[x / 64] >> (x % 64) & 1;
+		}
+
+		const UniverseRing::slot_t* slot = nullptr;
+		uint64_t sequence = 0;
+	};
+
+	UniverseReader() {}
+
+	bool open(const std::string& name) {
+		name_ = name;
+		return reopen();
+	}
+
+	void close() {
+		memory_.close();
+		first_.close();
+		id_ = 0;
+	}
+
+	bool is_open() const {
+		return first_.is_open();
+	}
+
+	// Latest frame's header fields, false if the writer is gone or busy for too long
+	bool status(status_t& status) {
+		if (!attached()) return false;
+		const UniverseRing::header_t* h = header();
+		for (int attempt = 0; attempt < max_attempts; attempt++) {
+			uint64_t sequence = h->sequence.load(std::memory_order_acquire);
+			if (sequence & 1) continue;
+			status.publish = h->publish.load(std::memory_order_relaxed);
+			status.generation = h->generation.load(std::memory_order_relaxed);
+			status.width = h->width.load(std::memory_order_relaxed);
+			status.height = h->height.load(std::memory_order_relaxed);
+			status.population = h->population.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (h->sequence.load(std::memory_order_relaxed) == sequence) return true;
+		}
+		return false;
+	}
+
+	// Frame after the last one returned, false if there's none yet
+	bool next(frame_t& frame) {
+		status_t s;
+		if (!status(s) || s.publish <= last_) return false;
+
+		const uint64_t slots = header()->slot_count;
+		uint64_t n = last_ + 1;
+		// the slot the writer goes to next may be half written, leave it a frame of margin
+		if (last_ == 0 || s.publish - n >= slots - 1) {
+			uint64_t oldest = s.publish - (slots - 2);
+			if (last_ != 0 && oldest > n) missed_ += oldest - n;
+			n = last_ == 0 ? s.publish : oldest;
+		}
+
+		for (; n <= s.publish; n++) {
+			if (read(n, frame)) {
+				last_ = n;
+				return true;
+			}
+			missed_++;
+		}
+		last_ = s.publish;
+		return false;
+	}
+
+	// Newest frame, skipping anything not read yet (not counted as missed)
+	bool latest(frame_t& frame) {
+		status_t s;
+		if (!status(s) || s.publish == 0) return false;
+		if (!read(s.publish, frame)) return false;
+		last_ = s.publish;
+		return true;
+	}
+
+	// frame's data wasn't overwritten while it was used
+	bool valid(const frame_t& frame) const {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return frame.slot->sequence.load(std::memory_order_relaxed) == frame.sequence;
+	}
+
+	// Copies frame's rows, false if they were overwritten meanwhile
+	bool copy(const frame_t& frame, std::vector<uint64_t>& words) const {
+		size_t count = (size_t)frame.words_per_row * frame.height;
+		words.resize(count);
+		std::memcpy(words.data(), frame.words, count * sizeof(uint64_t));
+		return valid(frame);
+	}
+
+	// Frames the reader was lapped on
+	uint64_t missed() const {
+		return missed_;
+	}
+
+private:
+	static constexpr int max_attempts = 1000;
+
+	const uint8_t* segment() const {
+		return id_ ? memory_.data() : first_.data();
+	}
+
+	const UniverseRing::header_t* header() const {
+		return (const UniverseRing::header_t*)segment();
+	}
+
+	static bool valid_segment(const fan::io::shared_memory_t& memory) {
+		const UniverseRing::header_t* h = (const UniverseRing::header_t*)memory.data();
+		return memory.size() >= UniverseRing::header_size && h->magic.load(std::memory_order_acquire) == UniverseRing::magic &&
+			h->version == UniverseRing::version && memory.size() >= UniverseRing::header_size + h->slot_size * h->slot_count;
+	}
+
+	// Maps the first segment if needed, then the one its successor names
+	bool reopen() {
+		if (!first_.is_open() || ((const UniverseRing::header_t*)first_.data())->retired.load(std::memory_order_acquire)) {
+			close();
+			if (!first_.open(name_, true)) return false;
+			if (!valid_segment(first_)) {
+				first_.close();
+				return false;
+			}
+		}
+		const uint64_t id = ((const UniverseRing::header_t*)first_.data())->successor.load(std::memory_order_acquire);
+		if (id != id_) {
+			memory_.close();
+			id_ = 0;
+			if (!memory_.open(UniverseRing::segment_name(name_, id), true) || !valid_segment(memory_)) {
+				memory_.close();
+				return false;
+			}
+			id_ = id;
+		}
+		// frame numbers carry over a grown segment, frames before it are gone
+		status_t s;
+		if (last_ != 0 && status(s) && s.publish > 0 && last_ < s.publish - 1) {
+			last_ = s.publish - 1;
+		}
+		return true;
+	}
+
+	// segment mapped and current, follows the writer into a grown segment
+	bool current() const {
+		const UniverseRing::header_t* h = header();
+		return !h->retired.load(std::memory_order_acquire) && h->successor.load(std::memory_order_acquire) == 0;
+	}
+
+	bool attached() {
+		if (first_.is_open() && current()) return true;
+		return !name_.empty() && reopen() && current();
+	}
+
+	bool read(uint64_t n, frame_t& frame) {
+		const UniverseRing::header_t* h = header();
+		const UniverseRing::slot_t* s = UniverseRing::slot(segment(), n);
+		uint64_t sequence = s->sequence.load(std::memory_order_acquire);
+		if (sequence & 1 || s->publish.load(std::memory_order_relaxed) != n) return false;
+
+		frame.publish = n;
+		frame.generation = s->generation.load(std::memory_order_relaxed);
+		frame.time = s->time.load(std::memory_order_relaxed);
+		frame.width = s->width.load(std::memory_order_relaxed);
+		frame.height = s->height.load(std::memory_order_relaxed);
+		frame.words_per_row = s->words_per_row.load(std::memory_order_relaxed);
+		frame.population = s->population.load(std::memory_order_relaxed);
+		frame.words = s->words();
+		frame.slot = s;
+		frame.sequence = sequence;
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (s->sequence.load(std::memory_order_relaxed) != sequence) return false;
+		// torn dimensions can't point past the slot
+		return (uint64_t)frame.words_per_row * frame.height <= h->capacity_words;
+	}
+
+	fan::io::shared_memory_t first_;  // under name, its successor is the current segment
+	fan::io::shared_memory_t memory_; // name.id_ once the ring grew
+	uint64_t id_ = 0;
+	std::string name_;
+	uint64_t last_ = 0;
+	uint64_t missed_ = 0;
+};
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+
+#include <fan/io/shared_memory.h>
+#include <fan/time/time.h>
+
+#include "Bitplane.h"
+
+/// <summary>
+///
+/// Publishes generations into a shared memory ring for other processes (see UniverseReader.h)
+/// Segment is a header_t followed by slot_count slots, each a slot_t and the packed bitplane rows (Bitplane layout)
+/// The header and every slot are seqlocks: the sequence is odd while the writer is inside, a reader's copy is good if the sequence
+/// was even and unchanged across the read. The writer never waits for readers, slow readers get lapped and notice it
+/// A grid that outgrows the slots moves to a bigger segment under a new name (name.id) and retires the old one. The first segment
+/// stays mapped under name for the ring's lifetime, its successor is the id of the current segment, readers follow it
+///
+/// </summary>
+
+class UniverseRing {
+public:
+	static constexpr uint32_t magic = 0x4c4f4743; // "CGOL"
+	static constexpr uint32_t version = 2;
+	static constexpr uint32_t default_slots = 8;
+
+	// Offset 0 of the segment. Fields after sequence are the latest frame, read them under the seqlock
+	struct header_t {
+		std::atomic<uint32_t> magic;  // written last, the rest of the segment is set up once it reads magic
+		uint32_t version;
+		uint32_t slot_count;
+		uint32_t capacity_words;     // per slot
+		uint64_t slot_size;          // bytes, slot_t included
+		std::atomic<uint32_t> retired;
+		std::atomic<uint64_t> successor; // id of the segment that replaced this one, 0 while it's current
+
+		alignas(64) std::atomic<uint64_t> sequence;
+		std::atomic<uint64_t> publish;    // frames published, frame n is in slot n % slot_count. 0 before the first
+		std::atomic<uint64_t> generation;
+		std::atomic<uint32_t> width;
+		std::atomic<uint32_t> height;
+		std::atomic<uint64_t> population;
+	};
+
+	struct alignas(64) slot_t {
+		std::atomic<uint64_t> sequence;
+		std::atomic<uint64_t> publish;
+		std::atomic<uint64_t> generation;
+		std::atomic<uint64_t> time;       // fan::time::clock::now() of the writer
+		std::atomic<uint32_t> width;
+		std::atomic<uint32_t> height;
+		std::atomic<uint32_t> words_per_row;
+		std::atomic<uint64_t> population;
+
+		const uint64_t* words() const {
+			return (const uint64_t*)(this + 1);
+		}
+
+		uint64_t* words() {
+			return (uint64_t*)(this + 1);
+		}
+	};
+
+	static constexpr uint64_t header_size = (sizeof(header_t) + 63) / 64 * 64;
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "seqlocks in shared memory need lock free atomics");
+	static_assert(sizeof(slot_t) == 64);
+
+	// Segment id of a ring, 0 is the first one
+	static std::string segment_name(const std::string& name, uint64_t id) {
+		return id ? name + "." + std::to_string(id) : name;
+	}
+
+	static const slot_t* slot(const uint8_t* segment, uint64_t publish) {
+		const header_t* header = (const header_t*)segment;
+		return (const slot_t*)(segment + header_size + publish % header->slot_count * header->slot_size);
+	}
+
+	UniverseRing() {}
+	~UniverseRing() { close(); }
+
+	// Slots fit width x height cells, bigger bitplanes move to a bigger segment
+	void open(const std::string& name, int width, int height, uint32_t slots = default_slots) {
+		close();
+		slots = std::max(slots, 2u);
+		create(first_, name, width, height, slots);
+		name_ = name;
+		slots_ = slots;
+		publish_ = 0;
+		id_ = 0;
+	}
+
+	// Readers see the segments retired, the names are removed
+	void close() {
+		if (current_.is_open()) {
+			header()->retired.store(1, std::memory_order_release);
+			current_.close();
+		}
+		if (first_.is_open()) {
+			((header_t*)first_.data())->retired.store(1, std::memory_order_release);
+			first_.close();
+		}
+	}
+
+	bool is_open() const {
+		return first_.is_open();
+	}
+
+	const std::string& name() const {
+		return name_;
+	}
+
+	uint64_t published() const {
+		return publish_;
+	}
+
+	// false if the ring had to grow & couldn't, it's closed then
+	bool publish(const Bitplane& bitplane, uint64_t generation) {
+		if (!is_open()) return false;
+		const uint64_t words = (uint64_t)bitplane.words_per_row() * bitplane.height();
+		if (words > header()->capacity_words && !grow(bitplane.width(), bitplane.height())) {
+			close();
+			return false;
+		}
+
+		const uint64_t n = ++publish_;
+		slot_t* s = (slot_t*)slot(segment(), n);
+
+		// population counted while copying, the rows are read once
+		uint64_t population = 0;
+		uint64_t sequence = s->sequence.load(std::memory_order_relaxed);
+		s->sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		uint64_t* out = s->words();
+		const uint64_t* in = words ? bitplane.row(0) : nullptr;
+		for (uint64_t i = 0; i < words; i++) {
+			out[i] = in[i];
+			population += std::popcount(in[i]);
+		}
+		s->publish.store(n, std::memory_order_relaxed);
+		s->generation.store(generation, std::memory_order_relaxed);
+		s->time.store(fan::time::clock::now(), std::memory_order_relaxed);
+		s->width.store(bitplane.width(), std::memory_order_relaxed);
+		s->height.store(bitplane.height(), std::memory_order_relaxed);
+		s->words_per_row.store(bitplane.words_per_row(), std::memory_order_relaxed);
+		s->population.store(population, std::memory_order_relaxed);
+		s->sequence.store(sequence + 2, std::memory_order_release);
+
+		header_t* h = header();
+		sequence = h->sequence.load(std::memory_order_relaxed);
+		h->sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		h->publish.store(n, std::memory_order_relaxed);
+		h->generation.store(generation, std::memory_order_relaxed);
+		h->width.store(bitplane.width(), std::memory_order_relaxed);
+		h->height.store(bitplane.height(), std::memory_order_relaxed);
+		h->population.store(population, std::memory_order_relaxed);
+		h->sequence.store(sequence + 2, std::memory_order_release);
+		return true;
+	}
+
+private:
+	static void create(fan::io::shared_memory_t& memory, const std::string& name, int width, int height, uint32_t slots) {
+		const uint64_t capacity = (uint64_t)((width + 63) / 64) * height;
+		const uint64_t slot_size = sizeof(slot_t) + (capacity * sizeof(uint64_t) + 63) / 64 * 64;
+		memory.create(name, header_size + slot_size * slots);
+
+		header_t* header = new (memory.data()) header_t();
+		header->version = version;
+		header->slot_count = slots;
+		header->capacity_words = (uint32_t)capacity;
+		header->slot_size = slot_size;
+		for (uint32_t i = 0; i < slots; i++) {
+			new (memory.data() + header_size + i * slot_size) slot_t();
+		}
+		header->magic.store(magic, std::memory_order_release);
+	}
+
+	// Readers follow the first segment's successor and continue from the new segment's first frame
+	bool grow(int width, int height) {
+		fan::io::shared_memory_t next;
+		const uint64_t id = id_ + 1;
+		try {
+			create(next, segment_name(name_, id), width, height, slots_);
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+		// frame numbers carry over, the header publishes nothing before the first frame of the new segment
+		((header_t*)next.data())->publish.store(publish_, std::memory_order_relaxed);
+
+		header()->successor.store(id, std::memory_order_release);
+		((header_t*)first_.data())->successor.store(id, std::memory_order_release);
+		if (current_.is_open()) {
+			header()->retired.store(1, std::memory_order_release);
+		}
+		current_ = std::move(next);
+		id_ = id;
+		return true;
+	}
+
+	uint8_t* segment() {
+		return current_.is_open() ? current_.data() : first_.data();
+	}
+
+	header_t* header() {
+		return (header_t*)segment();
+	}
+
+	fan::io::shared_memory_t first_;   // under name, for the ring's lifetime
+	fan::io::shared_memory_t current_; // name.id_ once the ring grew
+	std::string name_;
+	uint32_t slots_ = default_slots;
+	uint64_t publish_ = 0;
+	uint64_t id_ = 0;
+};
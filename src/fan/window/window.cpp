@@ -31,6 +31,8 @@
 
 #include <X11/extensions/Xrandr.h>
 
+#include <poll.h>
+
 #include <errno.h>
 
 #endif
@@ -304,7 +306,11 @@ uintptr_t fan::window_t::get_max_fps() const {
 
 void fan::window_t::set_max_fps(uintptr_t fps) {
   m_max_fps = fps;
-  m_fps_next_tick = fan::time::clock::now();
+  m_frame_pacer.set_fps(fps);
+}
+
+fan::time::frame_pacer_t& fan::window_t::get_frame_pacer() {
+  return m_frame_pacer;
 }
 
 void fan::window_t::set_full_screen(const fan::vec2i& size)
@@ -641,6 +647,7 @@ void fan::window_t::open(const fan::vec2i& window_size, const std::string& name,
   m_size = window_size;
   m_mouse_position = 0;
   m_max_fps = 0;
+  m_frame_pacer.open();
   m_received_fps = 0;
   m_fps = 0;
   m_last_frame = fan::time::clock::now();
@@ -1460,20 +1467,8 @@ uint32_t fan::window_t::handle_events() {
 
   this->calculate_delta_time();
 
-  if (m_max_fps) {
-
-    uint64_t dt = fan::time::clock::now() - m_fps_next_tick;
-
-    uint64_t goal_fps = m_max_fps;
-
-    int64_t frame_time = std::pow(10, 9) * (1.0 / goal_fps);
-    frame_time -= dt;
-
-    fan::delay(fan::time::nanoseconds(std::max((int64_t)0, frame_time)));
-
-    m_fps_next_tick = fan::time::clock::now();
-
-  }
+  // sleeps & spins until next frame if max fps is set, records frame time either way
+  m_frame_pacer.wait();
 
   if (call_mouse_move_cb) {
 
@@ -1493,12 +1488,15 @@ uint32_t fan::window_t::handle_events() {
 
   this->reset_keys();
 
+  m_event_flags &= ~events::input;
+
   #ifdef fan_platform_windows
 
   MSG msg{};
 
   while (PeekMessageW(&msg, 0, 0, 0, PM_REMOVE))
   {
+    m_event_flags |= events::input;
    // fan::print(msg.message);
     switch (msg.message) {
       case WM_SYSKEYDOWN:
@@ -1892,6 +1890,10 @@ uint32_t fan::window_t::handle_events() {
 
   int nevents = XEventsQueued(fan::sys::m_display, QueuedAfterReading);
 
+  if (nevents) {
+    m_event_flags |= events::input;
+  }
+
   while (nevents--) {
     XNextEvent(fan::sys::m_display, &event);
     // if (XFilterEvent(&m_event, m_window))
@@ -2187,6 +2189,39 @@ uint32_t fan::window_t::handle_events() {
   return m_event_flags;
 }
 
+bool fan::window_t::wait_events(uint64_t timeout) {
+  // waited time would otherwise show up as one long frame
+  m_frame_pacer.restart();
+
+  uint32_t ms = (timeout + 999999) / 1000000;
+
+  #ifdef fan_platform_windows
+
+  // MWMO_INPUTAVAILABLE, also wakes for messages that were already queued before the call
+  return MsgWaitForMultipleObjectsEx(0, nullptr, ms, QS_ALLINPUT, MWMO_INPUTAVAILABLE) != WAIT_TIMEOUT;
+
+  #elif defined(fan_platform_unix)
+
+  // flushes requests & checks events already read from the connection
+  if (XPending(fan::sys::m_display)) {
+    return true;
+  }
+
+  pollfd fd;
+  fd.fd = ConnectionNumber(fan::sys::m_display);
+  fd.events = POLLIN;
+  fd.revents = 0;
+
+  int result;
+  do {
+    result = poll(&fd, 1, ms);
+  } while (result == -1 && errno == EINTR);
+
+  return result > 0;
+
+  #endif
+}
+
 void* fan::window_t::get_user_data() const
 {
   return m_user_data;
@@ -29,17 +29,20 @@
 //                                                                                                                                                          //
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+#define fan_count_allocations_implementation // global operator new hook, see fan/types/allocation_counter.h
+#include "Bench.h"
+#include "Cluster.h"
 #include "Grid.h"
 #include "Utils.h"
 
 #include <fan/graphics/graphics.h>
+#include <cstdlib>
 #include <thread>
 
 
 //* To-Do *\\
 // 
 // GENERAL:
-// - Zoom +/-
 // - Measuring tape (in square units)
 // 
 //  Known bugs:
@@ -49,6 +52,18 @@
 
 int main()
 {
+	// CONGOL_BENCH=<name>: run a benchmark instead of the game, see src/Bench.h
+	if (const char* bench = std::getenv("CONGOL_BENCH")) return Bench::main(bench);
+
+	// CONGOL_DOMAINS=<workers>|bench, CONGOL_DOMAIN_WORKER=<rank>: headless multi process run split into domains, no window, see src/Cluster.h
+	if (std::getenv("CONGOL_DOMAINS") || std::getenv("CONGOL_DOMAIN_WORKER")) return Cluster::main();
+
+	// CONGOL_TRACE=<file.json>: record frame, simulation & upload events (open in ui.perfetto.dev)
+	if (const char* trace_path = std::getenv("CONGOL_TRACE")) {
+		if (fan::time::get_trace().open(trace_path)) fan::time::get_trace().set_thread_name("main");
+		else fan_log_warning("Failed to open trace file:", trace_path);
+	}
+
     //  Grid divisor
     int subdivs = 50;
 
@@ -57,6 +72,7 @@ int main()
 	fan::opengl::context_t context;
 	context.init();
   context.bind_to_window(&window);
+  context.m_programs.set_directory(context.opengl, "cache/shaders"); // linked shaders, next start loads these instead of compiling
   context.set_viewport(0, window.get_size());
 	window.add_resize_callback(&context, [](fan::window_t*, const fan::vec2i& s, void* userptr) {
 		((fan::opengl::context_t*)userptr)->set_viewport(0, s);
@@ -71,6 +87,10 @@ int main()
 
   Grid grid(&window, &context, subdivs);
 
+  // cold start compiles, warm start should only load
+  const auto& shader_stats = context.m_programs.get_stats();
+  fan_log_info("Shader programs compiled:", shader_stats.compiled, "loaded:", shader_stats.loaded, "shared:", shader_stats.shared, "ms:", shader_stats.time / 1e6);
+
 	/* Key bindings */
 	window.add_key_callback(fan::mouse_left, fan::key_state::press, &grid, [](fan::window_t*, uint16_t key, void* userptr) { 
 		((Grid*)userptr)->paintingLive = true;
@@ -97,6 +117,60 @@ int main()
 		grid.show_fps = !grid.show_fps; grid.window->set_name("Conway's Game of Life"); 
 	});
 
+	// P: Toggle profiler overlay
+	window.add_key_callback(fan::key_p, fan::key_state::press, &grid, [](fan::window_t* w, uint16_t key, void* userptr) { 
+		Grid& grid = *(Grid*)userptr;
+		grid.show_profiler = !grid.show_profiler;
+	});
+
+	// R: Start/stop recording a video of the run (CONGOL_RECORD_EVERY=<n> records every n-th generation)
+	if (const char* every = std::getenv("CONGOL_RECORD_EVERY")) grid.record_every = std::max(std::atoi(every), 1);
+	window.add_key_callback(fan::key_r, fan::key_state::press, &grid, [](fan::window_t* w, uint16_t key, void* userptr) { 
+		((Grid*)userptr)->toggle_recording();
+	});
+
+	// E: Save current generation as a lossless WebP image
+	// Shift+E: Start/stop an animated WebP of the following generations (CONGOL_EXPORT_SCALE=<n> pixels per cell, CONGOL_EXPORT_GRIDLINES=1)
+	if (const char* scale = std::getenv("CONGOL_EXPORT_SCALE")) grid.export_scale = std::max(std::atoi(scale), 1);
+	if (const char* gridlines = std::getenv("CONGOL_EXPORT_GRIDLINES")) grid.export_gridlines = std::atoi(gridlines) != 0;
+	window.add_key_callback(fan::key_e, fan::key_state::press, &grid, [](fan::window_t* w, uint16_t key, void* userptr) { 
+		Grid& grid = *(Grid*)userptr;
+		if (w->key_press(fan::key_shift)) grid.toggle_animation_export();
+		else grid.export_image();
+	});
+
+	// I: Replace the universe with the WebP image at CONGOL_IMPORT (also imported on startup)
+	// CONGOL_IMPORT_THRESHOLD=<0-255>, CONGOL_IMPORT_ALPHA=1 thresholds alpha instead of luminance, CONGOL_IMPORT_INVERT=1 makes dark pixels live
+	if (const char* threshold = std::getenv("CONGOL_IMPORT_THRESHOLD")) grid.import_threshold = std::atoi(threshold);
+	if (const char* alpha = std::getenv("CONGOL_IMPORT_ALPHA")) grid.import_alpha = std::atoi(alpha) != 0;
+	if (const char* invert = std::getenv("CONGOL_IMPORT_INVERT")) grid.import_invert = std::atoi(invert) != 0;
+	if (const char* image = std::getenv("CONGOL_IMPORT")) grid.import_image(image);
+	window.add_key_callback(fan::key_i, fan::key_state::press, &grid, [](fan::window_t* w, uint16_t key, void* userptr) {
+		if (const char* image = std::getenv("CONGOL_IMPORT")) ((Grid*)userptr)->import_image(image);
+		else fan_log_warning("Set CONGOL_IMPORT=<image.webp> to import");
+	});
+
+	// CONGOL_SERVE=<port>: stream the universe to spectators
+	// CONGOL_SPECTATE=<host>:<port>: mirror a served universe instead of simulating
+	if (const char* port = std::getenv("CONGOL_SERVE")) grid.serve(std::atoi(port));
+	if (const char* address = std::getenv("CONGOL_SPECTATE")) {
+		std::string host = address;
+		size_t colon = host.rfind(':');
+		if (colon == std::string::npos) fan_log_error("CONGOL_SPECTATE should be <host>:<port>");
+		else grid.spectate(host.substr(0, colon), std::atoi(host.c_str() + colon + 1));
+	}
+
+	// CONGOL_SHM=<name>: publish every generation to shared memory for local tools (src/UniverseReader.h)
+	if (const char* name = std::getenv("CONGOL_SHM")) grid.share(name);
+
+	// CONGOL_CONTROL=<socket path>: accept scripted commands (step, run until, edit & read cells, checkpoints), see src/Controller.h
+	if (const char* path = std::getenv("CONGOL_CONTROL")) grid.control(path);
+
+	// F12: Screenshot of the window as a lossless WebP image
+	window.add_key_callback(fan::key_f12, fan::key_state::press, &grid, [](fan::window_t* w, uint16_t key, void* userptr) {
+		((Grid*)userptr)->screenshot();
+	});
+
 	// Space: Toggle simulation
 	window.add_key_callback(fan::key_space, fan::key_state::press, &grid, [](fan::window_t* w, uint16_t key, void* userptr) { 
 		((Grid*)userptr)->toggle_simulation(); 
@@ -104,7 +178,8 @@ int main()
 
 	// Shift+T+ScrollUp: Evolve or forward to next generation depending on if the generation is already recorded or not. 
 	// Shift+T+ScrollDown: Devolve to earlier generation if it exists
-	window.add_keys_callback(&grid, [](fan::window_t*, uint16_t key, fan::key_state, void* userptr) {
+	// ScrollUp/ScrollDown: Zoom in/out around cursor
+	window.add_keys_callback(&grid, [](fan::window_t*, uint16_t key, fan::key_state state, void* userptr) {
 		Grid& grid = *(Grid*)userptr;
 		if (grid.window->key_press(fan::key_t) && key == fan::mouse_scroll_up) {
 			grid.evolve();
@@ -112,6 +187,26 @@ int main()
 		else if (grid.window->key_press(fan::key_t) && key == fan::mouse_scroll_down) {
 			grid.devolve();
 		}
+		else if (key == fan::mouse_scroll_up && state == fan::key_state::press) {
+			grid.zoom_at(grid.window->get_mouse_position(), 1.25);
+		}
+		else if (key == fan::mouse_scroll_down && state == fan::key_state::press) {
+			grid.zoom_at(grid.window->get_mouse_position(), 0.8);
+		}
+	});
+
+	// Middle mouse drag: Pan
+	window.add_key_callback(fan::mouse_middle, fan::key_state::press, &grid, [](fan::window_t*, uint16_t key, void* userptr) { 
+		((Grid*)userptr)->panning = true;
+	});
+	window.add_key_callback(fan::mouse_middle, fan::key_state::release, &grid, [](fan::window_t*, uint16_t key, void* userptr) { 
+		((Grid*)userptr)->panning = false;
+	});
+	window.add_mouse_move_callback(&grid, [](fan::window_t* w, const fan::vec2i& position, void* userptr) {
+		Grid& grid = *(Grid*)userptr;
+		if (grid.panning) {
+			grid.pan(w->get_previous_mouse_position() - position);
+		}
 	});
 
   grid.run();